@@ -36,7 +36,10 @@ namespace refinery {
  * code that links to it must use a GPL-compatible license.
  *
  * This is a shallow wrapper around the Exiv2 data, so the original Exiv2 data
- * must exist for the lifetime of this object.
+ * must exist (unmodified) for the lifetime of this object. Constructing one
+ * (including the implicit conversion below) indexes every key up front, in
+ * one pass over the data; lookups are then hash-table hits, and each
+ * converted value is remembered.
  *
  * When the header is included, Exiv2ExifData can be initialized automatically
  * where an ExifData is expected, as in the following example:
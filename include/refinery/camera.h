@@ -1,6 +1,8 @@
 #ifndef _REFINERY_CAMERA_H
 #define _REFINERY_CAMERA_H
 
+#include <string>
+
 namespace refinery {
 
 class ExifData;
@@ -89,9 +91,12 @@ public:
   /**
    * Some multipliers for changing color spaces.
    *
+   * These are computed at most once per Camera, so calling this is cheap and
+   * thread-safe. The reference lasts as long as the Camera.
+   *
    * \return Color conversion data.
    */
-  virtual ColorConversionData colorConversionData() const = 0;
+  virtual const ColorConversionData& colorConversionData() const = 0;
 
   /**
    * The Exif "Orientation", from 1 to 8, saying how one image is flipped.
@@ -142,6 +147,10 @@ public:
   /**
    * Returns \c true if this is the right Camera for exifData.
    *
+   * CameraFactory usually finds a Camera by looking up its name() in an
+   * index, without calling this. It's only called for cameras registered as
+   * needing custom detection logic.
+   *
    * \param[in] exifData the Exif data.
    * \return \c true if this Camera shot a photo with this ExifData.
    */
@@ -267,8 +276,121 @@ public:
 
   /**
    * Some multipliers for changing color spaces.
+   *
+   * The reference lasts as long as the Camera.
    */
-  Camera::ColorConversionData colorConversionData() const;
+  const Camera::ColorConversionData& colorConversionData() const;
+};
+
+/**
+ * Everything refinery needs to know about one photo's camera, resolved once.
+ *
+ * CameraData answers each question by asking its Camera, which may in turn
+ * look through the ExifData; and it holds references to both, so they must
+ * outlive it. A CameraProfile asks every question up front and stores the
+ * answers by value. That makes it cheap to query in inner loops and safe to
+ * copy into (and read from) any number of threads, long after the ExifData
+ * and the Camera are gone.
+ *
+ * Every Image owns a CameraProfile.
+ */
+class CameraProfile {
+  unsigned int mFilters;
+  unsigned int mColors;
+  unsigned int mOrientation;
+  unsigned int mRawWidth;
+  unsigned int mRawHeight;
+  Camera::ColorConversionData mColorConversionData;
+  std::string mNoColorDataError; // empty if the camera had color data
+
+  void checkColorConversionData() const {
+    if (!mNoColorDataError.empty()) throwNoColorConversionData();
+  }
+  void throwNoColorConversionData() const;
+
+public:
+  /**
+   * Resolves a CameraProfile from a photo's CameraData.
+   *
+   * The sensor dimensions are passed in rather than read from the CameraData,
+   * since whoever is building an image has already worked them out.
+   *
+   * \param[in] cameraData The photograph's CameraData.
+   * \param[in] rawWidth Width of the raw image, in pixels.
+   * \param[in] rawHeight Height of the raw image, in pixels.
+   */
+  CameraProfile(
+      const CameraData& cameraData,
+      unsigned int rawWidth, unsigned int rawHeight);
+
+  /**
+   * A copy of this profile with a different filters() value.
+   *
+   * \param[in] filters New sensor color pattern.
+   * \return A new CameraProfile.
+   */
+  CameraProfile withFilters(unsigned int filters) const;
+
+  /**
+   * A bitmask representing the camera sensor array.
+   *
+   * See Camera::filters() for what the values mean.
+   */
+  unsigned int filters() const { return mFilters; }
+
+  /**
+   * The number of sensor colors, typically 3 or 4.
+   */
+  unsigned int colors() const { return mColors; }
+
+  /**
+   * The Exif "Orientation", from 1 to 8, saying how one image is flipped.
+   */
+  unsigned int orientation() const { return mOrientation; }
+
+  /**
+   * The width of the raw image, in pixels.
+   */
+  unsigned int rawWidth() const { return mRawWidth; }
+
+  /**
+   * The height of the raw image, in pixels.
+   */
+  unsigned int rawHeight() const { return mRawHeight; }
+
+  /**
+   * Black level, the camera's conceptual 0.
+   *
+   * \throw std::logic_error if the camera has no color data.
+   */
+  short black() const {
+    checkColorConversionData();
+    return mColorConversionData.black;
+  }
+
+  /**
+   * Maximum sensor value.
+   *
+   * \throw std::logic_error if the camera has no color data.
+   */
+  short maximum() const {
+    checkColorConversionData();
+    return mColorConversionData.maximum;
+  }
+
+  /**
+   * Matrices and multipliers for changing color spaces.
+   *
+   * These are copied from the Camera when the profile is built. A camera
+   * without color data still makes a profile (and an Image), so only the
+   * color stages fail.
+   *
+   * \throw std::logic_error if the camera has no color data.
+   */
+  const Camera::ColorConversionData& colorConversionData() const {
+    checkColorConversionData();
+    return mColorConversionData;
+  }
 };
 
 /**
@@ -281,6 +403,11 @@ public:
  * Each Camera is initialized once, statically. You can only pass Camera
  * instances by reference.
  *
+ * Detection is a hash lookup of the normalized (uppercased,
+ * whitespace-collapsed) "Exif.Image.Model" against every Camera::name(), so
+ * its cost doesn't grow with the number of supported cameras. Cameras that
+ * need custom detection are checked with Camera::canHandle() afterwards.
+ *
  * If you want to find out anything about an actual photograph, you should look
  * to CameraDataFactory, not CameraFactory.
  */
@@ -0,0 +1,150 @@
+#ifndef _REFINERY_COMPRESSED_IMAGE_H
+#define _REFINERY_COMPRESSED_IMAGE_H
+
+#include <cstddef>
+
+#include <refinery/camera.h>
+#include <refinery/image.h>
+
+namespace refinery {
+
+template<typename T> class ImageView;
+
+/**
+ * An Image kept compressed in memory, a tile at a time.
+ *
+ * A 100-megapixel RGBImage takes 600MB. A CompressedImage holds the same
+ * pixels in square tiles, each compressed losslessly (with a delta and
+ * byte-plane codec tuned for 16-bit sensor data) to around 60% of that.
+ * Only the most recently used tiles are kept decoded, up to
+ * maxDecodedTiles(); the least recently used one is re-compressed (if it was
+ * written) and dropped when another is needed.
+ *
+ * Pixels go in and out by rectangle, through ImageViews. Callers that sweep
+ * an image in tile-sized pieces (as the AHD Interpolator does) keep the
+ * decoded set small and each tile is decoded about once:
+ *
+ * \code
+ * CompressedRGBImage store(profile, width, height);
+ * store.write(Point(0, 0), ConstRGBImageView(*rgbImage));
+ * rgbImage.reset(); // free the 600MB
+ *
+ * RGBImage band(profile, width, 256);
+ * for (int row = 0; row < height; row += 256) {
+ *   const int bandHeight = std::min(256, height - row); // the last is short
+ *   RGBImageView bandView(band, Point(0, 0), Point(bandHeight, width));
+ *   store.read(Point(row, 0), bandView);
+ *   // ... process and write out bandView ...
+ * }
+ * \endcode
+ *
+ * Several CompressedImages under a fixed memory budget let a program hold
+ * more big images at once than would fit in RAM uncompressed.
+ *
+ * A CompressedImage is thread-safe: concurrent reads and writes are
+ * serialized.
+ *
+ * \tparam T The type of Pixel in the grid. Its values must be 16-bit
+ *           (u16GrayPixel or u16RGBPixel).
+ */
+template<typename T>
+class CompressedImage {
+public:
+  typedef T PixelType; /**< Type of each pixel. */
+  typedef typename T::ValueType ValueType; /**< Color value type. */
+  typedef typename T::ColorType ColorType; /**< Color index type. */
+
+private:
+  class Impl;
+  Impl* impl;
+
+  CompressedImage(const CompressedImage&);
+  CompressedImage& operator=(const CompressedImage&);
+
+public:
+  /**
+   * Constructor.
+   *
+   * Every pixel starts at 0, which costs (almost) no memory.
+   *
+   * \param[in] profile CameraProfile that applies to the photograph.
+   * \param[in] width Image width in pixels.
+   * \param[in] height Image height in pixels.
+   * \param[in] tileSize Width and height of each tile, in pixels.
+   * \param[in] maxDecodedTiles Most tiles to keep decoded at once.
+   * \throw std::invalid_argument if a size is negative or tileSize is 0.
+   */
+  CompressedImage(
+      const CameraProfile& profile, int width, int height,
+      unsigned int tileSize = 64, std::size_t maxDecodedTiles = 64);
+
+  ~CompressedImage(); /**< Destructor. */
+
+  /**
+   * The photograph's CameraProfile.
+   */
+  const CameraProfile& profile() const;
+  /**
+   * Image width in pixels.
+   */
+  unsigned int width() const;
+  /**
+   * Image height in pixels.
+   */
+  unsigned int height() const;
+  /**
+   * Number of pixels in the image.
+   */
+  std::size_t nPixels() const;
+  /**
+   * Width and height of each tile, in pixels.
+   */
+  unsigned int tileSize() const;
+  /**
+   * Most tiles kept decoded at once.
+   */
+  std::size_t maxDecodedTiles() const;
+
+  /**
+   * Copies pixels out.
+   *
+   * \param[in] origin Image point to copy \p out's top-left pixel from.
+   * \param[out] out Destination; its size decides how much is copied.
+   * \throw std::out_of_range if the region isn't within the image.
+   */
+  void read(const Point& origin, const ImageView<T>& out) const;
+
+  /**
+   * Copies pixels in.
+   *
+   * \param[in] origin Image point to copy \p in's top-left pixel to.
+   * \param[in] in Source; its size decides how much is copied.
+   * \throw std::out_of_range if the region isn't within the image.
+   */
+  void write(const Point& origin, const ImageView<const T>& in);
+
+  /**
+   * Re-compresses every decoded tile that has been written to.
+   *
+   * Decoded tiles stay decoded. This is only useful before
+   * compressedBytes().
+   */
+  void flush();
+
+  /**
+   * Bytes used by compressed tiles (not counting decoded ones).
+   */
+  std::size_t compressedBytes() const;
+
+  /**
+   * Bytes used by decoded tiles.
+   */
+  std::size_t decodedBytes() const;
+};
+
+typedef CompressedImage<u16RGBPixel> CompressedRGBImage;
+typedef CompressedImage<u16GrayPixel> CompressedGrayImage;
+
+} // namespace refinery
+
+#endif /* _REFINERY_COMPRESSED_IMAGE_H */
@@ -115,6 +115,37 @@ public:
    * \param[in] s String, for instance "NIKON D5000".
    */
   virtual void setString(const char* key, const std::string& s);
+
+  /**
+   * Sets an int Exif datum.
+   *
+   * \param[in] key Exif key, for instance "Exif.Image.Orientation".
+   * \param[in] i Integer, for instance 1.
+   */
+  virtual void setInt(const char* key, int i);
+
+  /**
+   * Sets a float Exif datum.
+   *
+   * \param[in] key Exif key, for instance "Exif.Image.XResolution".
+   * \param[in] f Float, for instance 300.0f.
+   */
+  virtual void setFloat(const char* key, float f);
+
+  /**
+   * Sets a byte-array Exif datum.
+   *
+   * \param[in] key Exif key, for instance "Exif.SubImage2.CFAPattern".
+   * \param[in] bytes Bytes to copy.
+   */
+  virtual void setBytes(const char* key, const std::vector<byte>& bytes);
+
+  /**
+   * Writes every datum in the format ExifCache stores on disk.
+   *
+   * \param[out] out Serialized data.
+   */
+  void serialize(std::string& out) const;
 };
 
 /**
@@ -170,6 +201,13 @@ public:
    */
   const char* mime_type() const;
 
+  /**
+   * Writes every parsed datum in the format ExifCache stores on disk.
+   *
+   * \param[out] out Serialized data.
+   */
+  void serialize(std::string& out) const;
+
   virtual bool hasKey(const char* key) const;
   virtual std::string getString(const char* key) const;
   virtual void getBytes(const char* key, std::vector<byte>& outBytes) const;
@@ -0,0 +1,125 @@
+#ifndef _REFINERY_EXIF_CACHE_H
+#define _REFINERY_EXIF_CACHE_H
+
+#include <string>
+
+#include <refinery/exif.h>
+
+namespace refinery {
+
+/**
+ * Exif data served straight from a memory-mapped ExifCache file.
+ *
+ * Lookups binary-search the mapping, so opening one costs a single mmap()
+ * no matter how many Exif values it holds. Values are copied out only when
+ * a getter is called.
+ *
+ * Most users won't construct this directly: ExifCache::find() returns one.
+ */
+class MappedExifData : public ExifData {
+  class Impl;
+  Impl* impl;
+
+  friend class ExifCache;
+
+public:
+  /**
+   * Constructor.
+   *
+   * This throws std::runtime_error if \p path isn't a valid cache file.
+   *
+   * \param[in] path Cache file written by ExifCache::store().
+   */
+  MappedExifData(const char* path);
+  ~MappedExifData(); /**< destructor. */
+
+  virtual bool hasKey(const char* key) const;
+  virtual std::string getString(const char* key) const;
+  virtual void getBytes(const char* key, std::vector<byte>& outBytes) const;
+  virtual int getInt(const char* key) const;
+  virtual float getFloat(const char* key) const;
+};
+
+/**
+ * A directory of parsed Exif data, keyed by the identity of each raw file.
+ *
+ * Parsing Exif data with DcrawExifData means running dcraw's identify()
+ * code, which seeks all over the raw file. When the same files are processed
+ * again and again (say, when a batch job restarts), an ExifCache lets us
+ * skip that: each file's values, including the linearization table bytes,
+ * are written to a compact cache file the first time and memory-mapped
+ * afterwards.
+ *
+ * A raw file's identity is its (device, inode, size, mtime), with mtime in
+ * nanoseconds. If any of those change, the old cache entry is simply never
+ * found again.
+ *
+ * \code
+ * refinery::ExifCache cache("/var/cache/refinery");
+ * std::auto_ptr<refinery::ExifData> exifData(cache.getExifData("image.NEF"));
+ * std::cout << "Camera: " << exifData->getString("Exif.Image.Model") << std::endl;
+ * \endcode
+ *
+ * An ExifCache holds no state besides its directory name, so many threads
+ * and processes can share one directory.
+ */
+class ExifCache {
+  std::string mDirectory;
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] directory Existing, writable directory for cache files.
+   */
+  ExifCache(const char* directory);
+
+  /**
+   * The cache-file path for a raw file, or "" if it can't be stat()ed.
+   *
+   * \param[in] filename Raw file path.
+   * \return Path within the cache directory.
+   */
+  std::string cachePath(const char* filename) const;
+
+  /**
+   * Returns cached Exif data for a raw file, or 0 on a cache miss.
+   *
+   * It's up to the caller to free the result, with \c delete.
+   *
+   * \param[in] filename Raw file path.
+   * \return A new MappedExifData, or 0.
+   */
+  ExifData* find(const char* filename) const;
+
+  /**
+   * Stores serialized Exif data for a raw file.
+   *
+   * The cache file is written under a temporary name and then renamed, so
+   * concurrent readers never see a partial file.
+   *
+   * \param[in] filename Raw file path.
+   * \param[in] serializedExifData Output of DcrawExifData::serialize().
+   * \return \c false if the cache file couldn't be written.
+   */
+  bool store(
+      const char* filename, const std::string& serializedExifData) const;
+
+  /**
+   * Returns Exif data for a raw file, parsing and storing it on a miss.
+   *
+   * On a hit, this returns a MappedExifData and the raw file isn't even
+   * opened. On a miss, it returns a DcrawExifData and stores its values for
+   * next time.
+   *
+   * It's up to the caller to free the result, with \c delete.
+   *
+   * \param[in] filename Raw file path.
+   * \return A new ExifData.
+   */
+  ExifData* getExifData(const char* filename) const;
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_EXIF_CACHE_H */
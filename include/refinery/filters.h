@@ -8,7 +8,7 @@ namespace refinery {
 /**
  * Scale an Image to fill its data-type.
  *
- * This is intended for use with RAW GrayImages. The Image's CameraData
+ * This is intended for use with RAW GrayImages. The Image's CameraProfile
  * contains information on how much each color should be scaled. This filter
  * reads that and multiplies each pixel according to what color its sensor is.
  *
@@ -19,15 +19,26 @@ namespace refinery {
 class ScaleColorsFilter {
 public:
   /**
-   * Multiplies \p image's colors according to its CameraData.
+   * Multiplies \p image's colors according to its CameraProfile.
    */
   template<typename T> void filter(T& image);
+
+  /**
+   * Multiplies \p image's colors by the given multipliers.
+   *
+   * Use this with AutoWhiteBalance, or with any other multipliers you like.
+   * They work like Camera::ColorConversionData::scalingMultipliers.
+   *
+   * \param[in,out] image Raw sensor image.
+   * \param[in] multipliers One multiplier per sensor color.
+   */
+  template<typename T> void filter(T& image, const double multipliers[4]);
 };
 
 /**
  * Convert an Image from camera colors to sRGB.
  *
- * This relies on the Image's CameraData, which specifies what the camera
+ * This relies on the Image's CameraProfile, which specifies what the camera
  * colors actually mean in sRGB colorspace.
  */
 class ConvertToRgbFilter {
@@ -3,9 +3,13 @@
 
 #include <cstddef>
 #include <limits>
+#include <vector>
 
 namespace refinery {
 
+template<typename T> class Image;
+template<typename T, unsigned int N> class PlanarImage;
+
 /**
  * Says, for each color, how many of a picture's pixels hold each value.
  *
@@ -38,7 +42,7 @@ private:
   typedef std::vector<unsigned int> CurveType;
 
   CurveType mCurves[NColors];
-  unsigned int mNPixels;
+  std::size_t mNPixels;
 
   void init(const ImageType& image)
   {
@@ -50,6 +54,13 @@ private:
       mCurves[c].assign(nSlots, 0);
     }
 
+    this->count(image);
+
+    this->mNPixels = image.nPixels();
+  }
+
+  template<typename T> void count(const Image<T>& image)
+  {
     const PixelType* pixel(image.constPixels());
     const PixelType* endPixel(image.constPixelsEnd());
 
@@ -58,8 +69,22 @@ private:
         mCurves[c][pixel->at(c) >> Coarseness]++;
       }
     }
+  }
 
-    this->mNPixels = image.nPixels();
+  template<typename T, unsigned int N> void count(const PlanarImage<T, N>& image)
+  {
+    for (ColorType c = 0; c < NColors; c++) {
+      unsigned int* curve(&mCurves[c][0]);
+
+      for (unsigned int row = 0; row < image.height(); row++) {
+        const ValueType* value(image.constPlaneRow(c, row));
+        const ValueType* endValue(value + image.width());
+
+        for (; value < endValue; value++) {
+          curve[*value >> Coarseness]++;
+        }
+      }
+    }
   }
 
 public:
@@ -93,7 +118,7 @@ public:
    *
    * \return Pixel count.
    */
-  inline unsigned int nPixels() const { return this->mNPixels; }
+  inline std::size_t nPixels() const { return this->mNPixels; }
 
   /**
    * Number of pixels in a particular slot.
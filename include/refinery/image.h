@@ -1,14 +1,15 @@
 #ifndef _REFINERY_IMAGE_H
 #define _REFINERY_IMAGE_H
 
-#include <refinery/camera.h>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
 
-#include <vector>
+#include <refinery/camera.h>
+#include <refinery/image_buffer.h>
 
 namespace refinery {
 
-class CameraData;
-
 /**
  * A pixel coordinate counted from the top-left.
  *
@@ -335,40 +336,101 @@ public:
   typedef typename T::ColorType ColorType; /**< Color index type. */
 
 private:
-  typedef std::vector<PixelType> PixelsType;
-  CameraData mCameraData;
+  CameraProfile mProfile;
   int mWidth;
   int mHeight;
-  int mFilters;
-  PixelsType mPixels;
+  ImageBuffer mBuffer;
+  PixelType* mPixels;
 
-  void allocate()
+  std::size_t bufferSize() const
   {
-    mPixels.assign(mWidth * mHeight, PixelType());
+    return static_cast<std::size_t>(mWidth) * mHeight * sizeof(PixelType);
   }
 
 public:
   /**
    * Constructor.
    *
-   * This allocates the space needed to store all the Pixels and sets them to
-   * default values of 0.
+   * This allocates the space needed to store all the Pixels and, unless
+   * told otherwise, sets them to default values of 0.
+   *
+   * The Image resolves its own CameraProfile from \p cameraData, so the
+   * CameraData (and its ExifData) needn't outlive the Image.
    *
    * \param[in] cameraData CameraData that applies to the photograph.
    * \param[in] width Image width in pixels.
    * \param[in] height Image height in pixels.
+   * \param[in] initialization Pass ImageBuffer::UNINITIALIZED to skip
+   *                           zero-filling, if you'll write every pixel.
+   * \param[in] pool ImagePool to borrow pixel memory from, or 0.
+   */
+  Image(const CameraData& cameraData, int width, int height,
+      ImageBuffer::Initialization initialization = ImageBuffer::ZERO_FILL,
+      ImagePool* pool = 0)
+    : mProfile(cameraData, width, height), mWidth(width), mHeight(height),
+    mBuffer(bufferSize(), initialization, pool),
+    mPixels(reinterpret_cast<PixelType*>(mBuffer.data()))
+  {
+  }
+
+  /**
+   * Constructor.
+   *
+   * This is how to build one Image from another: the new Image gets a copy
+   * of the old one's profile, so nothing needs to be looked up again.
+   *
+   * \param[in] profile CameraProfile that applies to the photograph.
+   * \param[in] width Image width in pixels.
+   * \param[in] height Image height in pixels.
+   * \param[in] initialization Pass ImageBuffer::UNINITIALIZED to skip
+   *                           zero-filling, if you'll write every pixel.
+   * \param[in] pool ImagePool to borrow pixel memory from, or 0.
+   */
+  Image(const CameraProfile& profile, int width, int height,
+      ImageBuffer::Initialization initialization = ImageBuffer::ZERO_FILL,
+      ImagePool* pool = 0)
+    : mProfile(profile), mWidth(width), mHeight(height),
+    mBuffer(bufferSize(), initialization, pool),
+    mPixels(reinterpret_cast<PixelType*>(mBuffer.data()))
+  {
+  }
+
+  /**
+   * Copy constructor.
+   *
+   * \param[in] rhs Original Image, whose pixels are copied.
    */
-  Image(const CameraData& cameraData, int width, int height)
-    : mCameraData(cameraData), mWidth(width), mHeight(height),
-    mFilters(mCameraData.filters())
+  Image(const Image& rhs)
+    : mProfile(rhs.mProfile), mWidth(rhs.mWidth), mHeight(rhs.mHeight),
+    mBuffer(rhs.mBuffer),
+    mPixels(reinterpret_cast<PixelType*>(mBuffer.data()))
   {
-    this->allocate();
   }
 
   /**
-   * The photograph CameraData.
+   * Assignment operator.
+   *
+   * \param[in] rhs Original Image, whose pixels are copied.
+   * \return This Image.
    */
-  const CameraData& cameraData() const { return mCameraData; }
+  Image& operator=(const Image& rhs)
+  {
+    mProfile = rhs.mProfile;
+    mWidth = rhs.mWidth;
+    mHeight = rhs.mHeight;
+    mBuffer = rhs.mBuffer;
+    mPixels = reinterpret_cast<PixelType*>(mBuffer.data());
+    return *this;
+  }
+
+  /**
+   * The photograph's CameraProfile, resolved when the Image was built.
+   */
+  const CameraProfile& profile() const { return mProfile; }
+  /**
+   * The ImagePool this Image's pixels were borrowed from, or 0.
+   */
+  ImagePool* pool() const { return mBuffer.pool(); }
   /**
    * Image width in pixels.
    */
@@ -380,17 +442,21 @@ public:
   /**
    * Number of pixels in the Image.
    */
-  unsigned int nPixels() const { return mWidth * mHeight; }
+  std::size_t nPixels() const {
+    return static_cast<std::size_t>(mWidth) * mHeight;
+  }
   /**
-   * Filters (cached from cameraData()) FIXME remove this.
+   * The camera sensor color pattern, from profile().
    */
-  unsigned int filters() const { return mFilters; }
+  unsigned int filters() const { return mProfile.filters(); }
   /**
-   * Filters (cached from cameraData()) FIXME remove this.
+   * Overrides the camera sensor color pattern in profile().
    *
    * \param[in] filters New filters to set.
    */
-  void setFilters(unsigned int filters) { mFilters = filters; }
+  void setFilters(unsigned int filters) {
+    mProfile = mProfile.withFilters(filters);
+  }
 
   /**
    * The color of the camera sensor array at this point.
@@ -405,7 +471,7 @@ public:
   ColorType colorAtPoint(const Point& point) const {
     int row = point.row;
     int col = point.col;
-    return (mFilters >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
+    return (mProfile.filters() >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
   }
   /**
    * The color of the camera sensor array at this point.
@@ -442,20 +508,20 @@ public:
    *
    * \return A pixel pointer.
    */
-  PixelType* pixels() { return &mPixels[0]; }
+  PixelType* pixels() { return mPixels; }
   /**
    * A pointer to one past the last pixel in the image, useful for iterating.
    */
-  PixelType* pixelsEnd() { return &mPixels[mWidth * mHeight]; }
+  PixelType* pixelsEnd() { return mPixels + nPixels(); }
 
   /**
    * A pointer to the first pixel in the image, useful for iterating.
    */
-  const PixelType* constPixels() const { return &mPixels[0]; }
+  const PixelType* constPixels() const { return mPixels; }
   /**
    * A pointer to one past the last pixel in the image, useful for iterating.
    */
-  const PixelType* constPixelsEnd() const { return &mPixels[mWidth * mHeight]; }
+  const PixelType* constPixelsEnd() const { return mPixels + nPixels(); }
 
   /**
    * A pointer to the first pixel in the given row, useful for iterating.
@@ -464,7 +530,7 @@ public:
    * \return A pixel pointer.
    */
   const PixelType* constPixelsAtRow(int row) const {
-    return &mPixels[row * mWidth];
+    return &mPixels[static_cast<std::ptrdiff_t>(row) * mWidth];
   }
   /**
    * A pointer to the first pixel in the given row, useful for iterating.
@@ -473,7 +539,7 @@ public:
    * \return A pixel pointer.
    */
   PixelType* pixelsAtRow(int row) {
-    return &mPixels[row * mWidth];
+    return &mPixels[static_cast<std::ptrdiff_t>(row) * mWidth];
   }
 
   /**
@@ -483,8 +549,8 @@ public:
    * \return A pixel pointer.
    */
   PixelType* pixelsAtPoint(const Point& point) {
-    int row = point.row;
-    int col = point.col;
+    const std::ptrdiff_t row = point.row;
+    const std::ptrdiff_t col = point.col;
     return &mPixels[row * mWidth + col];
   }
   /**
@@ -504,8 +570,8 @@ public:
    * \return A pixel pointer.
    */
   const PixelType* constPixelsAtPoint(const Point& point) const {
-    int row = point.row;
-    int col = point.col;
+    const std::ptrdiff_t row = point.row;
+    const std::ptrdiff_t col = point.col;
     return &mPixels[row * mWidth + col];
   }
   /**
@@ -549,10 +615,79 @@ public:
 typedef RGBPixel<unsigned short> u16RGBPixel;
 typedef LABPixel<short> s16LABPixel;
 typedef GrayPixel<unsigned short> u16GrayPixel;
+typedef RGBPixel<float> f32RGBPixel;
+typedef GrayPixel<float> f32GrayPixel;
 
 typedef Image<u16RGBPixel> RGBImage;
 typedef Image<s16LABPixel> LABImage;
 typedef Image<u16GrayPixel> GrayImage;
+typedef Image<f32RGBPixel> FloatRGBImage; /**< See quantize.h */
+typedef Image<f32GrayPixel> FloatGrayImage; /**< See quantize.h */
+
+/**
+ * Copies an Image into a bigger one, mirroring it into a border.
+ *
+ * Each border pixel copies the pixel as far inside the edge as it is
+ * outside it, without repeating the edge itself: column -1 copies column 1
+ * and column -2 copies column 2. If the sensor pattern repeats every two
+ * rows, as Bayer patterns do, that keeps every pixel's sensor color: the
+ * padded sensor image is still a sensor image, and an Interpolator can
+ * treat its border exactly like its interior.
+ *
+ * The filters() of \p outImage are set to match its new top-left corner.
+ *
+ * \param[in] image Source Image.
+ * \param[in] border Pixels to add on each side: fewer than the width and
+ *                   height of \p image.
+ * \param[out] outImage Destination, <tt>2 * border</tt> pixels wider and
+ *                      taller than \p image.
+ * \throw std::invalid_argument if the border or \p outImage don't fit.
+ */
+template<typename T>
+void mirrorPad(const Image<T>& image, unsigned int border, Image<T>& outImage)
+{
+  const int width = image.width();
+  const int height = image.height();
+  const int b = border;
+
+  if (b >= width || b >= height
+      || static_cast<int>(outImage.width()) != width + 2 * b
+      || static_cast<int>(outImage.height()) != height + 2 * b) {
+    throw std::invalid_argument(
+        "mirrorPad needs a border smaller than the image and an output "
+        "image that size bigger");
+  }
+
+  // Padded (row, col) has the color of original (row - b, col - b)
+  unsigned int filters = 0;
+  for (int row = 0; row < 8; row++) {
+    for (int col = 0; col < 2; col++) {
+      const unsigned int c = image.colorAtPoint(row + 8 - b % 8, col + b);
+      filters |= c << (((row << 1 & 14) | (col & 1)) << 1);
+    }
+  }
+  outImage.setFilters(filters);
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+  for (int row = 0; row < height + 2 * b; row++) {
+    int y = row - b;
+    if (y < 0) y = -y;
+    if (y >= height) y = 2 * (height - 1) - y;
+
+    const T* in(image.constPixelsAtPoint(y, 0));
+    T* out(outImage.pixelsAtPoint(row, 0));
+
+    for (int x = 0; x < b; x++) {
+      out[x] = in[b - x];
+    }
+    std::copy(in, in + width, out + b);
+    for (int x = 0; x < b; x++) {
+      out[b + width + x] = in[width - 2 - x];
+    }
+  }
+}
 
 }; /* namespace refinery */
 
@@ -0,0 +1,173 @@
+#ifndef _REFINERY_IMAGE_BUFFER_H
+#define _REFINERY_IMAGE_BUFFER_H
+
+#include <cstddef>
+#include <string>
+
+namespace refinery {
+
+class ImagePool;
+
+/**
+ * Raw, aligned pixel storage for an Image.
+ *
+ * Images can run to hundreds of megabytes, so how that memory is obtained
+ * matters:
+ *
+ * - It's always aligned to at least ImageBuffer::Alignment bytes, so rows
+ *   start on cache-line (and SIMD-register) boundaries when widths allow.
+ * - It can be left uninitialized. Most Images are about to be overwritten
+ *   anyway, and zero-filling them first just wastes memory bandwidth.
+ * - When zero-filling is wanted, it's done by all threads in parallel, so
+ *   pages are first touched by the threads that will likely use them.
+ * - Large buffers are advised to use transparent huge pages (where the
+ *   platform supports it), which cuts TLB misses on big images.
+ * - Buffers past a configurable size can live in a memory-mapped temporary
+ *   file instead of RAM (see setFileBackingThreshold()). Stitched panoramas
+ *   and their interpolation can then exceed physical memory: the kernel
+ *   pages rows in and out as filters and the Interpolator sweep through
+ *   them band by band.
+ *
+ * ImageBuffer copies are deep.
+ *
+ * An ImageBuffer may borrow its memory from an ImagePool, in which case it
+ * returns the memory to that pool when it's destroyed.
+ */
+class ImageBuffer {
+public:
+  /**
+   * What a new ImageBuffer holds, to pass to the constructor.
+   */
+  enum Initialization {
+    ZERO_FILL, /**< Every byte is 0. */
+    UNINITIALIZED /**< Garbage: the caller promises to write every byte. */
+  };
+
+  /** Minimum alignment of data(), in bytes. */
+  static const std::size_t Alignment = 64;
+
+private:
+  unsigned char* mData;
+  std::size_t mSize;
+  std::size_t mCapacity;
+  ImagePool* mPool;
+  bool mFileBacked;
+
+  void allocate(std::size_t size);
+  void mapFile(std::size_t size);
+  void release();
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] size Size in bytes.
+   * \param[in] initialization Whether to zero-fill the buffer.
+   * \param[in] pool ImagePool to borrow memory from, or 0.
+   */
+  explicit ImageBuffer(
+      std::size_t size = 0, Initialization initialization = ZERO_FILL,
+      ImagePool* pool = 0);
+
+  /**
+   * Copy constructor.
+   *
+   * The copy borrows from the same ImagePool as the original.
+   *
+   * \param[in] rhs Original ImageBuffer, whose bytes are copied.
+   */
+  ImageBuffer(const ImageBuffer& rhs);
+
+  /**
+   * Assignment operator.
+   *
+   * \param[in] rhs Original ImageBuffer, whose bytes are copied.
+   * \return This ImageBuffer.
+   */
+  ImageBuffer& operator=(const ImageBuffer& rhs);
+
+  ~ImageBuffer(); /**< Destructor. */
+
+  /**
+   * The first byte of the buffer, aligned to Alignment.
+   */
+  unsigned char* data() { return mData; }
+  /**
+   * The first byte of the buffer, aligned to Alignment.
+   */
+  const unsigned char* data() const { return mData; }
+  /**
+   * Size of the buffer, in bytes.
+   */
+  std::size_t size() const { return mSize; }
+  /**
+   * The ImagePool this buffer borrows from, or 0.
+   */
+  ImagePool* pool() const { return mPool; }
+  /**
+   * \c true if this buffer is a memory-mapped temporary file.
+   *
+   * File-backed buffers never come from (or go back to) an ImagePool.
+   */
+  bool fileBacked() const { return mFileBacked; }
+
+  /**
+   * Whether large buffers are advised to use transparent huge pages.
+   *
+   * This is on by default, and does nothing on platforms without
+   * MADV_HUGEPAGE.
+   */
+  static bool hugePagesEnabled();
+
+  /**
+   * Turns transparent huge pages on or off for future buffers.
+   *
+   * Call this before starting any threads.
+   *
+   * \param[in] enabled \c true to advise huge pages.
+   */
+  static void setHugePagesEnabled(bool enabled);
+
+  /**
+   * Buffers at least this many bytes big are backed by a file, or 0.
+   *
+   * The default is 0: every buffer is in RAM.
+   */
+  static std::size_t fileBackingThreshold();
+
+  /**
+   * Makes future buffers of at least \p threshold bytes file-backed.
+   *
+   * Each such buffer maps its own temporary file, which is deleted from the
+   * directory right away and vanishes when the buffer does. Zero-filled
+   * file-backed buffers cost nothing up front: a new file reads as zeroes.
+   *
+   * Call this before starting any threads.
+   *
+   * \param[in] threshold Minimum size in bytes, or 0 to disable.
+   * \see setFileBackingDirectory()
+   */
+  static void setFileBackingThreshold(std::size_t threshold);
+
+  /**
+   * Where file-backed buffers' temporary files go.
+   *
+   * The default is empty, meaning \c $TMPDIR or else \c /tmp.
+   */
+  static std::string fileBackingDirectory();
+
+  /**
+   * Puts future file-backed buffers' temporary files in \p directory.
+   *
+   * Pick a local disk with room for the biggest images.
+   *
+   * Call this before starting any threads.
+   *
+   * \param[in] directory Directory path, or empty for the default.
+   */
+  static void setFileBackingDirectory(const std::string& directory);
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_IMAGE_BUFFER_H */
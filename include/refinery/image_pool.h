@@ -0,0 +1,109 @@
+#ifndef _REFINERY_IMAGE_POOL_H
+#define _REFINERY_IMAGE_POOL_H
+
+#include <cstddef>
+
+namespace refinery {
+
+/**
+ * Recycles ImageBuffer memory, so same-sized Images don't cost allocations.
+ *
+ * Allocating a fresh 100MB buffer means mapping new pages and having the
+ * kernel fault in (and zero) every one of them; freeing it hands them all
+ * back. When a program processes image after image of the same size, an
+ * ImagePool skips that: a destroyed Image's buffer goes back to the pool,
+ * and the next Image of that size class reuses it.
+ *
+ * Pass an ImagePool to ImageReader::setImagePool() and
+ * Interpolator::setImagePool() (or straight to an Image constructor):
+ *
+ * \code
+ * refinery::ImagePool pool(1024 * 1024 * 1024); // keep up to 1GB idle
+ *
+ * refinery::ImageReader reader;
+ * reader.setImagePool(&pool);
+ * refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+ * interpolator.setImagePool(&pool);
+ *
+ * for (...) {
+ *   std::auto_ptr<GrayImage> gray(reader.readGrayImage(file, exifData));
+ *   std::auto_ptr<RGBImage> rgb(interpolator.interpolate(*gray));
+ *   // ...
+ * } // the buffers go back to the pool
+ * \endcode
+ *
+ * Buffers are grouped by size class (sizes are rounded up by at most 1/8),
+ * so images which differ by a few pixels can share buffers.
+ *
+ * The pool only holds idle buffers; maxBytes() caps how much idle memory it
+ * keeps. Buffers returned beyond that are freed as usual.
+ *
+ * An ImagePool is thread-safe. It must outlive every Image allocated from it.
+ */
+class ImagePool {
+  class Impl;
+  Impl* impl;
+
+  friend class ImageBuffer;
+
+  /*
+   * Returns an idle buffer of exactly \p capacity bytes, or 0.
+   */
+  unsigned char* take(std::size_t capacity);
+
+  /*
+   * Keeps \p data for reuse and returns true, or returns false (and leaves
+   * it to the caller to free) if that would exceed maxBytes().
+   */
+  bool give(unsigned char* data, std::size_t capacity);
+
+  ImagePool(const ImagePool&);
+  ImagePool& operator=(const ImagePool&);
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] maxBytes Most idle memory to keep, in bytes.
+   */
+  explicit ImagePool(std::size_t maxBytes);
+
+  /**
+   * Destructor, which frees every idle buffer.
+   */
+  ~ImagePool();
+
+  /**
+   * The most idle memory this pool will keep, in bytes.
+   */
+  std::size_t maxBytes() const;
+
+  /**
+   * Changes maxBytes(), freeing idle buffers if needed.
+   *
+   * \param[in] maxBytes Most idle memory to keep, in bytes.
+   */
+  void setMaxBytes(std::size_t maxBytes);
+
+  /**
+   * How much idle memory the pool holds right now, in bytes.
+   */
+  std::size_t idleBytes() const;
+
+  /**
+   * Frees every idle buffer.
+   */
+  void clear();
+
+  /**
+   * The capacity a buffer of \p size bytes really gets.
+   *
+   * \param[in] size Requested size, in bytes.
+   * \return \p size, rounded up to its size class.
+   */
+  static std::size_t sizeClass(std::size_t size);
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_IMAGE_POOL_H */
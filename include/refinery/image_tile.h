@@ -1,6 +1,11 @@
 #ifndef _REFINERY_IMAGE_TILE_H
 #define _REFINERY_IMAGE_TILE_H
 
+#include <algorithm>
+#include <vector>
+
+#include <refinery/memory_stats.h>
+
 namespace refinery {
 
 /**
@@ -23,10 +28,12 @@ private:
   Point mSize;
   unsigned int mEdgeSize;
   PixelsType mPixels;
+  MemoryStats::Counter mMemory;
 
   void allocate()
   {
     mPixels.assign(mSize.row * mSize.col, PixelType());
+    mMemory.resize(mPixels.size() * sizeof(PixelType));
   }
 
   std::ptrdiff_t offsetForImagePoint(const Point& imagePoint) const
@@ -51,7 +58,8 @@ public:
       const Point& imageSize, const Point& topLeft, const Point& size,
       unsigned int border, unsigned int margin)
     : mImageSize(imageSize), mTopLeft(topLeft), mSize(size),
-      mEdgeSize(static_cast<unsigned int>(border - margin))
+      mEdgeSize(static_cast<unsigned int>(border - margin)),
+      mMemory(MemoryStats::TILES)
   {
     this->allocate();
   }
@@ -97,6 +105,14 @@ public:
         mTopLeft.col + mSize.col);
   }
 
+  /**
+   * Sets a new full-Image size, repurposing this scratch-pad for another
+   * Image.
+   *
+   * The tile keeps its size and memory.
+   */
+  void setImageSize(const Point& imageSize) { mImageSize = imageSize; }
+
   /**
    * Sets a new top-left, repurposing this scratch-pad.
    */
@@ -0,0 +1,260 @@
+#ifndef _REFINERY_IMAGE_VIEW_H
+#define _REFINERY_IMAGE_VIEW_H
+
+#include <cstddef>
+
+#include <boost/type_traits/remove_const.hpp>
+
+#include <refinery/camera.h>
+#include <refinery/image.h>
+
+namespace refinery {
+
+/**
+ * A rectangle of an Image's pixels, without a copy.
+ *
+ * An ImageView points into an Image: it has an origin (its top-left pixel,
+ * in Image coordinates), a size and a stride (the Image's width). It owns
+ * nothing, so the Image must outlive it.
+ *
+ * Filters and ImageWriter accept ImageViews just like Images, so a crop is
+ * as cheap as constructing one:
+ *
+ * \code
+ * RGBImage& image(...);
+ * ConstRGBImageView crop(image, Point(100, 200), Point(480, 640));
+ * ImageWriter writer;
+ * writer.writeImage(crop, "crop.ppm");
+ * \endcode
+ *
+ * colorAtPoint() still reports the camera sensor color of the underlying
+ * Image pixel, so raw (GrayImage) views can be filtered as well.
+ *
+ * \tparam T The type of Pixel in the grid. Make it \c const for a read-only
+ *           view.
+ */
+template<typename T>
+class ImageView {
+public:
+  typedef T PixelType; /**< Type of each pixel (maybe const). */
+  typedef typename T::ValueType ValueType; /**< Color value type. */
+  typedef typename T::ColorType ColorType; /**< Color index type. */
+
+private:
+  typedef typename boost::remove_const<T>::type MutablePixelType;
+
+  const CameraProfile* mProfile;
+  PixelType* mPixels; // pixel at mOrigin
+  Point mOrigin;
+  int mWidth;
+  int mHeight;
+  std::ptrdiff_t mStride;
+
+public:
+  /**
+   * A view of a whole Image.
+   *
+   * \param[in] image Image, which must outlive this view.
+   */
+  ImageView(Image<MutablePixelType>& image)
+    : mProfile(&image.profile()), mPixels(image.pixels()), mOrigin(0, 0),
+    mWidth(image.width()), mHeight(image.height()), mStride(image.width())
+  {
+  }
+
+  /**
+   * A read-only view of a whole Image.
+   *
+   * Only ImageViews of \c const pixels can be built this way.
+   *
+   * \param[in] image Image, which must outlive this view.
+   */
+  ImageView(const Image<MutablePixelType>& image)
+    : mProfile(&image.profile()), mPixels(image.constPixels()),
+    mOrigin(0, 0), mWidth(image.width()), mHeight(image.height()),
+    mStride(image.width())
+  {
+  }
+
+  /**
+   * A view of a rectangle within an Image.
+   *
+   * \param[in] image Image, which must outlive this view.
+   * \param[in] origin Top-left pixel of the rectangle.
+   * \param[in] size Height and width of the rectangle.
+   */
+  ImageView(Image<MutablePixelType>& image, const Point& origin,
+      const Point& size)
+    : mProfile(&image.profile()), mPixels(image.pixelsAtPoint(origin)),
+    mOrigin(origin), mWidth(size.col), mHeight(size.row),
+    mStride(image.width())
+  {
+  }
+
+  /**
+   * A read-only view of a rectangle within an Image.
+   *
+   * Only ImageViews of \c const pixels can be built this way.
+   *
+   * \param[in] image Image, which must outlive this view.
+   * \param[in] origin Top-left pixel of the rectangle.
+   * \param[in] size Height and width of the rectangle.
+   */
+  ImageView(const Image<MutablePixelType>& image, const Point& origin,
+      const Point& size)
+    : mProfile(&image.profile()), mPixels(image.constPixelsAtPoint(origin)),
+    mOrigin(origin), mWidth(size.col), mHeight(size.row),
+    mStride(image.width())
+  {
+  }
+
+  /**
+   * A view of pixels that don't belong to an Image.
+   *
+   * Use this to wrap a buffer allocated elsewhere, such as another library's
+   * frame buffer.
+   *
+   * \param[in] profile CameraProfile that applies to the pixels, which must
+   *                    outlive this view.
+   * \param[in] pixels First pixel of the first row.
+   * \param[in] width View width in pixels.
+   * \param[in] height View height in pixels.
+   * \param[in] stride Distance from one row to the next, in pixels.
+   */
+  ImageView(const CameraProfile& profile, PixelType* pixels, int width,
+      int height, std::ptrdiff_t stride)
+    : mProfile(&profile), mPixels(pixels), mOrigin(0, 0), mWidth(width),
+    mHeight(height), mStride(stride)
+  {
+  }
+
+  /**
+   * A view of a rectangle within another view.
+   *
+   * \param[in] view Parent view.
+   * \param[in] origin Top-left pixel of the rectangle, relative to \p view.
+   * \param[in] size Height and width of the rectangle.
+   */
+  ImageView(const ImageView& view, const Point& origin, const Point& size)
+    : mProfile(view.mProfile),
+    mPixels(view.mPixels + origin.row * view.mStride + origin.col),
+    mOrigin(view.mOrigin + origin), mWidth(size.col), mHeight(size.row),
+    mStride(view.mStride)
+  {
+  }
+
+  /**
+   * The photograph's CameraProfile, from the underlying Image.
+   */
+  const CameraProfile& profile() const { return *mProfile; }
+  /**
+   * This view's top-left pixel, in Image coordinates.
+   */
+  const Point& origin() const { return mOrigin; }
+  /**
+   * View width in pixels.
+   */
+  unsigned int width() const { return mWidth; }
+  /**
+   * View height in pixels.
+   */
+  unsigned int height() const { return mHeight; }
+  /**
+   * Number of pixels in the view.
+   */
+  std::size_t nPixels() const {
+    return static_cast<std::size_t>(mWidth) * mHeight;
+  }
+  /**
+   * Distance from one row to the next, in pixels.
+   */
+  std::ptrdiff_t stride() const { return mStride; }
+  /**
+   * The camera sensor color pattern, from profile().
+   */
+  unsigned int filters() const { return mProfile->filters(); }
+
+  /**
+   * The color of the camera sensor array at this point.
+   *
+   * \param[in] point Point in question, relative to this view.
+   * \return Color in the sensor array, as reported by the camera.
+   */
+  ColorType colorAtPoint(const Point& point) const {
+    const int row = mOrigin.row + point.row;
+    const int col = mOrigin.col + point.col;
+    return (mProfile->filters() >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
+  }
+  /**
+   * The color of the camera sensor array at this point.
+   *
+   * \param[in] row Pixel row (from the top of this view).
+   * \param[in] col Pixel column (from the left of this view).
+   * \return Color in the sensor array, as reported by the camera.
+   */
+  ColorType colorAtPoint(unsigned int row, unsigned int col) const {
+    return colorAtPoint(Point(row, col));
+  }
+
+  /**
+   * A pointer to the first pixel in the given row of this view.
+   *
+   * Only the next width() pixels belong to the view.
+   *
+   * \param[in] row Pixel row (from the top of this view).
+   * \return A pixel pointer.
+   */
+  PixelType* pixelsAtRow(int row) const { return mPixels + row * mStride; }
+  /**
+   * A pointer to the first pixel in the given row of this view.
+   *
+   * \param[in] row Pixel row (from the top of this view).
+   * \return A pixel pointer.
+   */
+  const PixelType* constPixelsAtRow(int row) const {
+    return mPixels + row * mStride;
+  }
+
+  /**
+   * A pointer to the specified pixel.
+   *
+   * \param[in] row Pixel row (from the top of this view).
+   * \param[in] col Pixel column (from the left of this view).
+   * \return A pixel pointer.
+   */
+  PixelType* pixelsAtPoint(unsigned int row, unsigned int col) const {
+    return mPixels + row * mStride + col;
+  }
+  /**
+   * A pointer to the specified pixel.
+   *
+   * \param[in] row Pixel row (from the top of this view).
+   * \param[in] col Pixel column (from the left of this view).
+   * \return A pixel pointer.
+   */
+  const PixelType* constPixelsAtPoint(unsigned int row, unsigned int col) const {
+    return mPixels + row * mStride + col;
+  }
+
+  /**
+   * The pixel at the specified point.
+   */
+  PixelType& pixelAtPoint(unsigned int row, unsigned int col) const {
+    return *pixelsAtPoint(row, col);
+  }
+  /**
+   * The pixel at the specified point.
+   */
+  const PixelType& constPixelAtPoint(unsigned int row, unsigned int col) const {
+    return *constPixelsAtPoint(row, col);
+  }
+};
+
+typedef ImageView<u16RGBPixel> RGBImageView;
+typedef ImageView<const u16RGBPixel> ConstRGBImageView;
+typedef ImageView<u16GrayPixel> GrayImageView;
+typedef ImageView<const u16GrayPixel> ConstGrayImageView;
+
+} // namespace refinery
+
+#endif /* _REFINERY_IMAGE_VIEW_H */
@@ -0,0 +1,166 @@
+#ifndef _REFINERY_MEMORY_STATS_H
+#define _REFINERY_MEMORY_STATS_H
+
+#include <cstddef>
+
+namespace refinery {
+
+/**
+ * Counts the bytes refinery holds, by category, with high-water marks.
+ *
+ * Decoding a raw file holds a decoder's working arrays and a GrayImage;
+ * interpolating holds that GrayImage, an RGBImage and a set of tiles per
+ * thread. How much that adds up to decides how many files a host can work
+ * on at once. MemoryStats answers it:
+ *
+ * \code
+ * refinery::MemoryStats::resetPeaks();
+ * std::auto_ptr<GrayImage> gray(reader.readGrayImage(fb, exifData));
+ * std::auto_ptr<RGBImage> rgb(interpolator.interpolate(*gray));
+ * // ...
+ * refinery::MemoryStats stats(refinery::MemoryStats::snapshot());
+ * std::cout << stats.total.peak << " bytes at most" << std::endl;
+ * \endcode
+ *
+ * Counting is process-wide and thread-safe (each update is one or two atomic
+ * instructions). It covers the big allocations only: Image buffers, ImageTile
+ * scratch-pads, decoder state and caches. File-backed ImageBuffers aren't
+ * counted, since the kernel pages them out as it sees fit.
+ */
+struct MemoryStats {
+  /**
+   * What memory is for.
+   */
+  enum Category {
+    IMAGES, /**< ImageBuffers: the pixels of Images and PlanarImages. */
+    TILES, /**< Interpolator scratch: ImageTiles and streamed rows. */
+    DECODERS, /**< Raw-file decoders' working state. */
+    CACHES, /**< Idle ImagePool buffers and CompressedImage tiles. */
+    NCategories /**< Number of categories (not a category). */
+  };
+
+  /**
+   * Bytes in use now and at most.
+   */
+  struct Usage {
+    std::size_t current; /**< Bytes in use now. */
+    std::size_t peak; /**< Most bytes in use at once since resetPeaks(). */
+  };
+
+  Usage total; /**< All categories together. */
+  Usage categories[NCategories]; /**< Each Category. */
+
+  /**
+   * The counts right now.
+   *
+   * The total's peak is the most bytes ever held at once, which can be less
+   * than the sum of the categories' peaks.
+   */
+  static MemoryStats snapshot();
+
+  /**
+   * Sets every peak to its current value.
+   *
+   * Call this between stages to measure each one's high-water mark.
+   */
+  static void resetPeaks();
+
+  /**
+   * A short lowercase name for \p category, such as "images".
+   */
+  static const char* categoryName(Category category);
+
+  /**
+   * Counts \p bytes as newly in use.
+   *
+   * \param[in] category What the memory is for.
+   * \param[in] bytes Number of bytes.
+   */
+  static void allocated(Category category, std::size_t bytes);
+
+  /**
+   * Counts \p bytes as no longer in use.
+   *
+   * \param[in] category What the memory was for, as passed to allocated().
+   * \param[in] bytes Number of bytes.
+   */
+  static void freed(Category category, std::size_t bytes);
+
+  /**
+   * Counts a block of memory for as long as it lives.
+   *
+   * Make one a member of whatever owns the memory and resize() it along
+   * with the memory. Copies count the same bytes again.
+   */
+  class Counter {
+    Category mCategory;
+    std::size_t mBytes;
+
+  public:
+    /**
+     * Constructor.
+     *
+     * \param[in] category What the memory is for.
+     * \param[in] bytes Number of bytes to count to start with.
+     */
+    explicit Counter(Category category, std::size_t bytes = 0)
+      : mCategory(category), mBytes(bytes)
+    {
+      if (mBytes) allocated(mCategory, mBytes);
+    }
+
+    /**
+     * Copy constructor: counts the original's bytes again.
+     *
+     * \param[in] rhs Original Counter.
+     */
+    Counter(const Counter& rhs)
+      : mCategory(rhs.mCategory), mBytes(rhs.mBytes)
+    {
+      if (mBytes) allocated(mCategory, mBytes);
+    }
+
+    /**
+     * Assignment operator: counts the original's bytes instead.
+     *
+     * \param[in] rhs Original Counter.
+     * \return This Counter.
+     */
+    Counter& operator=(const Counter& rhs)
+    {
+      if (this != &rhs) {
+        if (mBytes) freed(mCategory, mBytes);
+        mCategory = rhs.mCategory;
+        mBytes = rhs.mBytes;
+        if (mBytes) allocated(mCategory, mBytes);
+      }
+      return *this;
+    }
+
+    ~Counter() /**< Destructor: stops counting. */
+    {
+      if (mBytes) freed(mCategory, mBytes);
+    }
+
+    /**
+     * Number of bytes being counted.
+     */
+    std::size_t bytes() const { return mBytes; }
+
+    /**
+     * Counts \p bytes instead.
+     *
+     * \param[in] bytes New number of bytes.
+     */
+    void resize(std::size_t bytes)
+    {
+      if (bytes > mBytes) allocated(mCategory, bytes - mBytes);
+      if (bytes < mBytes) freed(mCategory, mBytes - bytes);
+      mBytes = bytes;
+    }
+  };
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_MEMORY_STATS_H */
@@ -8,6 +8,8 @@ namespace refinery {
 template<typename T> class RGBPixel;
 template<typename T> class Image;
 typedef Image<RGBPixel<unsigned short> > RGBImage;
+template<typename T> class ImageView;
+typedef ImageView<const RGBPixel<unsigned short> > ConstRGBImageView;
 
 /**
  * Outputs images in PPM format.
@@ -37,6 +39,28 @@ public:
    */
   void writeImage(
       const RGBImage& image, const char* filename, unsigned int colorDepth = 8);
+
+  /**
+   * Writes part of an image as PPM to an output stream.
+   *
+   * \param[in] view 16-bit RGB image view, such as a crop.
+   * \param[in] ostream Output stream where PPM data will be written.
+   * \param[in] colorDepth 8 or 16, for 8-bit or 16-bit output.
+   */
+  void writeImage(
+      const ConstRGBImageView& view, std::ostream& ostream,
+      unsigned int colorDepth = 8);
+
+  /**
+   * Writes part of an image as PPM to an output stream.
+   *
+   * \param[in] view 16-bit RGB image view, such as a crop.
+   * \param[in] filename Output filename where PPM data will be written.
+   * \param[in] colorDepth 8 or 16, for 8-bit or 16-bit output.
+   */
+  void writeImage(
+      const ConstRGBImageView& view, const char* filename,
+      unsigned int colorDepth = 8);
 };
 
 } // namespace refinery
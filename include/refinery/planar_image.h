@@ -0,0 +1,255 @@
+#ifndef _REFINERY_PLANAR_IMAGE_H
+#define _REFINERY_PLANAR_IMAGE_H
+
+#include <refinery/camera.h>
+#include <refinery/image.h>
+#include <refinery/image_buffer.h>
+
+namespace refinery {
+
+class ImagePool;
+
+/**
+ * A grid of pixels stored one color plane at a time.
+ *
+ * An Image stores each pixel's colors together ("RGBRGBRGB..."), which is
+ * handy but awkward for SIMD: a 6-byte RGB pixel never lines up with a
+ * vector register. A PlanarImage stores all the reds, then all the greens,
+ * then all the blues. Each plane is aligned to ImageBuffer::Alignment and
+ * each row is padded to a multiple of it, so a loop over one row of one
+ * plane is a plain, aligned array loop that the compiler can vectorize.
+ *
+ * Use deinterleave() and interleave() to convert to and from an Image at the
+ * edges of a pipeline. In between, Interpolator::interpolateToPlanar(),
+ * ConvertToRgbFilter, GammaFilter and Histogram all work on PlanarImages
+ * directly.
+ *
+ * \tparam T Type of each color value (e.g.\ unsigned short).
+ * \tparam N Number of colors (planes).
+ */
+template<typename T, unsigned int N>
+class PlanarImage {
+public:
+  typedef T ValueType; /**< Color value type. */
+  typedef Pixel<T, N> PixelType; /**< Type of one pixel, when gathered. */
+  typedef typename PixelType::ColorType ColorType; /**< Color index type. */
+  static const ColorType NColors = N; /**< Number of colors (planes). */
+
+private:
+  CameraProfile mProfile;
+  int mWidth;
+  int mHeight;
+  std::size_t mRowStride;
+  ImageBuffer mBuffer;
+  ValueType* mPlanes;
+
+  static std::size_t paddedRowStride(int width)
+  {
+    const std::size_t valuesPerLine = ImageBuffer::Alignment / sizeof(T);
+    return (width + valuesPerLine - 1) / valuesPerLine * valuesPerLine;
+  }
+
+  std::size_t planeSize() const { return mRowStride * mHeight; }
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] profile CameraProfile that applies to the photograph.
+   * \param[in] width Image width in pixels.
+   * \param[in] height Image height in pixels.
+   * \param[in] initialization Pass ImageBuffer::UNINITIALIZED to skip
+   *                           zero-filling, if you'll write every pixel.
+   * \param[in] pool ImagePool to borrow pixel memory from, or 0.
+   */
+  PlanarImage(const CameraProfile& profile, int width, int height,
+      ImageBuffer::Initialization initialization = ImageBuffer::ZERO_FILL,
+      ImagePool* pool = 0)
+    : mProfile(profile), mWidth(width), mHeight(height),
+    mRowStride(paddedRowStride(width)),
+    mBuffer(N * planeSize() * sizeof(T), initialization, pool),
+    mPlanes(reinterpret_cast<ValueType*>(mBuffer.data()))
+  {
+  }
+
+  /**
+   * Copy constructor.
+   *
+   * \param[in] rhs Original PlanarImage, whose pixels are copied.
+   */
+  PlanarImage(const PlanarImage& rhs)
+    : mProfile(rhs.mProfile), mWidth(rhs.mWidth), mHeight(rhs.mHeight),
+    mRowStride(rhs.mRowStride), mBuffer(rhs.mBuffer),
+    mPlanes(reinterpret_cast<ValueType*>(mBuffer.data()))
+  {
+  }
+
+  /**
+   * Assignment operator.
+   *
+   * \param[in] rhs Original PlanarImage, whose pixels are copied.
+   * \return This PlanarImage.
+   */
+  PlanarImage& operator=(const PlanarImage& rhs)
+  {
+    mProfile = rhs.mProfile;
+    mWidth = rhs.mWidth;
+    mHeight = rhs.mHeight;
+    mRowStride = rhs.mRowStride;
+    mBuffer = rhs.mBuffer;
+    mPlanes = reinterpret_cast<ValueType*>(mBuffer.data());
+    return *this;
+  }
+
+  /**
+   * The photograph's CameraProfile.
+   */
+  const CameraProfile& profile() const { return mProfile; }
+  /**
+   * Image width in pixels.
+   */
+  unsigned int width() const { return mWidth; }
+  /**
+   * Image height in pixels.
+   */
+  unsigned int height() const { return mHeight; }
+  /**
+   * Number of pixels in the image.
+   */
+  std::size_t nPixels() const {
+    return static_cast<std::size_t>(mWidth) * mHeight;
+  }
+  /**
+   * Distance from one row to the next within a plane, in values.
+   *
+   * This is at least width(), and rounded up so every row is aligned.
+   */
+  std::size_t rowStride() const { return mRowStride; }
+  /**
+   * The camera sensor color pattern, from profile().
+   */
+  unsigned int filters() const { return mProfile.filters(); }
+
+  /**
+   * The color of the camera sensor array at this point.
+   *
+   * \param[in] row Pixel row (from the top).
+   * \param[in] col Pixel column (from the left).
+   * \return Color in the sensor array, as reported by the camera.
+   */
+  ColorType colorAtPoint(unsigned int row, unsigned int col) const {
+    return (mProfile.filters() >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
+  }
+
+  /**
+   * The first value of the given row of the given plane.
+   *
+   * \param[in] color Color plane.
+   * \param[in] row Pixel row (from the top).
+   * \return An aligned pointer to width() values.
+   */
+  ValueType* planeRow(ColorType color, int row) {
+    return mPlanes + color * planeSize() + row * mRowStride;
+  }
+  /**
+   * The first value of the given row of the given plane.
+   *
+   * \param[in] color Color plane.
+   * \param[in] row Pixel row (from the top).
+   * \return An aligned pointer to width() values.
+   */
+  const ValueType* constPlaneRow(ColorType color, int row) const {
+    return mPlanes + color * planeSize() + row * mRowStride;
+  }
+
+  /**
+   * Gathers one pixel's colors from all planes.
+   *
+   * This is slow; use planeRow() in loops.
+   *
+   * \param[in] row Pixel row (from the top).
+   * \param[in] col Pixel column (from the left).
+   * \return A copy of the pixel.
+   */
+  PixelType pixelAtPoint(unsigned int row, unsigned int col) const {
+    PixelType ret;
+    for (ColorType c = 0; c < N; c++) {
+      ret[c] = constPlaneRow(c, row)[col];
+    }
+    return ret;
+  }
+
+  /**
+   * Scatters one pixel's colors to all planes.
+   *
+   * This is slow; use planeRow() in loops.
+   *
+   * \param[in] row Pixel row (from the top).
+   * \param[in] col Pixel column (from the left).
+   * \param[in] pixel New pixel value.
+   */
+  void setPixelAtPoint(
+      unsigned int row, unsigned int col, const PixelType& pixel) {
+    for (ColorType c = 0; c < N; c++) {
+      planeRow(c, row)[col] = pixel.at(c);
+    }
+  }
+};
+
+/**
+ * Copies an interleaved Image into a PlanarImage of the same size.
+ *
+ * \param[in] image Interleaved source Image.
+ * \param[out] planarImage Planar destination, already width x height.
+ */
+template<typename PixelT, typename T, unsigned int N>
+void deinterleave(const Image<PixelT>& image, PlanarImage<T, N>& planarImage)
+{
+  const int height = image.height();
+  const int width = image.width();
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+  for (int row = 0; row < height; row++) {
+    const PixelT* pix(image.constPixelsAtRow(row));
+    for (unsigned int c = 0; c < N; c++) {
+      T* out(planarImage.planeRow(c, row));
+      for (int col = 0; col < width; col++) {
+        out[col] = pix[col].at(c);
+      }
+    }
+  }
+}
+
+/**
+ * Copies a PlanarImage into an interleaved Image of the same size.
+ *
+ * \param[in] planarImage Planar source.
+ * \param[out] image Interleaved destination Image, already width x height.
+ */
+template<typename T, unsigned int N, typename PixelT>
+void interleave(const PlanarImage<T, N>& planarImage, Image<PixelT>& image)
+{
+  const int height = image.height();
+  const int width = image.width();
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+  for (int row = 0; row < height; row++) {
+    PixelT* pix(image.pixelsAtRow(row));
+    for (unsigned int c = 0; c < N; c++) {
+      const T* in(planarImage.constPlaneRow(c, row));
+      for (int col = 0; col < width; col++) {
+        pix[col][c] = in[col];
+      }
+    }
+  }
+}
+
+typedef PlanarImage<unsigned short, 3> PlanarRGBImage;
+
+} // namespace refinery
+
+#endif /* _REFINERY_PLANAR_IMAGE_H */
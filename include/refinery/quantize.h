@@ -0,0 +1,102 @@
+#ifndef _REFINERY_QUANTIZE_H
+#define _REFINERY_QUANTIZE_H
+
+#include <limits>
+
+#include <refinery/image.h>
+
+namespace refinery {
+
+/**
+ * Copies an integer Image's values into a float Image of the same size.
+ *
+ * This is the way into a float pipeline. The values keep their scale (a
+ * 16-bit 65535 becomes 65535.0f), so ScaleColorsFilter multipliers and
+ * ConvertToRgbFilter matrices work unchanged. Unlike with 16-bit Images, no
+ * filter clamps float values, so highlights pushed past 65535 by white
+ * balance or color conversion keep their headroom:
+ *
+ * \code
+ * std::auto_ptr<GrayImage> gray(reader.readGrayImage(fb, exifData));
+ * FloatGrayImage floatGray(gray->profile(), gray->width(), gray->height(),
+ *     ImageBuffer::UNINITIALIZED);
+ * toFloat(*gray, floatGray);
+ *
+ * ScaleColorsFilter().filter(floatGray);
+ * std::auto_ptr<FloatRGBImage> floatRgb(interpolator.interpolate(floatGray));
+ * ConvertToRgbFilter().filter(*floatRgb);
+ *
+ * RGBImage rgb(floatRgb->profile(), floatRgb->width(), floatRgb->height(),
+ *     ImageBuffer::UNINITIALIZED);
+ * quantize(*floatRgb, rgb); // the only clamp and round in the chain
+ * \endcode
+ *
+ * \param[in] image Integer source Image.
+ * \param[out] floatImage Float destination, already width x height.
+ */
+template<typename InPixelT, typename OutPixelT>
+void toFloat(const Image<InPixelT>& image, Image<OutPixelT>& floatImage)
+{
+  typedef typename InPixelT::ValueType InValueType;
+  typedef typename OutPixelT::ValueType OutValueType;
+
+  const int height = image.height();
+  const int rowLength = image.width() * InPixelT::NColors;
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+  for (int row = 0; row < height; row++) {
+    // Each row is one flat array of values, which vectorizes
+    const InValueType* in(
+        reinterpret_cast<const InValueType*>(image.constPixelsAtRow(row)));
+    OutValueType* out(
+        reinterpret_cast<OutValueType*>(floatImage.pixelsAtRow(row)));
+
+    for (int i = 0; i < rowLength; i++) {
+      out[i] = in[i];
+    }
+  }
+}
+
+/**
+ * Rounds and clamps a float Image's values into an integer Image.
+ *
+ * This is the way out of a float pipeline (see toFloat()): values are
+ * rounded to the nearest integer and clamped to the output's range, once.
+ * Gamma correction and output then work on the integer Image.
+ *
+ * \param[in] floatImage Float source Image.
+ * \param[out] image Integer destination, already width x height.
+ */
+template<typename InPixelT, typename OutPixelT>
+void quantize(const Image<InPixelT>& floatImage, Image<OutPixelT>& image)
+{
+  typedef typename InPixelT::ValueType InValueType;
+  typedef typename OutPixelT::ValueType OutValueType;
+
+  const InValueType max = std::numeric_limits<OutValueType>::max();
+  const int height = floatImage.height();
+  const int rowLength = floatImage.width() * InPixelT::NColors;
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+  for (int row = 0; row < height; row++) {
+    // Branch-free, so the compiler can vectorize it
+    const InValueType* in(reinterpret_cast<const InValueType*>(
+          floatImage.constPixelsAtRow(row)));
+    OutValueType* out(reinterpret_cast<OutValueType*>(image.pixelsAtRow(row)));
+
+    for (int i = 0; i < rowLength; i++) {
+      InValueType v = in[i] + 0.5f;
+      v = v > 0 ? v : 0;
+      v = v < max ? v : max;
+      out[i] = static_cast<OutValueType>(v);
+    }
+  }
+}
+
+} // namespace refinery
+
+#endif /* _REFINERY_QUANTIZE_H */
@@ -3,13 +3,23 @@
 
 #include <refinery/camera.h>
 #include <refinery/color.h>
+#include <refinery/compressed_image.h>
 #include <refinery/exif.h>
+#include <refinery/exif_cache.h>
 #include <refinery/filters.h>
 #include <refinery/gamma.h>
 #include <refinery/image.h>
+#include <refinery/image_buffer.h>
+#include <refinery/image_pool.h>
+#include <refinery/image_view.h>
 #include <refinery/histogram.h>
+#include <refinery/memory_stats.h>
 #include <refinery/output.h>
+#include <refinery/planar_image.h>
+#include <refinery/quantize.h>
+#include <refinery/streaming_interpolator.h>
 #include <refinery/unpack.h>
+#include <refinery/white_balance.h>
 
 namespace refinery {
 /**
@@ -54,6 +64,8 @@ namespace refinery {
  * <tt>raw2ppm [RAWFILE] outfile.ppm</tt>. It converts a RAW file to a PPM and
  * is intended as an example, not an everyday tool. You can link refinery with
  * other libraries (such as a JPEG-writing one) to create more powerful tools.
+ * Pass <tt>--stats</tt> first to print each stage's peak memory use (see
+ * MemoryStats) to standard error.
  *
  * \section Using
  *
@@ -71,6 +83,8 @@ namespace refinery {
  *  <li>Unpack the Exif data (use DcrawExifData or Exiv2ExifData).</li>
  *  <li>Unpack the raw data (use ImageReader). Unless you're using a
  *      Foveon camera, you now have a grayscale Image.</li>
+ *  <li>Optionally, estimate white balance from the image itself (use
+ *      AutoWhiteBalance).</li>
  *  <li>Scale it to fill its data-type (for instance, scaling 12-bit to
  *      16-bit) (use ScaleColorsFilter).</li>
  *  <li>Interpolate the missing colors (use Interpolator). Now you have
@@ -84,6 +98,10 @@ namespace refinery {
  *  <li>Save the image (use ImageWriter).</li>
  * </ol>
  * 
+ * To keep highlight headroom and avoid a 16-bit clamp after every step,
+ * convert the grayscale Image to a FloatGrayImage (use toFloat()) before
+ * scaling, and back to an RGBImage (use quantize()) before gamma correction.
+ *
  * Depending on your intents, you might want to add more steps. That's okay,
  * since the image data is easy to copy from Image::pixels().
  *
@@ -0,0 +1,102 @@
+#ifndef _REFINERY_STREAMING_INTERPOLATOR_H
+#define _REFINERY_STREAMING_INTERPOLATOR_H
+
+namespace refinery {
+
+class CameraProfile;
+
+/**
+ * Interpolates like Interpolator::INTERPOLATE_AHD, one row at a time.
+ *
+ * Interpolator needs the whole gray image up front. A StreamingInterpolator
+ * takes gray rows as a decoder produces them and hands back RGB rows as soon
+ * as it can, which is five rows later. In between, it only keeps a window of
+ * a few rows per AHD stage, so its scratch memory is a couple of hundred
+ * bytes per image column, however tall the image.
+ *
+ * The output is exactly Interpolator's, and so is setUsesFixedPointLab()'s.
+ * One StreamingInterpolator interpolates in one thread; to use more, stream
+ * several images (or several horizontal bands) at once.
+ *
+ * Push a row, then pop every row that's ready, until the image is done:
+ * \code
+ * StreamingInterpolator interpolator(profile, width, height);
+ * std::vector<unsigned short> rgbRow(width * 3);
+ * for (unsigned int row = 0; row < height; row++) {
+ *   interpolator.pushRow(decodeNextRow());
+ *   while (interpolator.popRow(&rgbRow[0])) {
+ *     writeRow(rgbRow);
+ *   }
+ * }
+ * \endcode
+ */
+class StreamingInterpolator {
+  class Impl;
+  Impl* impl;
+
+  StreamingInterpolator(const StreamingInterpolator&);
+  StreamingInterpolator& operator=(const StreamingInterpolator&);
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] profile Profile of the gray image: its filters() say which
+   *                    color each pixel is, and its color matrix is used to
+   *                    compare colors.
+   * \param[in] width Pixels per row.
+   * \param[in] height Rows in the image.
+   * \param[in] fixedPointLab \c true to compare colors in fixed point, as
+   *                          with Interpolator::setUsesFixedPointLab().
+   */
+  StreamingInterpolator(
+      const CameraProfile& profile, unsigned int width, unsigned int height,
+      bool fixedPointLab = false);
+  ~StreamingInterpolator();
+
+  /**
+   * Pixels per row.
+   */
+  unsigned int width() const;
+
+  /**
+   * Rows in the image.
+   */
+  unsigned int height() const;
+
+  /**
+   * Number of gray rows pushed so far.
+   */
+  unsigned int rowsPushed() const;
+
+  /**
+   * Number of RGB rows popped so far.
+   */
+  unsigned int rowsPopped() const;
+
+  /**
+   * Adds the next gray row.
+   *
+   * Every row popRow() can return must be popped first: rows are only kept
+   * for as long as the next stages need them.
+   *
+   * \param[in] grayRow width() gray values, which are copied.
+   * \throw std::logic_error if all rows were pushed already or if a row is
+   *                         waiting to be popped.
+   */
+  void pushRow(const unsigned short* grayRow);
+
+  /**
+   * Interpolates the next RGB row, if the rows it needs have been pushed.
+   *
+   * Row \c n is ready once row <tt>n + 5</tt> (or the last row) is pushed.
+   *
+   * \param[out] outRgbRow width() pixels of red, green and blue values.
+   * \return \c true if a row was written, \c false if none is ready.
+   */
+  bool popRow(unsigned short* outRgbRow);
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_STREAMING_INTERPOLATOR_H */
@@ -7,6 +7,7 @@
 namespace refinery {
 
 class ExifData;
+class ImagePool;
 
 template<typename T> class Image;
 template<typename T> class GrayPixel;
@@ -37,7 +38,26 @@ typedef Image<RGBPixel<unsigned short> > RGBImage;
  * \endcode
  */
 class ImageReader {
+  ImagePool* mPool;
+
 public:
+  /**
+   * Constructor.
+   */
+  ImageReader() : mPool(0) {}
+
+  /**
+   * Makes future Images borrow their pixel memory from \p pool.
+   *
+   * \param[in] pool ImagePool which outlives the Images, or 0 for none.
+   */
+  void setImagePool(ImagePool* pool) { mPool = pool; }
+
+  /**
+   * The ImagePool future Images borrow from, or 0.
+   */
+  ImagePool* imagePool() const { return mPool; }
+
   /**
    * Reads and returns a GrayImage.
    *
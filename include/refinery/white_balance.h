@@ -0,0 +1,84 @@
+#ifndef _REFINERY_WHITE_BALANCE_H
+#define _REFINERY_WHITE_BALANCE_H
+
+namespace refinery {
+
+/**
+ * Guesses white-balance multipliers from a raw image's own pixels.
+ *
+ * By default, ScaleColorsFilter uses the camera's fixed multipliers, which
+ * come from its color matrix. Those are right for daylight and wrong under
+ * tungsten. AutoWhiteBalance estimates each sensor color's neutral level
+ * from the image instead, and returns multipliers in the same form as
+ * Camera::ColorConversionData::scalingMultipliers, ready for
+ * ScaleColorsFilter.
+ *
+ * Estimation is a single multithreaded pass over the raw (GrayImage) data.
+ * Clipped pixels (those at or above the camera's maximum) are left out,
+ * since they'd drag every channel toward white.
+ *
+ * \code
+ * std::auto_ptr<GrayImage> gray(reader.readGrayImage(fb, exifData));
+ *
+ * double multipliers[4];
+ * AutoWhiteBalance awb(AutoWhiteBalance::GRAY_WORLD);
+ * awb.computeMultipliers(*gray, multipliers);
+ *
+ * ScaleColorsFilter scaleFilter;
+ * scaleFilter.filter(*gray, multipliers);
+ * \endcode
+ */
+class AutoWhiteBalance {
+public:
+  /**
+   * Estimation strategy, to pass to the constructor.
+   */
+  enum Method {
+    /**
+     * Assumes the scene averages to gray.
+     *
+     * Each color's estimate is the mean of its unclipped sensor values.
+     */
+    GRAY_WORLD,
+
+    /**
+     * Assumes the brightest unclipped thing in the scene is white.
+     *
+     * Each color's estimate is its largest unclipped sensor value.
+     */
+    WHITE_PATCH
+  };
+
+private:
+  Method mMethod;
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] method Estimation strategy.
+   */
+  AutoWhiteBalance(Method method = GRAY_WORLD) : mMethod(method) {}
+
+  /**
+   * The estimation strategy.
+   */
+  Method method() const { return mMethod; }
+
+  /**
+   * Computes scaling multipliers for \p image.
+   *
+   * The brightest color gets the same multiplier the camera would give it
+   * (65535 / maximum); the others are boosted to match. If some color has no
+   * usable pixels at all, the camera's own multipliers are returned instead.
+   *
+   * \param[in] image Raw sensor image.
+   * \param[out] outMultipliers One multiplier per sensor color.
+   */
+  template<typename T>
+  void computeMultipliers(const T& image, double outMultipliers[4]) const;
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_WHITE_BALANCE_H */
@@ -0,0 +1,512 @@
+#include "ahd_kernels.h"
+
+#include <cassert>
+#include <cstdlib>
+
+#include <pthread.h>
+
+#include "kernel_attributes.h"
+
+namespace refinery {
+
+namespace {
+  /*
+   * The kernel bodies. They're inlined into each instruction set's wrapper
+   * function (below), which is where the compiler vectorizes them.
+   *
+   * They mirror AHDInterpolator's original per-pixel code exactly: same
+   * types, same order of operations. Signed overflow is spelled as unsigned
+   * arithmetic, which wraps the same way but is defined.
+   */
+
+  REFINERY_KERNEL_INLINE unsigned short bound(
+      unsigned short v, unsigned short bound1, unsigned short bound2)
+  {
+    const unsigned short lo = v < bound2 ? v : bound2;
+    const unsigned short hi = v < bound1 ? v : bound1;
+    const unsigned short a = bound1 > lo ? bound1 : lo;
+    const unsigned short b = bound2 > hi ? bound2 : hi;
+    return a < b ? a : b;
+  }
+
+  REFINERY_KERNEL_INLINE unsigned short clamp16(int val)
+  {
+    return val < 0 ? 0 : val > 0xffff ? 0xffff : val;
+  }
+
+  REFINERY_KERNEL_INLINE void greenRow(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* hGreen, unsigned short* vGreen, int n)
+  {
+    const unsigned short* above(gray - rowLength);
+    const unsigned short* above2(gray - 2 * rowLength);
+    const unsigned short* below(gray + rowLength);
+    const unsigned short* below2(gray + 2 * rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+
+      const unsigned short hValue =
+        ((gray[x - 1] + gray[x] + gray[x + 1]) * 2 // G, c, G
+         - gray[x - 2] - gray[x + 2]) >> 2; // c, c
+      hGreen[6 * i] = bound(hValue, gray[x - 1], gray[x + 1]); // G, G
+
+      const unsigned short vValue =
+        ((above[x] + gray[x] + below[x]) * 2 // G, c, G
+         - above2[x] - below2[x]) >> 2; // c, c
+      vGreen[6 * i] = bound(vValue, above[x], below[x]); // G, G
+    }
+  }
+
+  template<unsigned int RowC>
+  REFINERY_KERNEL_INLINE void greenPixelsRow(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, std::ptrdiff_t rgbRowLength, int n)
+  {
+    const unsigned int ColC = 2 - RowC;
+
+    const unsigned short* above(gray - rowLength);
+    const unsigned short* below(gray + rowLength);
+    const unsigned short* rgbAbove(rgb - rgbRowLength);
+    const unsigned short* rgbBelow(rgb + rgbRowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+
+      rgb[d + 1] = gray[x];
+
+      const int colCValue =
+        gray[x] + // G
+        ((above[x] + below[x] // colC, colC
+          - rgbAbove[d + 1] - rgbBelow[d + 1]) >> 1); // G, G
+      rgb[d + ColC] = clamp16(colCValue);
+
+      const int rowCValue =
+        gray[x] + // G
+        ((gray[x - 1] + gray[x + 1] // rowC, rowC
+          - rgb[d - 3 + 1] - rgb[d + 3 + 1]) >> 1); // G, G
+      rgb[d + RowC] = clamp16(rowCValue);
+    }
+  }
+
+  template<unsigned int RowC>
+  REFINERY_KERNEL_INLINE void redBluePixelsRow(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, std::ptrdiff_t rgbRowLength, int n)
+  {
+    const unsigned int ColC = 2 - RowC;
+
+    const unsigned short* above(gray - rowLength);
+    const unsigned short* below(gray + rowLength);
+    const unsigned short* rgbAbove(rgb - rgbRowLength);
+    const unsigned short* rgbBelow(rgb + rgbRowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+
+      rgb[d + RowC] = gray[x];
+
+      const int colCValue =
+        rgb[d + 1] + // G
+        ((above[x - 1] + above[x + 1] // colC, colC
+          + below[x - 1] + below[x + 1] // colC, colC
+          - rgbAbove[d - 3 + 1] - rgbAbove[d + 3 + 1] // G, G
+          - rgbBelow[d - 3 + 1] - rgbBelow[d + 3 + 1] // G, G
+          + 1) >> 2);
+      rgb[d + ColC] = clamp16(colCValue);
+    }
+  }
+
+  REFINERY_KERNEL_INLINE void labRow(
+      const unsigned short* rgb, short* lab,
+      const float (&cameraToXyz)[3][4], const float* cbrtTable, int n)
+  {
+    const float m00 = cameraToXyz[0][0];
+    const float m01 = cameraToXyz[0][1];
+    const float m02 = cameraToXyz[0][2];
+    const float m10 = cameraToXyz[1][0];
+    const float m11 = cameraToXyz[1][1];
+    const float m12 = cameraToXyz[1][2];
+    const float m20 = cameraToXyz[2][0];
+    const float m21 = cameraToXyz[2][1];
+    const float m22 = cameraToXyz[2][2];
+
+    for (int i = 0; i < n; i++) {
+      const float r = rgb[3 * i];
+      const float g = rgb[3 * i + 1];
+      const float b = rgb[3 * i + 2];
+
+      // Out-of-range values wrap into the table's clamped ends
+      const float cbrtX = cbrtTable[
+        static_cast<int>(0.5f + m00 * r + m01 * g + m02 * b) & 0x1ffff];
+      const float cbrtY = cbrtTable[
+        static_cast<int>(0.5f + m10 * r + m11 * g + m12 * b) & 0x1ffff];
+      const float cbrtZ = cbrtTable[
+        static_cast<int>(0.5f + m20 * r + m21 * g + m22 * b) & 0x1ffff];
+
+      lab[3 * i] = static_cast<short>(116.0f * cbrtY - (64.0f * 16.0f));
+      lab[3 * i + 1] = static_cast<short>(500.0f * (cbrtX - cbrtY));
+      lab[3 * i + 2] = static_cast<short>(200.0f * (cbrtY - cbrtZ));
+    }
+  }
+
+  REFINERY_KERNEL_INLINE void labFixedRow(
+      const unsigned short* rgb, short* lab,
+      const int (&cameraToXyz)[3][3], const unsigned short* cbrtTable, int n)
+  {
+    const int XyzRound = 1 << (AHDKernels::XyzFixedBits - 1);
+
+    const int m00 = cameraToXyz[0][0];
+    const int m01 = cameraToXyz[0][1];
+    const int m02 = cameraToXyz[0][2];
+    const int m10 = cameraToXyz[1][0];
+    const int m11 = cameraToXyz[1][1];
+    const int m12 = cameraToXyz[1][2];
+    const int m20 = cameraToXyz[2][0];
+    const int m21 = cameraToXyz[2][1];
+    const int m22 = cameraToXyz[2][2];
+
+    // The matrix math and the LAB math vectorize, but the table lookups
+    // can't (there's no 16-bit gather) and would stop the rest from
+    // vectorizing. So each block of pixels goes through three loops: XYZ
+    // table indexes, then lookups in place, then LAB.
+    const int BlockSize = 64;
+    int cbrtX[BlockSize];
+    int cbrtY[BlockSize];
+    int cbrtZ[BlockSize];
+
+    for (int start = 0; start < n; start += BlockSize) {
+      const unsigned short* blockRgb(rgb + 3 * start);
+      short* blockLab(lab + 3 * start);
+      const int blockSize = n - start < BlockSize ? n - start : BlockSize;
+
+      for (int i = 0; i < blockSize; i++) {
+        const int r = blockRgb[3 * i];
+        const int g = blockRgb[3 * i + 1];
+        const int b = blockRgb[3 * i + 2];
+
+        cbrtX[i] = clamp16(
+            (m00 * r + m01 * g + m02 * b + XyzRound)
+            >> AHDKernels::XyzFixedBits);
+        cbrtY[i] = clamp16(
+            (m10 * r + m11 * g + m12 * b + XyzRound)
+            >> AHDKernels::XyzFixedBits);
+        cbrtZ[i] = clamp16(
+            (m20 * r + m21 * g + m22 * b + XyzRound)
+            >> AHDKernels::XyzFixedBits);
+      }
+
+      for (int i = 0; i < blockSize; i++) {
+        cbrtX[i] = cbrtTable[cbrtX[i]];
+        cbrtY[i] = cbrtTable[cbrtY[i]];
+        cbrtZ[i] = cbrtTable[cbrtZ[i]];
+      }
+
+      // Dividing truncates toward zero, like lab()'s casts
+      for (int i = 0; i < blockSize; i++) {
+        blockLab[3 * i] = static_cast<short>(
+            (116 * cbrtY[i] - (64 * 16 << AHDKernels::CbrtFixedBits))
+            / (1 << AHDKernels::CbrtFixedBits));
+        blockLab[3 * i + 1] = static_cast<short>(
+            500 * (cbrtX[i] - cbrtY[i]) / (1 << AHDKernels::CbrtFixedBits));
+        blockLab[3 * i + 2] = static_cast<short>(
+            200 * (cbrtY[i] - cbrtZ[i]) / (1 << AHDKernels::CbrtFixedBits));
+      }
+    }
+  }
+
+  REFINERY_KERNEL_INLINE unsigned int lDiff(const short* lab, const short* adj)
+  {
+    const int diff = lab[0] - adj[0];
+    return diff < 0 ? -diff : diff;
+  }
+
+  REFINERY_KERNEL_INLINE unsigned int abDiff(const short* lab, const short* adj)
+  {
+    const unsigned int diffA = lab[1] - adj[1];
+    const unsigned int diffB = lab[2] - adj[2];
+    return diffA * diffA + diffB * diffB;
+  }
+
+  REFINERY_KERNEL_INLINE unsigned int maxOf(unsigned int a, unsigned int b)
+  {
+    return a > b ? a : b;
+  }
+
+  REFINERY_KERNEL_INLINE unsigned int minOf(unsigned int a, unsigned int b)
+  {
+    return a < b ? a : b;
+  }
+
+  /*
+   * 1 if diff < eps and diff2 < eps2, else 0. Branch-free: it assumes
+   * negative numbers start with a 1 bit.
+   */
+  REFINERY_KERNEL_INLINE unsigned int isHomogeneous(
+      unsigned int diff, unsigned int eps, unsigned int diff2,
+      unsigned int eps2)
+  {
+    return ((diff - eps) & (diff2 - eps2)) >> 31;
+  }
+
+  REFINERY_KERNEL_INLINE void homogeneityRow(
+      const short* hLab, const short* vLab, std::ptrdiff_t labRowLength,
+      char* homogeneity, int n)
+  {
+    for (int i = 0; i < n; i++) {
+      const short* h(hLab + 3 * i);
+      const short* v(vLab + 3 * i);
+
+      // Left, right, above, below
+      const unsigned int hL0 = lDiff(h, h - 3);
+      const unsigned int hL1 = lDiff(h, h + 3);
+      const unsigned int hL2 = lDiff(h, h - labRowLength);
+      const unsigned int hL3 = lDiff(h, h + labRowLength);
+      const unsigned int vL0 = lDiff(v, v - 3);
+      const unsigned int vL1 = lDiff(v, v + 3);
+      const unsigned int vL2 = lDiff(v, v - labRowLength);
+      const unsigned int vL3 = lDiff(v, v + labRowLength);
+
+      const unsigned int hAb0 = abDiff(h, h - 3);
+      const unsigned int hAb1 = abDiff(h, h + 3);
+      const unsigned int hAb2 = abDiff(h, h - labRowLength);
+      const unsigned int hAb3 = abDiff(h, h + labRowLength);
+      const unsigned int vAb0 = abDiff(v, v - 3);
+      const unsigned int vAb1 = abDiff(v, v + 3);
+      const unsigned int vAb2 = abDiff(v, v - labRowLength);
+      const unsigned int vAb3 = abDiff(v, v + labRowLength);
+
+      const unsigned int lEps =
+        minOf(maxOf(hL0, hL1), maxOf(vL2, vL3)) + 1;
+      const unsigned int abEps =
+        minOf(maxOf(hAb0, hAb1), maxOf(vAb2, vAb3)) + 1;
+
+      homogeneity[3 * i] =
+        isHomogeneous(hL0, lEps, hAb0, abEps)
+        + isHomogeneous(hL1, lEps, hAb1, abEps)
+        + isHomogeneous(hL2, lEps, hAb2, abEps)
+        + isHomogeneous(hL3, lEps, hAb3, abEps);
+      homogeneity[3 * i + 1] =
+        isHomogeneous(vL0, lEps, vAb0, abEps)
+        + isHomogeneous(vL1, lEps, vAb1, abEps)
+        + isHomogeneous(vL2, lEps, vAb2, abEps)
+        + isHomogeneous(vL3, lEps, vAb3, abEps);
+    }
+  }
+
+  REFINERY_KERNEL_INLINE void homogeneityDiffRow(
+      char* homogeneity, std::ptrdiff_t rowLength, int n)
+  {
+    const char* above(homogeneity - rowLength);
+    const char* below(homogeneity + rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 3 * i;
+
+      const int hm0 =
+        above[x - 3] + above[x] + above[x + 3]
+        + homogeneity[x - 3] + homogeneity[x] + homogeneity[x + 3]
+        + below[x - 3] + below[x] + below[x + 3];
+      const int hm1 =
+        above[x - 2] + above[x + 1] + above[x + 4]
+        + homogeneity[x - 2] + homogeneity[x + 1] + homogeneity[x + 4]
+        + below[x - 2] + below[x + 1] + below[x + 4];
+
+      homogeneity[x + 2] = hm0 - hm1;
+    }
+  }
+
+  template<int Step>
+  REFINERY_KERNEL_INLINE void blendRow(
+      const char* homogeneity, const unsigned short* hRgb,
+      const unsigned short* vRgb, unsigned short* r, unsigned short* g,
+      unsigned short* b, int n)
+  {
+    unsigned short* out[3] = { r, g, b };
+
+    for (int i = 0; i < n; i++) {
+      const char diff = homogeneity[3 * i + 2];
+
+      for (int c = 0; c < 3; c++) {
+        const unsigned short hValue = hRgb[3 * i + c];
+        const unsigned short vValue = vRgb[3 * i + c];
+        out[c][Step * i] = diff > 0 ? hValue
+          : diff < 0 ? vValue
+          : (hValue + vValue) >> 1;
+      }
+    }
+  }
+} // namespace {}
+
+/*
+ * Defines one instruction set's kernels, as wrappers around the bodies above
+ * compiled with the given function attributes.
+ */
+#define REFINERY_AHD_KERNELS(Name, Attributes) \
+  namespace { \
+    Attributes void green##Name( \
+        const unsigned short* gray, std::ptrdiff_t rowLength, \
+        unsigned short* hGreen, unsigned short* vGreen, int n) \
+    { \
+      greenRow(gray, rowLength, hGreen, vGreen, n); \
+    } \
+    Attributes void fillGreenPixels##Name( \
+        const unsigned short* gray, std::ptrdiff_t rowLength, \
+        unsigned short* rgb, std::ptrdiff_t rgbRowLength, unsigned int rowC, \
+        int n) \
+    { \
+      if (rowC == 0) { \
+        greenPixelsRow<0>(gray, rowLength, rgb, rgbRowLength, n); \
+      } else { \
+        greenPixelsRow<2>(gray, rowLength, rgb, rgbRowLength, n); \
+      } \
+    } \
+    Attributes void fillRedBluePixels##Name( \
+        const unsigned short* gray, std::ptrdiff_t rowLength, \
+        unsigned short* rgb, std::ptrdiff_t rgbRowLength, unsigned int rowC, \
+        int n) \
+    { \
+      if (rowC == 0) { \
+        redBluePixelsRow<0>(gray, rowLength, rgb, rgbRowLength, n); \
+      } else { \
+        redBluePixelsRow<2>(gray, rowLength, rgb, rgbRowLength, n); \
+      } \
+    } \
+    Attributes void lab##Name( \
+        const unsigned short* rgb, short* lab, \
+        const float (&cameraToXyz)[3][4], const float* cbrtTable, int n) \
+    { \
+      labRow(rgb, lab, cameraToXyz, cbrtTable, n); \
+    } \
+    Attributes void labFixed##Name( \
+        const unsigned short* rgb, short* lab, \
+        const int (&cameraToXyz)[3][3], const unsigned short* cbrtTable, \
+        int n) \
+    { \
+      labFixedRow(rgb, lab, cameraToXyz, cbrtTable, n); \
+    } \
+    Attributes void homogeneity##Name( \
+        const short* hLab, const short* vLab, std::ptrdiff_t labRowLength, \
+        char* homogeneity, int n) \
+    { \
+      homogeneityRow(hLab, vLab, labRowLength, homogeneity, n); \
+    } \
+    Attributes void homogeneityDiff##Name( \
+        char* homogeneity, std::ptrdiff_t rowLength, int n) \
+    { \
+      homogeneityDiffRow(homogeneity, rowLength, n); \
+    } \
+    Attributes void blendInterleaved##Name( \
+        const char* homogeneity, const unsigned short* hRgb, \
+        const unsigned short* vRgb, unsigned short* r, unsigned short* g, \
+        unsigned short* b, int n) \
+    { \
+      blendRow<3>(homogeneity, hRgb, vRgb, r, g, b, n); \
+    } \
+    Attributes void blendPlanar##Name( \
+        const char* homogeneity, const unsigned short* hRgb, \
+        const unsigned short* vRgb, unsigned short* r, unsigned short* g, \
+        unsigned short* b, int n) \
+    { \
+      blendRow<1>(homogeneity, hRgb, vRgb, r, g, b, n); \
+    } \
+    const AHDKernels kernels##Name = { \
+      &green##Name, &fillGreenPixels##Name, &fillRedBluePixels##Name, \
+      &lab##Name, &labFixed##Name, &homogeneity##Name, \
+      &homogeneityDiff##Name, &blendInterleaved##Name, &blendPlanar##Name \
+    }; \
+  }
+
+REFINERY_AHD_KERNELS(Scalar, REFINERY_KERNEL_SCALAR)
+#if REFINERY_KERNEL_X86
+REFINERY_AHD_KERNELS(Sse41, REFINERY_KERNEL_SIMD("sse4.1"))
+REFINERY_AHD_KERNELS(Avx2, REFINERY_KERNEL_SIMD("avx2"))
+REFINERY_AHD_KERNELS(Avx512, REFINERY_KERNEL_SIMD("avx512f,avx512bw"))
+#endif /* REFINERY_KERNEL_X86 */
+
+#undef REFINERY_AHD_KERNELS
+
+namespace {
+  const AHDKernels* activeKernels = 0;
+  pthread_once_t activeKernelsOnce = PTHREAD_ONCE_INIT;
+
+  void initActiveKernels()
+  {
+    activeKernels = &AHDKernels::forInstructionSet(AHDKernels::best());
+  }
+} // namespace {}
+
+bool AHDKernels::supported(InstructionSet set)
+{
+#if REFINERY_KERNEL_X86
+  __builtin_cpu_init();
+#endif /* REFINERY_KERNEL_X86 */
+
+  switch (set) {
+    case SCALAR:
+      return true;
+#if REFINERY_KERNEL_X86
+    case SSE4_1:
+      return __builtin_cpu_supports("sse4.1");
+    case AVX2:
+      return __builtin_cpu_supports("avx2");
+    case AVX512:
+      return __builtin_cpu_supports("avx512f")
+        && __builtin_cpu_supports("avx512bw");
+#endif /* REFINERY_KERNEL_X86 */
+    default:
+      return false;
+  }
+}
+
+AHDKernels::InstructionSet AHDKernels::best()
+{
+  for (int set = NInstructionSets - 1; set > SCALAR; set--) {
+    if (supported(static_cast<InstructionSet>(set))) {
+      return static_cast<InstructionSet>(set);
+    }
+  }
+  return SCALAR;
+}
+
+const AHDKernels& AHDKernels::forInstructionSet(InstructionSet set)
+{
+  assert(supported(set));
+
+  switch (set) {
+#if REFINERY_KERNEL_X86
+    case SSE4_1: return kernelsSse41;
+    case AVX2: return kernelsAvx2;
+    case AVX512: return kernelsAvx512;
+#endif /* REFINERY_KERNEL_X86 */
+    default: return kernelsScalar;
+  }
+}
+
+const AHDKernels& AHDKernels::active()
+{
+  pthread_once(&activeKernelsOnce, &initActiveKernels);
+  return *activeKernels;
+}
+
+AHDKernels::InstructionSet AHDKernels::activeInstructionSet()
+{
+  const AHDKernels* kernels = &active();
+
+  for (int set = NInstructionSets - 1; set > SCALAR; set--) {
+    const InstructionSet s(static_cast<InstructionSet>(set));
+    if (supported(s) && &forInstructionSet(s) == kernels) return s;
+  }
+  return SCALAR;
+}
+
+void AHDKernels::select(InstructionSet set)
+{
+  // So a later first call to active() can't override this
+  pthread_once(&activeKernelsOnce, &initActiveKernels);
+  activeKernels = &forInstructionSet(set);
+}
+
+} // namespace refinery
@@ -0,0 +1,219 @@
+#ifndef _REFINERY_AHD_KERNELS_H
+#define _REFINERY_AHD_KERNELS_H
+
+#include <cstddef>
+
+namespace refinery {
+
+/**
+ * The inner loops of AHD interpolation, one row at a time, over raw values.
+ *
+ * Each kernel is one flat, branch-free loop, written once and compiled
+ * several times: plain scalar code (the reference), and once for each SIMD
+ * instruction set the compiler can vectorize it for. active() picks the
+ * widest set the CPU supports the first time it's called.
+ *
+ * Every version does the same integer and float operations in the same
+ * order (there's no fused multiply-add, which would round differently), so
+ * they all give bit-identical results.
+ *
+ * Pixels are interleaved, as in an RGBImage: "stride 2" for an RGB value
+ * means every second pixel, or six values apart.
+ *
+ * The other algorithms' kernels (BilinearKernels, MHCKernels, PPGKernels)
+ * are built the same way, with kernel_attributes.h. They share these
+ * InstructionSet values, every version matches their scalar one, and their
+ * active() follows activeInstructionSet(), so select() switches them all.
+ */
+struct AHDKernels {
+  /**
+   * Instruction sets the kernels are compiled for.
+   */
+  enum InstructionSet {
+    SCALAR, /**< No vectorization: the reference. */
+    SSE4_1, /**< 128-bit registers. */
+    AVX2, /**< 256-bit registers. */
+    AVX512, /**< 512-bit registers (AVX-512F and BW). */
+    NInstructionSets /**< Number of instruction sets (not a set). */
+  };
+
+  /**
+   * Estimates green at every second pixel of a row of red or blue pixels.
+   *
+   * Writes the estimates from left-right neighbors to \p hGreen and those
+   * from up-down neighbors to \p vGreen.
+   *
+   * \param[in] gray First red or blue gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[out] hGreen Green value of the first horizontal RGB pixel.
+   * \param[out] vGreen Green value of the first vertical RGB pixel.
+   * \param[in] n Number of pixels to estimate.
+   */
+  void (*green)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* hGreen, unsigned short* vGreen, int n);
+
+  /**
+   * Fills in red and blue at every second pixel of a row of green pixels.
+   *
+   * \param[in] gray First green gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[in,out] rgb First RGB pixel; its green neighbors are read.
+   * \param[in] rgbRowLength Values per RGB row.
+   * \param[in] rowC Color (0 or 2) of the row's other pixels.
+   * \param[in] n Number of pixels to fill.
+   */
+  void (*fillGreenPixels)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, std::ptrdiff_t rgbRowLength, unsigned int rowC,
+      int n);
+
+  /**
+   * Fills in the missing color at every second pixel of a row of red or
+   * blue pixels.
+   *
+   * \param[in] gray First red or blue gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[in,out] rgb First RGB pixel; its green values are read.
+   * \param[in] rgbRowLength Values per RGB row.
+   * \param[in] rowC The pixels' own color (0 or 2).
+   * \param[in] n Number of pixels to fill.
+   */
+  void (*fillRedBluePixels)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, std::ptrdiff_t rgbRowLength, unsigned int rowC,
+      int n);
+
+  /**
+   * Converts a row of RGB pixels to CIELAB.
+   *
+   * \param[in] rgb First RGB pixel.
+   * \param[out] lab First LAB pixel.
+   * \param[in] cameraToXyz Camera-to-XYZ matrix.
+   * \param[in] cbrtTable 0x20000-entry table of 64 * cbrt(x / 65535).
+   * \param[in] n Number of pixels.
+   */
+  void (*lab)(
+      const unsigned short* rgb, short* lab,
+      const float (&cameraToXyz)[3][4], const float* cbrtTable, int n);
+
+  /**
+   * Fixed-point bits of labFixed()'s camera-to-XYZ matrix.
+   */
+  static const int XyzFixedBits = 13;
+
+  /**
+   * Fixed-point bits of labFixed()'s cube-root table.
+   */
+  static const int CbrtFixedBits = 10;
+
+  /**
+   * Converts a row of RGB pixels to CIELAB, in integer arithmetic only.
+   *
+   * This approximates lab(): the matrix and the table are rounded to fixed
+   * point, and XYZ values are clamped to the table. L is usually within a
+   * unit of lab()'s; A and B, which multiply cube-root differences by 500
+   * and 200, can be off by a few more in saturated colors.
+   *
+   * \param[in] rgb First RGB pixel.
+   * \param[out] lab First LAB pixel.
+   * \param[in] cameraToXyz Camera-to-XYZ matrix, times 2^XyzFixedBits. Each
+   *                        row's absolute values must sum to less than 2^15.
+   * \param[in] cbrtTable 0x10000-entry table of
+   *                      2^CbrtFixedBits * 64 * cbrt(x / 65535), at most
+   *                      65535.
+   * \param[in] n Number of pixels.
+   */
+  void (*labFixed)(
+      const unsigned short* rgb, short* lab,
+      const int (&cameraToXyz)[3][3], const unsigned short* cbrtTable,
+      int n);
+
+  /**
+   * Counts each pixel's homogeneous neighbors, horizontally and vertically.
+   *
+   * \param[in] hLab First pixel of the horizontal LAB row.
+   * \param[in] vLab First pixel of the vertical LAB row.
+   * \param[in] labRowLength Values per LAB row.
+   * \param[out] homogeneity First pixel of the homogeneity row: its h and v
+   *                         values are written.
+   * \param[in] n Number of pixels.
+   */
+  void (*homogeneity)(
+      const short* hLab, const short* vLab, std::ptrdiff_t labRowLength,
+      char* homogeneity, int n);
+
+  /**
+   * Sums homogeneity over each pixel's 3x3 neighborhood and stores the
+   * horizontal sum minus the vertical one.
+   *
+   * \param[in,out] homogeneity First pixel of the homogeneity row: h and v
+   *                            are read around it and diff is written.
+   * \param[in] rowLength Values per homogeneity row.
+   * \param[in] n Number of pixels.
+   */
+  void (*homogeneityDiff)(
+      char* homogeneity, std::ptrdiff_t rowLength, int n);
+
+  /**
+   * Picks each output pixel from the horizontal or vertical estimate, or
+   * averages them.
+   *
+   * \param[in] homogeneity First pixel of the homogeneity row.
+   * \param[in] hRgb First horizontal RGB pixel.
+   * \param[in] vRgb First vertical RGB pixel.
+   * \param[out] r First output red value.
+   * \param[out] g First output green value.
+   * \param[out] b First output blue value.
+   * \param[in] n Number of pixels.
+   */
+  void (*blendInterleaved)(
+      const char* homogeneity, const unsigned short* hRgb,
+      const unsigned short* vRgb, unsigned short* r, unsigned short* g,
+      unsigned short* b, int n);
+
+  /**
+   * Like blendInterleaved, but writing to three separate planes.
+   */
+  void (*blendPlanar)(
+      const char* homogeneity, const unsigned short* hRgb,
+      const unsigned short* vRgb, unsigned short* r, unsigned short* g,
+      unsigned short* b, int n);
+
+  /**
+   * \c true if this build has kernels for \p set and the CPU runs them.
+   */
+  static bool supported(InstructionSet set);
+
+  /**
+   * The widest InstructionSet that's supported().
+   */
+  static InstructionSet best();
+
+  /**
+   * The kernels for \p set, which must be supported().
+   */
+  static const AHDKernels& forInstructionSet(InstructionSet set);
+
+  /**
+   * The kernels AHD interpolation uses: best() unless select() said
+   * otherwise.
+   */
+  static const AHDKernels& active();
+
+  /**
+   * The InstructionSet of active(), for kernels that follow it.
+   */
+  static InstructionSet activeInstructionSet();
+
+  /**
+   * Makes active() return the kernels for \p set, which must be supported().
+   *
+   * This is for tests and benchmarks. Call it before starting any threads.
+   */
+  static void select(InstructionSet set);
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_AHD_KERNELS_H */
@@ -0,0 +1,180 @@
+#include "bilinear_kernels.h"
+
+#include <cassert>
+
+#include "kernel_attributes.h"
+
+namespace refinery {
+
+namespace {
+  /*
+   * The kernel bodies, as in ahd_kernels.cc. Neighbors are added up in
+   * BilinearInterpolator's order (left to right, top to bottom), each
+   * weighted 2 beside the pixel and 1 on its corners.
+   */
+
+  template<typename T> struct Arithmetic;
+
+  /*
+   * 16-bit values: integer sums, divided in BilinearInterpolator's fixed
+   * point.
+   */
+  template<> struct Arithmetic<unsigned short> {
+    typedef unsigned int SumType;
+
+    static REFINERY_KERNEL_INLINE SumType twice(unsigned short value) {
+      return static_cast<unsigned int>(value) << 1;
+    }
+    static REFINERY_KERNEL_INLINE SumType once(unsigned short value) {
+      return value;
+    }
+    template<unsigned int Weight>
+    static REFINERY_KERNEL_INLINE unsigned short average(SumType sum) {
+      return static_cast<unsigned short>(sum * (256 / Weight) >> 8);
+    }
+  };
+
+  template<> struct Arithmetic<float> {
+    typedef float SumType;
+
+    static REFINERY_KERNEL_INLINE SumType twice(float value) {
+      return value * 2;
+    }
+    static REFINERY_KERNEL_INLINE SumType once(float value) {
+      return value * 1;
+    }
+    template<unsigned int Weight>
+    static REFINERY_KERNEL_INLINE float average(SumType sum) {
+      return sum * (1.0f / Weight);
+    }
+  };
+
+  template<typename T, int OwnC>
+  REFINERY_KERNEL_INLINE void redBluePixelsRow(
+      const T* gray, std::ptrdiff_t rowLength, T* rgb, int n)
+  {
+    typedef Arithmetic<T> A;
+    typedef typename A::SumType SumType;
+
+    const int OtherC = 2 - OwnC;
+
+    const T* above(gray - rowLength);
+    const T* below(gray + rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+
+      SumType green = 0;
+      green += A::twice(above[x]);
+      green += A::twice(gray[x - 1]);
+      green += A::twice(gray[x + 1]);
+      green += A::twice(below[x]);
+
+      SumType other = 0;
+      other += A::once(above[x - 1]);
+      other += A::once(above[x + 1]);
+      other += A::once(below[x - 1]);
+      other += A::once(below[x + 1]);
+
+      rgb[d + OwnC] = 0;
+      rgb[d + 1] = A::template average<8>(green);
+      rgb[d + OtherC] = A::template average<4>(other);
+    }
+  }
+
+  template<typename T, int RowC>
+  REFINERY_KERNEL_INLINE void greenPixelsRow(
+      const T* gray, std::ptrdiff_t rowLength, T* rgb, int n)
+  {
+    typedef Arithmetic<T> A;
+    typedef typename A::SumType SumType;
+
+    const int ColC = 2 - RowC;
+
+    const T* above(gray - rowLength);
+    const T* below(gray + rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+
+      SumType rowSum = 0;
+      rowSum += A::twice(gray[x - 1]);
+      rowSum += A::twice(gray[x + 1]);
+
+      SumType colSum = 0;
+      colSum += A::twice(above[x]);
+      colSum += A::twice(below[x]);
+
+      rgb[d + 1] = 0;
+      rgb[d + RowC] = A::template average<4>(rowSum);
+      rgb[d + ColC] = A::template average<4>(colSum);
+    }
+  }
+} // namespace {}
+
+/*
+ * Defines one instruction set's kernels, as in ahd_kernels.cc.
+ */
+#define REFINERY_BILINEAR_KERNELS(Name, Attributes) \
+  namespace { \
+    template<typename T> \
+    Attributes void redBluePixels##Name( \
+        const T* gray, std::ptrdiff_t rowLength, T* rgb, unsigned int ownC, \
+        int n) \
+    { \
+      if (ownC == 0) { \
+        redBluePixelsRow<T, 0>(gray, rowLength, rgb, n); \
+      } else { \
+        redBluePixelsRow<T, 2>(gray, rowLength, rgb, n); \
+      } \
+    } \
+    template<typename T> \
+    Attributes void greenPixels##Name( \
+        const T* gray, std::ptrdiff_t rowLength, T* rgb, unsigned int rowC, \
+        int n) \
+    { \
+      if (rowC == 0) { \
+        greenPixelsRow<T, 0>(gray, rowLength, rgb, n); \
+      } else { \
+        greenPixelsRow<T, 2>(gray, rowLength, rgb, n); \
+      } \
+    } \
+    const BilinearKernels kernels##Name = { \
+      &redBluePixels##Name<unsigned short>, \
+      &greenPixels##Name<unsigned short>, \
+      &redBluePixels##Name<float>, \
+      &greenPixels##Name<float> \
+    }; \
+  }
+
+REFINERY_BILINEAR_KERNELS(Scalar, REFINERY_KERNEL_SCALAR)
+#if REFINERY_KERNEL_X86
+REFINERY_BILINEAR_KERNELS(Sse41, REFINERY_KERNEL_SIMD("sse4.1"))
+REFINERY_BILINEAR_KERNELS(Avx2, REFINERY_KERNEL_SIMD("avx2"))
+REFINERY_BILINEAR_KERNELS(Avx512, REFINERY_KERNEL_SIMD("avx512f,avx512bw"))
+#endif /* REFINERY_KERNEL_X86 */
+
+#undef REFINERY_BILINEAR_KERNELS
+
+const BilinearKernels& BilinearKernels::forInstructionSet(InstructionSet set)
+{
+  assert(AHDKernels::supported(set));
+
+  switch (set) {
+#if REFINERY_KERNEL_X86
+    case AHDKernels::SSE4_1: return kernelsSse41;
+    case AHDKernels::AVX2: return kernelsAvx2;
+    case AHDKernels::AVX512: return kernelsAvx512;
+#endif /* REFINERY_KERNEL_X86 */
+    default: return kernelsScalar;
+  }
+}
+
+const BilinearKernels& BilinearKernels::active()
+{
+  return forInstructionSet(AHDKernels::activeInstructionSet());
+}
+
+} // namespace refinery
@@ -0,0 +1,83 @@
+#ifndef _REFINERY_BILINEAR_KERNELS_H
+#define _REFINERY_BILINEAR_KERNELS_H
+
+#include <cstddef>
+
+#include "ahd_kernels.h"
+
+namespace refinery {
+
+/**
+ * The inner loops of bilinear interpolation on Bayer sensors, one row at a
+ * time.
+ *
+ * On a Bayer sensor, every red or blue pixel has green on its four sides
+ * and the other color on its four corners, and every green pixel has one
+ * color left and right and the other above and below. So each missing color
+ * is a fixed average, and no per-pixel table is needed.
+ *
+ * Each missing color is the same weighted sum BilinearInterpolator's
+ * generic loop makes, added in the same order, so results are identical,
+ * for floats too. As there, each pixel's own color is set to 0.
+ *
+ * The kernels are compiled per instruction set as AHDKernels describes.
+ * Pixels are interleaved, as in an RGBImage, and each kernel works on every
+ * second pixel of a row.
+ */
+struct BilinearKernels {
+  typedef AHDKernels::InstructionSet InstructionSet;
+
+  /**
+   * Interpolates every second pixel of a row of red or blue pixels.
+   *
+   * \param[in] gray First red or blue gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[out] rgb First RGB pixel.
+   * \param[in] ownC The pixels' own color (0 or 2).
+   * \param[in] n Number of pixels.
+   */
+  void (*redBluePixels)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, unsigned int ownC, int n);
+
+  /**
+   * Interpolates every second pixel of a row of green pixels.
+   *
+   * \param[in] gray First green gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[out] rgb First RGB pixel.
+   * \param[in] rowC Color (0 or 2) of the row's other pixels.
+   * \param[in] n Number of pixels.
+   */
+  void (*greenPixels)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, unsigned int rowC, int n);
+
+  /**
+   * Like redBluePixels, for float images.
+   */
+  void (*redBluePixelsFloat)(
+      const float* gray, std::ptrdiff_t rowLength, float* rgb,
+      unsigned int ownC, int n);
+
+  /**
+   * Like greenPixels, for float images.
+   */
+  void (*greenPixelsFloat)(
+      const float* gray, std::ptrdiff_t rowLength, float* rgb,
+      unsigned int rowC, int n);
+
+  /**
+   * The kernels for \p set, which must be AHDKernels::supported().
+   */
+  static const BilinearKernels& forInstructionSet(InstructionSet set);
+
+  /**
+   * The kernels for AHDKernels::active()'s instruction set.
+   */
+  static const BilinearKernels& active();
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_BILINEAR_KERNELS_H */
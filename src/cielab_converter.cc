@@ -0,0 +1,113 @@
+#include "cielab_converter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <pthread.h>
+
+#include "refinery/camera.h"
+
+#include "ahd_kernels.h"
+
+namespace refinery {
+
+namespace {
+  /*
+   * 64 * cbrt(i / 65535) for every 16-bit i (as in CIELAB, linear near 0),
+   * then padding for the XYZ values AHDKernels::lab() looks up out of range:
+   * it masks them to 17 bits, so 0x10000 to 0x17fff are too bright and clamp
+   * to the maximum, and 0x18000 to 0x1ffff are negative and clamp to the
+   * minimum.
+   */
+  float xyzCbrtTable[0x20000];
+  pthread_once_t xyzCbrtTableOnce = PTHREAD_ONCE_INIT;
+
+  /*
+   * The same 64 * cbrt(i / 65535), in fixed point for
+   * AHDKernels::labFixed(). It clamps instead of masking, so it needs no
+   * padding: at 128kb, it fits in L2 alongside AHD's scratch.
+   */
+  unsigned short xyzCbrtTableFixed[0x10000];
+
+  void initXyzCbrtTable()
+  {
+    for (int i = 0; i < 0x10000; i++) {
+      double r = i / 65535.0;
+      xyzCbrtTable[i] = 64.0f * (r > 0.008856 ? std::pow(r, 1.0/3) : 7.787*r + 16.0/116);
+    }
+
+    const float xyzCbrtMin = xyzCbrtTable[0];
+    const float xyzCbrtMax = xyzCbrtTable[0xffff];
+
+    for (int i = 0x10000; i <= 0x17fff; i++) {
+      xyzCbrtTable[i] = xyzCbrtMax;
+    }
+    for (int i = 0x18000; i <= 0x1ffff; i++) {
+      xyzCbrtTable[i] = xyzCbrtMin;
+    }
+
+    for (int i = 0; i < 0x10000; i++) {
+      // 64.0 itself, at i = 0xffff, is one too many
+      xyzCbrtTableFixed[i] = static_cast<unsigned short>(std::min(65535.0f,
+            xyzCbrtTable[i] * (1 << AHDKernels::CbrtFixedBits) + 0.5f));
+    }
+  }
+
+  /*
+   * Converts cameraToXyz for AHDKernels::labFixed().
+   *
+   * Returns false if the matrix's values are too big for its 32-bit sums.
+   */
+  bool fixedPointCameraToXyz(
+      const float (&cameraToXyz)[3][4], int (&outCameraToXyz)[3][3])
+  {
+    const float scale = 1 << AHDKernels::XyzFixedBits;
+
+    for (int i = 0; i < 3; i++) {
+      int sum = 0;
+      for (int j = 0; j < 3; j++) {
+        const float value = cameraToXyz[i][j] * scale;
+        if (std::abs(value) >= 0x8000) return false;
+        outCameraToXyz[i][j] = static_cast<int>(std::floor(value + 0.5f));
+        sum += std::abs(outCameraToXyz[i][j]);
+      }
+      if (sum >= 0x8000) return false;
+    }
+
+    return true;
+  }
+} // namespace {}
+
+CielabConverter::CielabConverter(
+    const AHDKernels& kernels, const CameraProfile& profile, bool fixedPoint)
+  : mKernels(kernels)
+{
+  pthread_once(&xyzCbrtTableOnce, &initXyzCbrtTable);
+
+  const Camera::ColorConversionData& colorData(profile.colorConversionData());
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int j = 0; j < 4; j++) {
+      mCameraToXyz[i][j] = 0.0f;
+    }
+    for (unsigned int j = 0; j < profile.colors(); j++) {
+      // convert from double to float, for speed
+      mCameraToXyz[i][j] = colorData.cameraToXyz[i][j];
+    }
+  }
+
+  mFixedPoint = fixedPoint
+    && fixedPointCameraToXyz(mCameraToXyz, mFixedCameraToXyz);
+}
+
+void CielabConverter::convertRow(
+    const unsigned short* rgb, short* lab, int n) const
+{
+  if (mFixedPoint) {
+    mKernels.labFixed(rgb, lab, mFixedCameraToXyz, xyzCbrtTableFixed, n);
+  } else {
+    mKernels.lab(rgb, lab, mCameraToXyz, xyzCbrtTable, n);
+  }
+}
+
+} // namespace refinery
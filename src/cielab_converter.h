@@ -0,0 +1,56 @@
+#ifndef _REFINERY_CIELAB_CONVERTER_H
+#define _REFINERY_CIELAB_CONVERTER_H
+
+namespace refinery {
+
+class CameraProfile;
+struct AHDKernels;
+
+/**
+ * Converts rows of camera RGB to CIELAB, the way AHD compares colors.
+ *
+ * This holds a camera's matrix in the form AHDKernels::lab() or
+ * AHDKernels::labFixed() wants it. The cube-root tables they look up are
+ * built by the first CielabConverter in the process, once; after that
+ * they're read-only, so any number of threads can convert at once.
+ */
+class CielabConverter {
+  const AHDKernels& mKernels;
+  float mCameraToXyz[3][4];
+  int mFixedCameraToXyz[3][3]; // if mFixedPoint
+  bool mFixedPoint;
+
+public:
+  /**
+   * Constructor.
+   *
+   * \param[in] kernels Kernels to convert with.
+   * \param[in] profile Profile whose color matrix to use.
+   * \param[in] fixedPoint \c true to use AHDKernels::labFixed(), if the
+   *                       matrix fits in fixed point.
+   */
+  CielabConverter(
+      const AHDKernels& kernels, const CameraProfile& profile,
+      bool fixedPoint);
+
+  /**
+   * \c true if this converts in fixed point.
+   *
+   * A matrix too big for fixed point (a row whose values add up to 4 or
+   * more) falls back to float.
+   */
+  bool fixedPoint() const { return mFixedPoint; }
+
+  /**
+   * Converts a row of interleaved RGB pixels to LAB pixels.
+   *
+   * \param[in] rgb First RGB pixel.
+   * \param[out] lab First LAB pixel.
+   * \param[in] n Number of pixels.
+   */
+  void convertRow(const unsigned short* rgb, short* lab, int n) const;
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_CIELAB_CONVERTER_H */
@@ -0,0 +1,366 @@
+#include "refinery/compressed_image.h"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <pthread.h>
+
+#include "refinery/image_view.h"
+#include "refinery/memory_stats.h"
+
+#include "tile_codec.h"
+
+namespace refinery {
+
+template<typename T>
+class CompressedImage<T>::Impl {
+  typedef typename T::ValueType ValueType;
+
+  struct DecodedTile {
+    unsigned int index;
+    std::vector<T> pixels;
+    bool dirty;
+  };
+  typedef std::list<DecodedTile> DecodedTilesType;
+  typedef std::map<unsigned int, typename DecodedTilesType::iterator>
+    DecodedIndexType;
+
+  CameraProfile mProfile;
+  int mWidth;
+  int mHeight;
+  unsigned int mTileSize;
+  std::size_t mMaxDecodedTiles;
+  int mTilesPerRow;
+
+  // Empty means "all zeroes"
+  std::vector<std::vector<unsigned char> > mCompressedTiles;
+  DecodedTilesType mDecodedTiles; // most recently used first
+  DecodedIndexType mDecodedIndex; // tile index => entry in mDecodedTiles
+  MemoryStats::Counter mCompressedMemory;
+  MemoryStats::Counter mDecodedMemory;
+
+  mutable pthread_mutex_t mMutex;
+
+  class Lock {
+    pthread_mutex_t& mMutex;
+  public:
+    Lock(pthread_mutex_t& mutex) : mMutex(mutex) { pthread_mutex_lock(&mMutex); }
+    ~Lock() { pthread_mutex_unlock(&mMutex); }
+  };
+
+  static unsigned int checkedTileSize(
+      int width, int height, unsigned int tileSize)
+  {
+    if (width < 0 || height < 0) {
+      throw std::invalid_argument(
+          "CompressedImage width and height must not be negative");
+    }
+    if (tileSize == 0) {
+      throw std::invalid_argument(
+          "CompressedImage tiles must be at least 1x1 pixels");
+    }
+    return tileSize;
+  }
+
+  /*
+   * Throws unless the rectangle lies within the image.
+   */
+  void checkRectangle(const Point& origin, const Point& size) const
+  {
+    if (origin.row < 0 || origin.col < 0
+        || size.row > mHeight - origin.row || size.col > mWidth - origin.col) {
+      throw std::out_of_range(
+          "CompressedImage region must lie within the image");
+    }
+  }
+
+  // Raw mosaics predict from the nearest same-color neighbor, 2 pixels away
+  static int predictionStep() { return T::NColors == 1 ? 2 : 1; }
+
+  int tileLeft(unsigned int index) const {
+    return (index % mTilesPerRow) * mTileSize;
+  }
+  int tileTop(unsigned int index) const {
+    return (index / mTilesPerRow) * mTileSize;
+  }
+  int tileWidth(unsigned int index) const {
+    return std::min<int>(mTileSize, mWidth - tileLeft(index));
+  }
+  int tileHeight(unsigned int index) const {
+    return std::min<int>(mTileSize, mHeight - tileTop(index));
+  }
+
+  void encode(DecodedTile& tile)
+  {
+    std::vector<unsigned char>& compressed(mCompressedTiles[tile.index]);
+    const std::size_t oldSize = compressed.size();
+    TileCodec::encode(
+        reinterpret_cast<const unsigned short*>(&tile.pixels[0]),
+        tileWidth(tile.index), tileHeight(tile.index), T::NColors,
+        predictionStep(), compressed);
+    mCompressedMemory.resize(
+        mCompressedMemory.bytes() - oldSize + compressed.size());
+    tile.dirty = false;
+  }
+
+  void evictLeastRecentlyUsed()
+  {
+    DecodedTile& tile(mDecodedTiles.back());
+    if (tile.dirty) encode(tile);
+    mDecodedIndex.erase(tile.index);
+    mDecodedMemory.resize(
+        mDecodedMemory.bytes() - tile.pixels.size() * sizeof(T));
+    mDecodedTiles.pop_back();
+  }
+
+  /*
+   * The decoded pixels of a tile, decoding it (and evicting another) if
+   * need be.
+   */
+  DecodedTile& decodedTile(unsigned int index)
+  {
+    typename DecodedIndexType::iterator found(mDecodedIndex.find(index));
+    if (found != mDecodedIndex.end()) {
+      mDecodedTiles.splice(
+          mDecodedTiles.begin(), mDecodedTiles, found->second);
+      return mDecodedTiles.front();
+    }
+
+    while (!mDecodedTiles.empty()
+        && mDecodedTiles.size() >= mMaxDecodedTiles) {
+      evictLeastRecentlyUsed();
+    }
+
+    mDecodedTiles.push_front(DecodedTile());
+    DecodedTile& tile(mDecodedTiles.front());
+    tile.index = index;
+    tile.dirty = false;
+    tile.pixels.resize(tileWidth(index) * tileHeight(index));
+    mDecodedIndex[index] = mDecodedTiles.begin();
+    mDecodedMemory.resize(
+        mDecodedMemory.bytes() + tile.pixels.size() * sizeof(T));
+
+    const std::vector<unsigned char>& compressed(mCompressedTiles[index]);
+    if (!compressed.empty()) {
+      TileCodec::decode(
+          &compressed[0], compressed.size(),
+          tileWidth(index), tileHeight(index), T::NColors, predictionStep(),
+          reinterpret_cast<unsigned short*>(&tile.pixels[0]));
+    }
+
+    return tile;
+  }
+
+  /*
+   * Calls copy(tile, row, tileCol, viewCol, n) for each tile row segment
+   * overlapping the rectangle, tile by tile.
+   */
+  template<typename CopyType>
+  void forEachSegment(const Point& origin, const Point& size, CopyType& copy)
+  {
+    if (size.row <= 0 || size.col <= 0) return;
+
+    const int firstTileRow = origin.row / mTileSize;
+    const int lastTileRow = (origin.row + size.row - 1) / mTileSize;
+    const int firstTileCol = origin.col / mTileSize;
+    const int lastTileCol = (origin.col + size.col - 1) / mTileSize;
+
+    for (int tileRow = firstTileRow; tileRow <= lastTileRow; tileRow++) {
+      for (int tileCol = firstTileCol; tileCol <= lastTileCol; tileCol++) {
+        const unsigned int index = tileRow * mTilesPerRow + tileCol;
+        DecodedTile& tile(decodedTile(index));
+
+        const int top = std::max(origin.row, tileTop(index));
+        const int bottom = std::min(
+            origin.row + size.row, tileTop(index) + tileHeight(index));
+        const int left = std::max(origin.col, tileLeft(index));
+        const int right = std::min(
+            origin.col + size.col, tileLeft(index) + tileWidth(index));
+
+        for (int row = top; row < bottom; row++) {
+          T* tilePixels(&tile.pixels[
+              (row - tileTop(index)) * tileWidth(index)
+              + (left - tileLeft(index))]);
+          copy(tile, tilePixels, row - origin.row, left - origin.col,
+              right - left);
+        }
+      }
+    }
+  }
+
+  struct ReadSegment {
+    const ImageView<T>& mOut;
+    ReadSegment(const ImageView<T>& out) : mOut(out) {}
+    void operator()(
+        DecodedTile&, const T* tilePixels, int row, int col, int n) {
+      std::copy(tilePixels, tilePixels + n, mOut.pixelsAtPoint(row, col));
+    }
+  };
+
+  struct WriteSegment {
+    const ImageView<const T>& mIn;
+    WriteSegment(const ImageView<const T>& in) : mIn(in) {}
+    void operator()(DecodedTile& tile, T* tilePixels, int row, int col, int n) {
+      const T* in(mIn.constPixelsAtPoint(row, col));
+      std::copy(in, in + n, tilePixels);
+      tile.dirty = true;
+    }
+  };
+
+public:
+  Impl(const CameraProfile& profile, int width, int height,
+      unsigned int tileSize, std::size_t maxDecodedTiles)
+    : mProfile(profile), mWidth(width), mHeight(height),
+    mTileSize(checkedTileSize(width, height, tileSize)),
+    mMaxDecodedTiles(maxDecodedTiles),
+    mTilesPerRow((width + mTileSize - 1) / mTileSize),
+    mCompressedTiles(mTilesPerRow * ((height + mTileSize - 1) / mTileSize)),
+    mCompressedMemory(MemoryStats::CACHES),
+    mDecodedMemory(MemoryStats::CACHES)
+  {
+    pthread_mutex_init(&mMutex, 0);
+  }
+
+  ~Impl()
+  {
+    pthread_mutex_destroy(&mMutex);
+  }
+
+  const CameraProfile& profile() const { return mProfile; }
+  unsigned int width() const { return mWidth; }
+  unsigned int height() const { return mHeight; }
+  unsigned int tileSize() const { return mTileSize; }
+  std::size_t maxDecodedTiles() const { return mMaxDecodedTiles; }
+
+  void read(const Point& origin, const ImageView<T>& out)
+  {
+    const Point size(out.height(), out.width());
+    checkRectangle(origin, size);
+
+    Lock lock(mMutex);
+    ReadSegment copy(out);
+    forEachSegment(origin, size, copy);
+  }
+
+  void write(const Point& origin, const ImageView<const T>& in)
+  {
+    const Point size(in.height(), in.width());
+    checkRectangle(origin, size);
+
+    Lock lock(mMutex);
+    WriteSegment copy(in);
+    forEachSegment(origin, size, copy);
+  }
+
+  void flush()
+  {
+    Lock lock(mMutex);
+    for (typename DecodedTilesType::iterator it(mDecodedTiles.begin());
+        it != mDecodedTiles.end(); ++it) {
+      if (it->dirty) encode(*it);
+    }
+  }
+
+  std::size_t compressedBytes() const
+  {
+    Lock lock(mMutex);
+    return mCompressedMemory.bytes();
+  }
+
+  std::size_t decodedBytes() const
+  {
+    Lock lock(mMutex);
+    return mDecodedMemory.bytes();
+  }
+};
+
+template<typename T>
+CompressedImage<T>::CompressedImage(
+    const CameraProfile& profile, int width, int height,
+    unsigned int tileSize, std::size_t maxDecodedTiles)
+  : impl(new Impl(profile, width, height, tileSize, maxDecodedTiles))
+{
+}
+
+template<typename T>
+CompressedImage<T>::~CompressedImage()
+{
+  delete impl;
+}
+
+template<typename T>
+const CameraProfile& CompressedImage<T>::profile() const
+{
+  return impl->profile();
+}
+
+template<typename T>
+unsigned int CompressedImage<T>::width() const
+{
+  return impl->width();
+}
+
+template<typename T>
+unsigned int CompressedImage<T>::height() const
+{
+  return impl->height();
+}
+
+template<typename T>
+std::size_t CompressedImage<T>::nPixels() const
+{
+  return static_cast<std::size_t>(impl->width()) * impl->height();
+}
+
+template<typename T>
+unsigned int CompressedImage<T>::tileSize() const
+{
+  return impl->tileSize();
+}
+
+template<typename T>
+std::size_t CompressedImage<T>::maxDecodedTiles() const
+{
+  return impl->maxDecodedTiles();
+}
+
+template<typename T>
+void CompressedImage<T>::read(
+    const Point& origin, const ImageView<T>& out) const
+{
+  impl->read(origin, out);
+}
+
+template<typename T>
+void CompressedImage<T>::write(
+    const Point& origin, const ImageView<const T>& in)
+{
+  impl->write(origin, in);
+}
+
+template<typename T>
+void CompressedImage<T>::flush()
+{
+  impl->flush();
+}
+
+template<typename T>
+std::size_t CompressedImage<T>::compressedBytes() const
+{
+  return impl->compressedBytes();
+}
+
+template<typename T>
+std::size_t CompressedImage<T>::decodedBytes() const
+{
+  return impl->decodedBytes();
+}
+
+// Instantiate the ones we need... (hack-ish)
+template class CompressedImage<u16GrayPixel>;
+template class CompressedImage<u16RGBPixel>;
+
+} // namespace refinery
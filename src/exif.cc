@@ -8,6 +8,7 @@
 #include <sstream>
 #include <stack>
 #include <string>
+#include <typeinfo>
 
 #include <boost/any.hpp>
 #include <boost/cstdint.hpp>
@@ -15,13 +16,17 @@
 #include <boost/tr1/unordered_map.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include "refinery/memory_stats.h"
+
 #include "c_file_istreambuf.h"
+#include "exif_cache_format.h"
 
 namespace refinery {
 
 class InMemoryExifDataMixin {
 protected:
-  std::tr1::unordered_map<std::string, boost::any> mData;
+  typedef std::tr1::unordered_map<std::string, boost::any> DataType;
+  DataType mData;
 
 public:
   typedef ExifData::byte byte;
@@ -68,6 +73,73 @@ public:
   void setBytes(const char* key, const std::vector<byte>& bytes) {
     mData[key] = bytes;
   }
+
+  /*
+   * Writes every key and value in the layout described in
+   * exif_cache_format.h.
+   */
+  void serialize(std::string& out) const {
+    namespace Format = ExifCacheFormat;
+
+    std::vector<std::string> keys;
+    keys.reserve(mData.size());
+    for (DataType::const_iterator it = mData.begin(); it != mData.end(); ++it) {
+      keys.push_back(it->first);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    Format::BodyHeader header;
+    header.nEntries = keys.size();
+    header.reserved = 0;
+
+    std::vector<Format::Entry> entries(keys.size());
+    std::string blob;
+
+    const std::size_t blobOffset =
+        sizeof(header) + entries.size() * sizeof(Format::Entry);
+
+    for (std::size_t i = 0; i < keys.size(); i++) {
+      const boost::any& value(mData.find(keys[i])->second);
+      Format::Entry& entry(entries[i]);
+
+      entry.keyOffset = blobOffset + blob.size();
+      blob.append(keys[i].c_str(), keys[i].size() + 1);
+
+      std::string valueBytes;
+      if (value.type() == typeid(std::string)) {
+        entry.type = Format::TYPE_STRING;
+        valueBytes = boost::any_cast<std::string>(value);
+      } else if (value.type() == typeid(int)) {
+        entry.type = Format::TYPE_INT;
+        const boost::int32_t i32 = boost::any_cast<int>(value);
+        valueBytes.assign(reinterpret_cast<const char*>(&i32), sizeof(i32));
+      } else if (value.type() == typeid(float)) {
+        entry.type = Format::TYPE_FLOAT;
+        const float f = boost::any_cast<float>(value);
+        valueBytes.assign(reinterpret_cast<const char*>(&f), sizeof(f));
+      } else {
+        entry.type = Format::TYPE_BYTES;
+        const std::vector<byte>& bytes(
+            boost::any_cast<const std::vector<byte>&>(value));
+        if (!bytes.empty()) {
+          valueBytes.assign(
+              reinterpret_cast<const char*>(&bytes[0]), bytes.size());
+        }
+      }
+
+      entry.valueOffset = blobOffset + blob.size();
+      entry.valueLength = valueBytes.size();
+      blob.append(valueBytes);
+    }
+
+    out.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!entries.empty()) {
+      out.append(
+          reinterpret_cast<const char*>(&entries[0]),
+          entries.size() * sizeof(Format::Entry));
+    }
+    out.append(blob);
+  }
 };
 
 class InMemoryExifData::Impl : public InMemoryExifDataMixin {
@@ -114,6 +186,26 @@ void InMemoryExifData::setString(const char* key, const std::string& s)
   impl->setString(key, s);
 }
 
+void InMemoryExifData::setInt(const char* key, int i)
+{
+  impl->setInt(key, i);
+}
+
+void InMemoryExifData::setFloat(const char* key, float f)
+{
+  impl->setFloat(key, f);
+}
+
+void InMemoryExifData::setBytes(const char* key, const std::vector<byte>& bytes)
+{
+  impl->setBytes(key, bytes);
+}
+
+void InMemoryExifData::serialize(std::string& out) const
+{
+  impl->serialize(out);
+}
+
 /*
  * This code is uncannily similar to dcraw's TIFF-parsing code.
  *
@@ -541,9 +633,11 @@ class DcrawExifData::Impl : public InMemoryExifDataMixin {
 #undef FORC4
   }; // struct Sandbox
   std::auto_ptr<Sandbox> mSandbox;
+  MemoryStats::Counter mSandboxMemory;
 
   void init() {
     mSandbox.reset(new Sandbox(mIStream));
+    mSandboxMemory.resize(sizeof(Sandbox));
     mSandbox->identify();
 
     if (mSandbox->load_raw == &mSandbox->nikon_compressed_load_raw) {
@@ -577,13 +671,16 @@ class DcrawExifData::Impl : public InMemoryExifDataMixin {
   }
 
 public:
-  Impl(std::streambuf& istream) : InMemoryExifDataMixin(), mIStream(istream) {
+  Impl(std::streambuf& istream)
+    : InMemoryExifDataMixin(), mIStream(istream),
+      mSandboxMemory(MemoryStats::DECODERS) {
     this->init();
   }
 
   Impl(FILE* f)
     : InMemoryExifDataMixin()
-    , mFileIStream(new c_file_istreambuf(f)), mIStream(*mFileIStream) {
+    , mFileIStream(new c_file_istreambuf(f)), mIStream(*mFileIStream)
+    , mSandboxMemory(MemoryStats::DECODERS) {
     this->init();
   }
 };
@@ -634,4 +731,9 @@ float DcrawExifData::getFloat(const char* key) const
   return impl->getFloat(key);
 }
 
+void DcrawExifData::serialize(std::string& out) const
+{
+  impl->serialize(out);
+}
+
 } // namespace refinery
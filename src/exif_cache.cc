@@ -0,0 +1,366 @@
+#include "refinery/exif_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exif_cache_format.h"
+
+namespace refinery {
+
+namespace Format = ExifCacheFormat;
+
+namespace {
+  bool statFile(const char* filename, Format::FileHeader& outHeader)
+  {
+    struct stat st;
+    if (::stat(filename, &st) != 0) return false;
+
+    std::memcpy(outHeader.magic, Format::Magic, sizeof(outHeader.magic));
+    outHeader.version = Format::Version;
+    outHeader.device = st.st_dev;
+    outHeader.inode = st.st_ino;
+    outHeader.size = st.st_size;
+    outHeader.mtime = st.st_mtime;
+    outHeader.mtimeNsec = st.st_mtim.tv_nsec; // same-second rewrites happen
+    return true;
+  }
+
+  bool sameIdentity(const Format::FileHeader& a, const Format::FileHeader& b)
+  {
+    return !std::memcmp(a.magic, b.magic, sizeof(a.magic))
+        && a.version == b.version
+        && a.device == b.device
+        && a.inode == b.inode
+        && a.size == b.size
+        && a.mtime == b.mtime
+        && a.mtimeNsec == b.mtimeNsec;
+  }
+} // namespace {}
+
+class MappedExifData::Impl {
+  const char* mMapping;
+  std::size_t mMappingSize;
+  const char* mBody;
+  std::size_t mBodySize;
+  const Format::Entry* mEntries;
+  std::size_t mNEntries;
+
+  void fail(const char* path, const char* reason)
+  {
+    throw std::runtime_error(
+        std::string("Invalid Exif cache file `") + path + "': " + reason);
+  }
+
+  void map(const char* path)
+  {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) fail(path, "could not open");
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      fail(path, "could not stat");
+    }
+    mMappingSize = st.st_size;
+
+    if (mMappingSize < sizeof(Format::FileHeader) + sizeof(Format::BodyHeader))
+    {
+      ::close(fd);
+      fail(path, "truncated");
+    }
+
+    void* mapping = ::mmap(0, mMappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) fail(path, "could not mmap");
+    mMapping = static_cast<const char*>(mapping);
+  }
+
+  void validate(const char* path)
+  {
+    const Format::FileHeader& header(this->header());
+    if (std::memcmp(header.magic, Format::Magic, sizeof(header.magic))
+        || header.version != Format::Version) {
+      fail(path, "wrong magic or version");
+    }
+
+    mBody = mMapping + sizeof(Format::FileHeader);
+    mBodySize = mMappingSize - sizeof(Format::FileHeader);
+
+    Format::BodyHeader bodyHeader;
+    std::memcpy(&bodyHeader, mBody, sizeof(bodyHeader));
+    mNEntries = bodyHeader.nEntries;
+    mEntries = reinterpret_cast<const Format::Entry*>(
+        mBody + sizeof(Format::BodyHeader));
+
+    const std::size_t blobOffset =
+        sizeof(Format::BodyHeader) + mNEntries * sizeof(Format::Entry);
+    if (blobOffset > mBodySize) fail(path, "truncated entry table");
+
+    for (std::size_t i = 0; i < mNEntries; i++) {
+      const Format::Entry& entry(mEntries[i]);
+      if (entry.keyOffset < blobOffset || entry.keyOffset >= mBodySize
+          || !std::memchr(
+            mBody + entry.keyOffset, '\0', mBodySize - entry.keyOffset)
+          || entry.valueOffset > mBodySize
+          || entry.valueLength > mBodySize - entry.valueOffset
+          || ((entry.type == Format::TYPE_INT
+              || entry.type == Format::TYPE_FLOAT)
+            && entry.valueLength != Format::ScalarLength)) {
+        fail(path, "corrupt entry");
+      }
+    }
+  }
+
+  const char* keyAt(std::size_t i) const
+  {
+    return mBody + mEntries[i].keyOffset;
+  }
+
+  const Format::Entry* findEntry(const char* key) const
+  {
+    std::size_t lo = 0;
+    std::size_t hi = mNEntries;
+    while (lo < hi) {
+      const std::size_t mid = lo + (hi - lo) / 2;
+      const int cmp = std::strcmp(keyAt(mid), key);
+      if (cmp == 0) return &mEntries[mid];
+      if (cmp < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return 0;
+  }
+
+  const Format::Entry& getEntry(const char* key, Format::ValueType type) const
+  {
+    const Format::Entry* entry(findEntry(key));
+    if (!entry) {
+      throw std::out_of_range(std::string("Invalid Exif key `") + key + "'");
+    }
+    if (entry->type != static_cast<boost::uint32_t>(type)) {
+      std::stringstream err;
+      err << "Exif value should be type " << type << ", but has type "
+          << entry->type << ": " << key;
+      throw std::logic_error(err.str());
+    }
+    return *entry;
+  }
+
+  template<typename T> T getScalar(const char* key, Format::ValueType type) const
+  {
+    const Format::Entry& entry(getEntry(key, type));
+    T ret;
+    std::memcpy(&ret, mBody + entry.valueOffset, sizeof(ret));
+    return ret;
+  }
+
+public:
+  Impl(const char* path) : mMapping(0), mMappingSize(0)
+  {
+    this->map(path);
+    try {
+      this->validate(path);
+    } catch (...) {
+      ::munmap(const_cast<char*>(mMapping), mMappingSize);
+      throw;
+    }
+  }
+
+  ~Impl()
+  {
+    ::munmap(const_cast<char*>(mMapping), mMappingSize);
+  }
+
+  const Format::FileHeader& header() const
+  {
+    return *reinterpret_cast<const Format::FileHeader*>(mMapping);
+  }
+
+  bool hasKey(const char* key) const
+  {
+    return findEntry(key) != 0;
+  }
+
+  std::string getString(const char* key) const
+  {
+    const Format::Entry& entry(getEntry(key, Format::TYPE_STRING));
+    return std::string(mBody + entry.valueOffset, entry.valueLength);
+  }
+
+  void getBytes(const char* key, std::vector<byte>& outBytes) const
+  {
+    const Format::Entry& entry(getEntry(key, Format::TYPE_BYTES));
+    const byte* bytes(
+        reinterpret_cast<const byte*>(mBody + entry.valueOffset));
+    outBytes.assign(bytes, bytes + entry.valueLength);
+  }
+
+  int getInt(const char* key) const
+  {
+    return getScalar<boost::int32_t>(key, Format::TYPE_INT);
+  }
+
+  float getFloat(const char* key) const
+  {
+    return getScalar<float>(key, Format::TYPE_FLOAT);
+  }
+};
+
+MappedExifData::MappedExifData(const char* path)
+  : impl(new Impl(path))
+{
+}
+
+MappedExifData::~MappedExifData()
+{
+  delete impl;
+}
+
+bool MappedExifData::hasKey(const char* key) const
+{
+  return impl->hasKey(key);
+}
+
+std::string MappedExifData::getString(const char* key) const
+{
+  return impl->getString(key);
+}
+
+void MappedExifData::getBytes(
+    const char* key, std::vector<byte>& outBytes) const
+{
+  impl->getBytes(key, outBytes);
+}
+
+int MappedExifData::getInt(const char* key) const
+{
+  return impl->getInt(key);
+}
+
+float MappedExifData::getFloat(const char* key) const
+{
+  return impl->getFloat(key);
+}
+
+ExifCache::ExifCache(const char* directory)
+  : mDirectory(directory)
+{
+}
+
+std::string ExifCache::cachePath(const char* filename) const
+{
+  Format::FileHeader identity;
+  if (!statFile(filename, identity)) return std::string();
+
+  char name[96];
+  std::sprintf(name, "%llx-%llx-%llx-%llx.%llx.rxc",
+      static_cast<unsigned long long>(identity.device),
+      static_cast<unsigned long long>(identity.inode),
+      static_cast<unsigned long long>(identity.size),
+      static_cast<unsigned long long>(identity.mtime),
+      static_cast<unsigned long long>(identity.mtimeNsec));
+
+  return mDirectory + "/" + name;
+}
+
+ExifData* ExifCache::find(const char* filename) const
+{
+  Format::FileHeader identity;
+  if (!statFile(filename, identity)) return 0;
+
+  const std::string path(cachePath(filename));
+  if (path.empty() || ::access(path.c_str(), R_OK) != 0) return 0;
+
+  std::auto_ptr<MappedExifData> ret;
+  try {
+    ret.reset(new MappedExifData(path.c_str()));
+  } catch (const std::runtime_error&) {
+    return 0; // a corrupt cache file is just a miss; store() will replace it
+  }
+
+  // The file name encodes the identity, but double-check the header in case
+  // the cache directory was copied between machines.
+  Format::FileHeader cachedIdentity;
+  std::memcpy(&cachedIdentity, &ret->impl->header(), sizeof(cachedIdentity));
+  if (!sameIdentity(identity, cachedIdentity)) return 0;
+
+  return ret.release();
+}
+
+bool ExifCache::store(
+    const char* filename, const std::string& serializedExifData) const
+{
+  Format::FileHeader identity;
+  if (!statFile(filename, identity)) return false;
+
+  const std::string path(cachePath(filename));
+
+  // A unique name, so concurrent stores (even from one process) never
+  // write the same temporary file
+  const std::string pattern(path + ".tmp.XXXXXX");
+  std::vector<char> tmpPath(pattern.begin(), pattern.end());
+  tmpPath.push_back('\0');
+
+  const int fd = ::mkstemp(&tmpPath[0]);
+  if (fd == -1) return false;
+  const std::string tmp(&tmpPath[0]);
+
+  // mkstemp() makes the file private; cache files are for everyone
+  FILE* f = ::fchmod(fd, 0644) == 0 ? ::fdopen(fd, "wb") : 0;
+  if (!f) {
+    ::close(fd);
+    std::remove(tmp.c_str());
+    return false;
+  }
+
+  const bool written =
+      std::fwrite(&identity, sizeof(identity), 1, f) == 1
+      && std::fwrite(
+          serializedExifData.data(), 1, serializedExifData.size(), f)
+        == serializedExifData.size();
+
+  if (std::fclose(f) != 0 || !written
+      || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+ExifData* ExifCache::getExifData(const char* filename) const
+{
+  ExifData* cached = find(filename);
+  if (cached) return cached;
+
+  // Not a c_file_istreambuf: its position is off by whatever it buffered,
+  // and dcraw's identify() ftell()s all the time
+  std::filebuf fb;
+  if (!fb.open(filename, std::ios::in | std::ios::binary)) {
+    throw std::runtime_error(
+        std::string("Could not open raw file `") + filename + "'");
+  }
+
+  std::auto_ptr<DcrawExifData> exifData(new DcrawExifData(fb));
+
+  std::string serialized;
+  exifData->serialize(serialized);
+  store(filename, serialized); // a failed store() is just a future miss
+
+  return exifData.release();
+}
+
+} // namespace refinery
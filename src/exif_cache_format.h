@@ -0,0 +1,59 @@
+#ifndef _REFINERY_EXIF_CACHE_FORMAT_H
+#define _REFINERY_EXIF_CACHE_FORMAT_H
+
+#include <boost/cstdint.hpp>
+
+namespace refinery {
+
+/*
+ * Layout of a serialized ExifData, as written by serialize() and read by
+ * MappedExifData.
+ *
+ * A cache file is a FileHeader followed by a serialized body. The body is a
+ * BodyHeader, then nEntries Entry structs sorted by key (strcmp() order, so
+ * lookups can binary-search), then a blob holding every key (NUL-terminated)
+ * and every value. All offsets are relative to the start of the body.
+ *
+ * Everything is stored in host byte order: a cache is only meant to be read
+ * on the machine that wrote it.
+ */
+namespace ExifCacheFormat {
+  static const char Magic[4] = { 'R', 'X', 'C', '1' };
+  static const boost::uint32_t Version = 2;
+
+  enum ValueType {
+    TYPE_STRING = 1,
+    TYPE_INT = 2,
+    TYPE_FLOAT = 3,
+    TYPE_BYTES = 4
+  };
+
+  // TYPE_INT values are 32-bit ints and TYPE_FLOAT values are floats
+  static const boost::uint32_t ScalarLength = 4;
+
+  struct FileHeader {
+    char magic[4];
+    boost::uint32_t version;
+    boost::uint64_t device;
+    boost::uint64_t inode;
+    boost::uint64_t size;
+    boost::uint64_t mtime;
+    boost::uint64_t mtimeNsec;
+  };
+
+  struct BodyHeader {
+    boost::uint32_t nEntries;
+    boost::uint32_t reserved;
+  };
+
+  struct Entry {
+    boost::uint32_t keyOffset;
+    boost::uint32_t valueOffset;
+    boost::uint32_t valueLength;
+    boost::uint32_t type;
+  };
+} // namespace ExifCacheFormat
+
+} // namespace refinery
+
+#endif /* _REFINERY_EXIF_CACHE_FORMAT_H */
@@ -0,0 +1,110 @@
+#ifndef _REFINERY_FILTER_PATTERN_H
+#define _REFINERY_FILTER_PATTERN_H
+
+namespace refinery {
+
+/*
+ * A sensor's color pattern, as in Image::filters(): which color each pixel
+ * is.
+ *
+ * Image::colorAtPoint() shifts and masks Image::filters() for every call.
+ * Loops that look colors up per pixel can instead be templated on a
+ * pattern type, and run through withFilterPattern(): on the four Bayer
+ * patterns, the pattern is a compile-time constant, so colorAtPoint()
+ * folds away (or down to a row's parity) and the loop can be unrolled and
+ * vectorized. Other patterns get FilterPattern, which looks colors up at
+ * run time, as Image does.
+ */
+class FilterPattern {
+  unsigned int mFilters;
+
+public:
+  explicit FilterPattern(unsigned int filters) : mFilters(filters) {}
+
+  unsigned int filters() const { return mFilters; }
+
+  unsigned int colorAtPoint(unsigned int row, unsigned int col) const {
+    return (mFilters >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
+  }
+};
+
+/*
+ * A pattern known at compile time.
+ */
+template<unsigned int Filters>
+class FixedFilterPattern {
+public:
+  unsigned int filters() const { return Filters; }
+
+  unsigned int colorAtPoint(unsigned int row, unsigned int col) const {
+    return (Filters >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
+  }
+};
+
+/*
+ * Where one row of a Bayer pattern has its colors, from column left on.
+ *
+ * The four Bayer patterns look like these (copied from dcraw comments):
+ *
+ *    0 1 2 3 4 5    0 1 2 3 4 5    0 1 2 3 4 5    0 1 2 3 4 5
+ *    0 B G B G B G  0 G R G R G R  0 G B G B G B  0 R G R G R G
+ *    1 G R G R G R  1 B G B G B G  1 R G R G R G  1 G B G B G B
+ *    2 B G B G B G  2 G R G R G R  2 G B G B G B  2 R G R G R G
+ *    3 G R G R G R  3 B G B G B G  3 R G R G R G  3 G B G B G B
+ *
+ * So we know:
+ * - every 2nd row starts with the same color; the other is green
+ * - horizontally, we only see two colors on a row (one is green)
+ * - vertically, we only see two colors on a column (one is green)
+ * - if we're looking at a green pixel and we know the row's other
+ *   color c, the column's color is 2-c
+ *
+ * Pattern is anything with colorAtPoint(row, col): an image, or one of the
+ * patterns above.
+ */
+struct BayerRow {
+  unsigned int rowC; // the row's color besides green (0 or 2)
+  int gCol; // the first green column
+  int rbCol; // the first red or blue column
+
+  template<typename Pattern>
+  BayerRow(const Pattern& pattern, int row, int left)
+  {
+    const unsigned int G = 1;
+    const unsigned int c = pattern.colorAtPoint(row, left);
+
+    rowC = c == G ? pattern.colorAtPoint(row, left + 1) : c;
+    gCol = left + (c != G);
+    rbCol = left + (c == G);
+  }
+};
+
+/*
+ * Number of columns from col (inclusive) to end (exclusive), stepping 2.
+ */
+inline int everyOther(int col, int end)
+{
+  return col < end ? (end - col + 1) / 2 : 0;
+}
+
+/*
+ * Calls functor(pattern) with the FixedFilterPattern for filters if it's
+ * one of the four Bayer patterns, or with a FilterPattern otherwise.
+ *
+ * Functor needs a template operator() that takes any pattern type.
+ */
+template<typename Functor>
+void withFilterPattern(unsigned int filters, Functor& functor)
+{
+  switch (filters) {
+    case 0x16161616: functor(FixedFilterPattern<0x16161616>()); break;
+    case 0x61616161: functor(FixedFilterPattern<0x61616161>()); break;
+    case 0x49494949: functor(FixedFilterPattern<0x49494949>()); break;
+    case 0x94949494: functor(FixedFilterPattern<0x94949494>()); break;
+    default: functor(FilterPattern(filters));
+  }
+}
+
+} // namespace refinery
+
+#endif /* _REFINERY_FILTER_PATTERN_H */
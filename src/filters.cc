@@ -4,10 +4,23 @@
 #include "refinery/color.h"
 #include "refinery/gamma.h"
 #include "refinery/image.h"
+#include "refinery/image_view.h"
+#include "refinery/planar_image.h"
 
 namespace refinery {
 
 namespace {
+  /*
+   * Stores a computed color value. 16-bit values are clamped; floats are
+   * kept as-is, so highlights keep their headroom until quantize().
+   */
+  inline void storeValue(unsigned short& out, int val) {
+    if (val < 0) val = 0;
+    if (val > 0xffff) val = 0xffff;
+    out = val;
+  }
+  inline void storeValue(float& out, float val) { out = val; }
+
   template<typename T>
   class ScaleColorsFilterImpl {
   public:
@@ -18,42 +31,36 @@ namespace {
 
   private:
     ImageType& mImage;
-    const CameraData& mCameraData;
-
-    ValueType clamp16(int val) {
-      if (val < 0) return 0;
-      if (val > 0xffff) return 0xffff;
-      return val;
-    }
+    const double* mMultipliers;
 
   public:
     ScaleColorsFilterImpl(ImageType& image)
-        : mImage(image), mCameraData(image.cameraData()) {}
-
-    void filter() {
-      Camera::ColorConversionData colorData(mCameraData.colorConversionData());
+        : mImage(image),
+          mMultipliers(
+            image.profile().colorConversionData().scalingMultipliers) {}
 
-      const unsigned int height(mImage.height());
-      const unsigned int width(mImage.width());
+    ScaleColorsFilterImpl(ImageType& image, const double multipliers[4])
+        : mImage(image), mMultipliers(multipliers) {}
 
-      for (unsigned int row = 0; row < height; row++) {
-        PixelType* pix(mImage.pixelsAtRow(row));
-        const PixelType* lastPixel(mImage.constPixelsAtPoint(row, width - 1));
+    void filter() {
+      const int height(mImage.height());
+      const int width(mImage.width());
 
-        RGBImage::ColorType c1 = mImage.colorAtPoint(Point(row, 0));
-        RGBImage::ColorType c2 = mImage.colorAtPoint(Point(row, 1));
+      // Colors are looked up once per row; the inner loop is then a flat,
+      // branch-free pass the compiler can vectorize.
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+      for (int row = 0; row < height; row++) {
+        ValueType* values(mImage.pixelsAtRow(row)[0].array());
 
-        double multiplier1 = colorData.scalingMultipliers[c1];
-        double multiplier2 = colorData.scalingMultipliers[c2];
+        const double multipliers[2] = {
+          mMultipliers[mImage.colorAtPoint(Point(row, 0))],
+          mMultipliers[mImage.colorAtPoint(Point(row, 1))]
+        };
 
-        while (pix < lastPixel) {
-          pix->value() = clamp16(multiplier1 * pix->value());
-          pix++;
-          pix->value() = clamp16(multiplier2 * pix->value());
-          pix++;
-        }
-        if (pix == lastPixel) {
-          pix->value() = clamp16(multiplier1 * pix->value());
+        for (int col = 0; col < width; col++) {
+          storeValue(values[col], multipliers[col & 1] * values[col]);
         }
       }
     }
@@ -69,20 +76,15 @@ namespace {
 
   private:
     ImageType& mImage;
-    const CameraData& mCameraData;
-
-    unsigned short clamp16(int val) {
-      // Assume right-shift of signed values leaves 1s, not 0s
-      const unsigned int trashBits = val >> 16;
-      return trashBits ? (~trashBits >> 16) : val;
-    }
+    const CameraProfile& mProfile;
 
   public:
     ConvertToRgbFilterImpl(ImageType& image)
-        : mImage(image), mCameraData(image.cameraData()) {}
+        : mImage(image), mProfile(image.profile()) {}
 
     void filter() {
-      Camera::ColorConversionData colorData(mCameraData.colorConversionData());
+      const Camera::ColorConversionData& colorData(
+          mProfile.colorConversionData());
 
       ColorConverter<float, 4, 3> converter(colorData.cameraToRgb);
 
@@ -95,9 +97,66 @@ namespace {
           RGBPixel<float> rgb;
           converter.convert(pixels[0].constArray(), rgb.array());
 
-          pixels[0][0] = clamp16(rgb.r());
-          pixels[0][1] = clamp16(rgb.g());
-          pixels[0][2] = clamp16(rgb.b());
+          storeValue(pixels[0][0], rgb.r());
+          storeValue(pixels[0][1], rgb.g());
+          storeValue(pixels[0][2], rgb.b());
+        }
+      }
+    }
+  };
+
+  template<typename U, unsigned int N>
+  class ConvertToRgbFilterImpl<PlanarImage<U, N> > {
+  public:
+    typedef PlanarImage<U, N> ImageType;
+    typedef typename ImageType::ValueType ValueType;
+
+  private:
+    ImageType& mImage;
+    const CameraProfile& mProfile;
+
+  public:
+    ConvertToRgbFilterImpl(ImageType& image)
+        : mImage(image), mProfile(image.profile()) {}
+
+    /*
+     * Same arithmetic as the interleaved version (so same results), but
+     * each row is three flat arrays, which vectorizes.
+     */
+    void filter() {
+      const Camera::ColorConversionData& colorData(
+          mProfile.colorConversionData());
+
+      float m[3][3];
+      for (unsigned int i = 0; i < 3; i++) {
+        for (unsigned int j = 0; j < 3; j++) {
+          m[i][j] = static_cast<float>(colorData.cameraToRgb[i][j]);
+        }
+      }
+
+      const int height(mImage.height());
+      const int width(mImage.width());
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+      for (int row = 0; row < height; row++) {
+        ValueType* p0(mImage.planeRow(0, row));
+        ValueType* p1(mImage.planeRow(1, row));
+        ValueType* p2(mImage.planeRow(2, row));
+
+        for (int col = 0; col < width; col++) {
+          float out[3];
+          for (unsigned int i = 0; i < 3; i++) {
+            out[i] = 0.0f;
+            out[i] += m[i][0] * p0[col];
+            out[i] += m[i][1] * p1[col];
+            out[i] += m[i][2] * p2[col];
+          }
+
+          storeValue(p0[col], out[0]);
+          storeValue(p1[col], out[1]);
+          storeValue(p2[col], out[2]);
         }
       }
     }
@@ -121,13 +180,51 @@ namespace {
       : mImage(image), mGammaCurve(gammaCurve) {}
 
     void filter() {
-      PixelType* pixel = mImage.pixels();
-      const PixelType* endPixel = mImage.constPixelsEnd();
+      const unsigned int height(mImage.height());
+      const unsigned int width(mImage.width());
+
+      for (unsigned int row = 0; row < height; row++) {
+        PixelType* pixel(mImage.pixelsAtRow(row));
+        const PixelType* endPixel(pixel + width);
 
-      for (; pixel < endPixel; pixel++) {
-        for (ColorType c = 0; c < PixelType::NColors; c++) {
-          ValueType& v((*pixel)[c]);
-          v = mGammaCurve.at(v);
+        for (; pixel < endPixel; pixel++) {
+          for (ColorType c = 0; c < PixelType::NColors; c++) {
+            ValueType& v((*pixel)[c]);
+            v = mGammaCurve.at(v);
+          }
+        }
+      }
+    }
+  };
+
+  template<typename U, unsigned int N>
+  class GammaFilterImpl<PlanarImage<U, N> > {
+  public:
+    typedef PlanarImage<U, N> ImageType;
+    typedef typename ImageType::ValueType ValueType;
+    typedef GammaCurve<ValueType> CurveType;
+
+  private:
+    ImageType& mImage;
+    const CurveType& mGammaCurve;
+
+  public:
+    GammaFilterImpl(ImageType& image, const CurveType& gammaCurve)
+      : mImage(image), mGammaCurve(gammaCurve) {}
+
+    void filter() {
+      const int height(mImage.height());
+      const int width(mImage.width());
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+      for (int row = 0; row < height; row++) {
+        for (unsigned int c = 0; c < N; c++) {
+          ValueType* v(mImage.planeRow(c, row));
+          for (int col = 0; col < width; col++) {
+            v[col] = mGammaCurve.at(v[col]);
+          }
         }
       }
     }
@@ -141,6 +238,13 @@ void ScaleColorsFilter::filter(T& image)
   impl.filter();
 }
 
+template<typename T>
+void ScaleColorsFilter::filter(T& image, const double multipliers[4])
+{
+  ScaleColorsFilterImpl<T> impl(image, multipliers);
+  impl.filter();
+}
+
 template<typename T>
 void ConvertToRgbFilter::filter(T& image)
 {
@@ -157,11 +261,26 @@ void GammaFilter::filter( ImageType& image, const GammaCurveType& gammaCurve)
 
 // Instantiate the ones we need... (hack-ish)
 template void ScaleColorsFilter::filter<GrayImage>(GrayImage&);
+template void ScaleColorsFilter::filter<GrayImage>(
+    GrayImage&, const double[4]);
 template class ScaleColorsFilterImpl<GrayImage>;
 template void ConvertToRgbFilter::filter<RGBImage>(RGBImage&);
 template class ConvertToRgbFilterImpl<RGBImage>;
 template void GammaFilter::filter<RGBImage, GammaCurve<typename RGBImage::ValueType> >(
     RGBImage&, const GammaCurve<typename RGBImage::ValueType>&);
 template class GammaFilterImpl<RGBImage>;
+template void ScaleColorsFilter::filter<GrayImageView>(GrayImageView&);
+template void ScaleColorsFilter::filter<GrayImageView>(
+    GrayImageView&, const double[4]);
+template void ConvertToRgbFilter::filter<RGBImageView>(RGBImageView&);
+template void GammaFilter::filter<RGBImageView, GammaCurve<RGBImageView::ValueType> >(
+    RGBImageView&, const GammaCurve<RGBImageView::ValueType>&);
+template void ScaleColorsFilter::filter<FloatGrayImage>(FloatGrayImage&);
+template void ScaleColorsFilter::filter<FloatGrayImage>(
+    FloatGrayImage&, const double[4]);
+template void ConvertToRgbFilter::filter<FloatRGBImage>(FloatRGBImage&);
+template void ConvertToRgbFilter::filter<PlanarRGBImage>(PlanarRGBImage&);
+template void GammaFilter::filter<PlanarRGBImage, GammaCurve<PlanarRGBImage::ValueType> >(
+    PlanarRGBImage&, const GammaCurve<PlanarRGBImage::ValueType>&);
 
 };
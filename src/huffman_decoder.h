@@ -3,6 +3,8 @@
 
 #include <climits> /* really we want cstdint, but it's not standard yet */
 
+#include "refinery/memory_stats.h"
+
 typedef unsigned short uint16_t;
 
 namespace refinery {
@@ -47,6 +49,7 @@ class HuffmanDecoder {
   uint_fast32_t mBuffer; // some bits, in the least-significant part of the int
   unsigned int mBufferLength; // number of bits
   int mEofs; // count how many EOFs we hit so we don't rewind them in the dtor
+  MemoryStats::Counter mMemory;
 
   void init(const unsigned char initializer[])
   {
@@ -56,6 +59,7 @@ class HuffmanDecoder {
     for (mMaxBits = 16; !counts[mMaxBits-1]; mMaxBits--) {}
 
     mTable.reserve(1 << mMaxBits);
+    mMemory.resize(mTable.capacity() * sizeof(EntryType));
 
     for (int h = 0, len = 0; len < mMaxBits; len++) {
       for (int i = 0; i < counts[len]; i++, leaf++) {
@@ -126,7 +130,8 @@ public:
    * 1111111         0xff
    */
   HuffmanDecoder(std::streambuf& inputStream, const unsigned char initializer[])
-      : mInputStream(inputStream), mBuffer(0), mBufferLength(0), mEofs(0)
+      : mInputStream(inputStream), mBuffer(0), mBufferLength(0), mEofs(0),
+        mMemory(MemoryStats::DECODERS)
   {
     this->init(initializer);
   }
@@ -0,0 +1,210 @@
+#include "refinery/image_buffer.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "refinery/image_pool.h"
+#include "refinery/memory_stats.h"
+
+namespace refinery {
+
+namespace {
+  bool hugePages = true;
+  std::size_t fileThreshold = 0;
+  std::string fileDirectory;
+
+  // Transparent huge pages are 2MB on x86-64; smaller buffers can't use them
+  const std::size_t HugePageSize = 2 * 1024 * 1024;
+
+  // Each thread zero-fills (and so first-touches) chunks this big
+  const std::size_t ZeroFillChunkSize = 256 * 1024;
+
+  void parallelZeroFill(unsigned char* data, std::size_t size)
+  {
+    const long nChunks = (size + ZeroFillChunkSize - 1) / ZeroFillChunkSize;
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+    for (long i = 0; i < nChunks; i++) {
+      const std::size_t offset = i * ZeroFillChunkSize;
+      const std::size_t chunkSize = offset + ZeroFillChunkSize > size
+        ? size - offset
+        : ZeroFillChunkSize;
+      std::memset(data + offset, 0, chunkSize);
+    }
+  }
+} // namespace {}
+
+ImageBuffer::ImageBuffer(
+    std::size_t size, Initialization initialization, ImagePool* pool)
+  : mData(0), mSize(0), mCapacity(0), mPool(pool), mFileBacked(false)
+{
+  this->allocate(size);
+
+  // A fresh file is all zeroes; writing them would page in every byte
+  if (initialization == ZERO_FILL && !mFileBacked) {
+    parallelZeroFill(mData, mSize);
+  }
+}
+
+ImageBuffer::ImageBuffer(const ImageBuffer& rhs)
+  : mData(0), mSize(0), mCapacity(0), mPool(rhs.mPool), mFileBacked(false)
+{
+  this->allocate(rhs.mSize);
+  if (mSize) std::memcpy(mData, rhs.mData, mSize);
+}
+
+ImageBuffer& ImageBuffer::operator=(const ImageBuffer& rhs)
+{
+  if (this != &rhs) {
+    if (mSize != rhs.mSize || mPool != rhs.mPool) {
+      this->release();
+      mPool = rhs.mPool;
+      this->allocate(rhs.mSize);
+    }
+    if (mSize) std::memcpy(mData, rhs.mData, mSize);
+  }
+  return *this;
+}
+
+ImageBuffer::~ImageBuffer()
+{
+  this->release();
+}
+
+void ImageBuffer::allocate(std::size_t size)
+{
+  if (size == 0) return;
+
+  if (fileThreshold && size >= fileThreshold) {
+    this->mapFile(size);
+    return;
+  }
+
+  // Pooled buffers are rounded up so similar sizes can share them
+  const std::size_t capacity = mPool ? ImagePool::sizeClass(size) : size;
+
+  if (mPool) {
+    mData = mPool->take(capacity);
+    if (mData) {
+      mSize = size;
+      mCapacity = capacity;
+      MemoryStats::allocated(MemoryStats::IMAGES, capacity);
+      return;
+    }
+  }
+
+  const bool huge = hugePages && capacity >= HugePageSize;
+  const std::size_t alignment = huge ? HugePageSize : Alignment;
+
+  void* data;
+  if (::posix_memalign(&data, alignment, capacity) != 0) {
+    throw std::bad_alloc();
+  }
+  mData = static_cast<unsigned char*>(data);
+  mSize = size;
+  mCapacity = capacity;
+  MemoryStats::allocated(MemoryStats::IMAGES, capacity);
+
+#ifdef MADV_HUGEPAGE
+  if (huge) {
+    // Only whole huge pages can be advised; a failure here is harmless
+    ::madvise(mData, capacity & ~(HugePageSize - 1), MADV_HUGEPAGE);
+  }
+#endif /* MADV_HUGEPAGE */
+}
+
+void ImageBuffer::mapFile(std::size_t size)
+{
+  std::string directory(fileDirectory);
+  if (directory.empty()) {
+    const char* tmpdir = std::getenv("TMPDIR");
+    directory = tmpdir && *tmpdir ? tmpdir : "/tmp";
+  }
+
+  const std::string pattern(directory + "/refinery-image-XXXXXX");
+  std::vector<char> path(pattern.begin(), pattern.end());
+  path.push_back('\0');
+
+  const int fd = ::mkstemp(&path[0]);
+  if (fd == -1) {
+    throw std::runtime_error(
+        std::string("Could not create image file in `") + directory + "': "
+        + std::strerror(errno));
+  }
+  // The mapping keeps the file alive; nobody else should see it
+  ::unlink(&path[0]);
+
+  if (::ftruncate(fd, size) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw std::runtime_error(
+        std::string("Could not size image file in `") + directory + "': "
+        + std::strerror(err));
+  }
+
+  void* data = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+
+  mData = static_cast<unsigned char*>(data);
+  mSize = size;
+  mCapacity = size;
+  mFileBacked = true;
+}
+
+void ImageBuffer::release()
+{
+  if (mFileBacked) {
+    ::munmap(mData, mCapacity);
+  } else if (mData) {
+    MemoryStats::freed(MemoryStats::IMAGES, mCapacity);
+    if (!(mPool && mPool->give(mData, mCapacity))) std::free(mData);
+  }
+  mData = 0;
+  mSize = 0;
+  mCapacity = 0;
+  mFileBacked = false;
+}
+
+bool ImageBuffer::hugePagesEnabled()
+{
+  return hugePages;
+}
+
+void ImageBuffer::setHugePagesEnabled(bool enabled)
+{
+  hugePages = enabled;
+}
+
+std::size_t ImageBuffer::fileBackingThreshold()
+{
+  return fileThreshold;
+}
+
+void ImageBuffer::setFileBackingThreshold(std::size_t threshold)
+{
+  fileThreshold = threshold;
+}
+
+std::string ImageBuffer::fileBackingDirectory()
+{
+  return fileDirectory;
+}
+
+void ImageBuffer::setFileBackingDirectory(const std::string& directory)
+{
+  fileDirectory = directory;
+}
+
+} // namespace refinery
@@ -0,0 +1,162 @@
+#include "refinery/image_pool.h"
+
+#include <cstdlib>
+#include <map>
+
+#include <pthread.h>
+
+#include "refinery/memory_stats.h"
+
+namespace refinery {
+
+class ImagePool::Impl {
+  typedef std::multimap<std::size_t, unsigned char*> BuffersType;
+
+  mutable pthread_mutex_t mMutex;
+  BuffersType mBuffers; // capacity => idle buffer
+  std::size_t mIdleBytes;
+  std::size_t mMaxBytes;
+
+  class Lock {
+    pthread_mutex_t& mMutex;
+  public:
+    Lock(pthread_mutex_t& mutex) : mMutex(mutex) { pthread_mutex_lock(&mMutex); }
+    ~Lock() { pthread_mutex_unlock(&mMutex); }
+  };
+
+  // Frees the biggest buffers first until we're under maxBytes
+  void trim()
+  {
+    while (mIdleBytes > mMaxBytes) {
+      BuffersType::iterator last(mBuffers.end());
+      --last;
+      mIdleBytes -= last->first;
+      MemoryStats::freed(MemoryStats::CACHES, last->first);
+      std::free(last->second);
+      mBuffers.erase(last);
+    }
+  }
+
+public:
+  Impl(std::size_t maxBytes) : mIdleBytes(0), mMaxBytes(maxBytes)
+  {
+    pthread_mutex_init(&mMutex, 0);
+  }
+
+  ~Impl()
+  {
+    clear();
+    pthread_mutex_destroy(&mMutex);
+  }
+
+  unsigned char* take(std::size_t capacity)
+  {
+    Lock lock(mMutex);
+
+    BuffersType::iterator it(mBuffers.find(capacity));
+    if (it == mBuffers.end()) return 0;
+
+    unsigned char* ret = it->second;
+    mIdleBytes -= capacity;
+    MemoryStats::freed(MemoryStats::CACHES, capacity);
+    mBuffers.erase(it);
+    return ret;
+  }
+
+  bool give(unsigned char* data, std::size_t capacity)
+  {
+    Lock lock(mMutex);
+
+    if (mIdleBytes + capacity > mMaxBytes) return false;
+
+    mBuffers.insert(BuffersType::value_type(capacity, data));
+    mIdleBytes += capacity;
+    MemoryStats::allocated(MemoryStats::CACHES, capacity);
+    return true;
+  }
+
+  std::size_t maxBytes() const
+  {
+    Lock lock(mMutex);
+    return mMaxBytes;
+  }
+
+  void setMaxBytes(std::size_t maxBytes)
+  {
+    Lock lock(mMutex);
+    mMaxBytes = maxBytes;
+    trim();
+  }
+
+  std::size_t idleBytes() const
+  {
+    Lock lock(mMutex);
+    return mIdleBytes;
+  }
+
+  void clear()
+  {
+    Lock lock(mMutex);
+    for (BuffersType::iterator it(mBuffers.begin()); it != mBuffers.end();
+        ++it) {
+      std::free(it->second);
+    }
+    mBuffers.clear();
+    MemoryStats::freed(MemoryStats::CACHES, mIdleBytes);
+    mIdleBytes = 0;
+  }
+};
+
+ImagePool::ImagePool(std::size_t maxBytes)
+  : impl(new Impl(maxBytes))
+{
+}
+
+ImagePool::~ImagePool()
+{
+  delete impl;
+}
+
+unsigned char* ImagePool::take(std::size_t capacity)
+{
+  return impl->take(capacity);
+}
+
+bool ImagePool::give(unsigned char* data, std::size_t capacity)
+{
+  return impl->give(data, capacity);
+}
+
+std::size_t ImagePool::maxBytes() const
+{
+  return impl->maxBytes();
+}
+
+void ImagePool::setMaxBytes(std::size_t maxBytes)
+{
+  impl->setMaxBytes(maxBytes);
+}
+
+std::size_t ImagePool::idleBytes() const
+{
+  return impl->idleBytes();
+}
+
+void ImagePool::clear()
+{
+  impl->clear();
+}
+
+std::size_t ImagePool::sizeClass(std::size_t size)
+{
+  if (size <= 64) return 64;
+
+  // Round up to a multiple of 1/8 of the largest power of two <= size
+  std::size_t highBit = 64;
+  while (highBit <= size / 2) highBit *= 2;
+  const std::size_t step = highBit / 8;
+
+  return (size + step - 1) / step * step;
+}
+
+} // namespace refinery
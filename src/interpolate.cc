@@ -2,54 +2,161 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <limits>
 #include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <pthread.h>
+
+#if _OPENMP
+#include <omp.h>
+#endif /* _OPENMP */
 
 #include "refinery/camera.h"
 #include "refinery/image.h"
 #include "refinery/image_tile.h"
+#include "refinery/image_view.h"
+#include "refinery/planar_image.h"
+
+#include "ahd_kernels.h"
+#include "bilinear_kernels.h"
+#include "cielab_converter.h"
+#include "filter_pattern.h"
+#include "mhc_kernels.h"
+#include "ppg_kernels.h"
+#include "tile_size.h"
 
 namespace refinery {
 
 namespace {
-  void interpolateBorder(RGBImage& rgbImage, const GrayImage& image, int border) {
-    const int width = image.width(), height = image.height();
-    const int top = 0, left = 0, right = width, bottom = height;
+  /*
+   * True if mirrorPad() keeps every pixel's sensor color: if the pattern
+   * repeats every two rows.
+   */
+  bool canMirrorPad(unsigned int filters)
+  {
+    return filters == (filters & 0xff) * 0x01010101u;
+  }
 
-    for (int row = top; row < bottom; row++) {
-      for (int col = left; col < right; col++) {
-        if (col == border && row >= border && row < bottom - border) {
-          col = right - border;
-        }
+  /*
+   * True if filters is a Bayer pattern: each 2x2 block has red, blue and two
+   * diagonal greens, repeating. Every red or blue pixel then has green on
+   * its sides, and every green pixel has red on two opposite sides and blue
+   * on the other two.
+   */
+  bool isBayer(unsigned int filters)
+  {
+    if (!canMirrorPad(filters)) return false;
+
+    const unsigned int G = 1;
+    const unsigned int c00 = filters & 3, c01 = filters >> 2 & 3;
+    const unsigned int c10 = filters >> 4 & 3, c11 = filters >> 6 & 3;
 
-        unsigned int sum[3] = { 0, 0, 0 };
-        unsigned int count[3] = { 0, 0, 0 };
+    if (c00 == G && c11 == G) return c01 + c10 == 2 && c01 != G;
+    if (c01 == G && c10 == G) return c00 + c11 == 2 && c00 != G;
+    return false;
+  }
 
-        for (int y = row - 1; y <= row + 1; y++) {
-          if (y < top || y >= bottom) continue;
+  /*
+   * What to add color values up in: integers for integers, float for float.
+   */
+  template<typename T> struct SumTraits { typedef unsigned int SumType; };
+  template<> struct SumTraits<float> { typedef float SumType; };
 
-          for (int x = col - 1; x <= col + 1; x++) {
-            if (x < left || x >= right) continue;
+  /*
+   * Sets one color of one output pixel, interleaved or planar.
+   */
+  template<typename T>
+  inline void setValue(
+      ImageView<T>& image, int row, int col, unsigned int c,
+      typename T::ValueType value) {
+    image.pixelAtPoint(row, col)[c] = value;
+  }
+  inline void setValue(
+      PlanarRGBImage& image, int row, int col, unsigned int c,
+      PlanarRGBImage::ValueType value) {
+    image.planeRow(c, row)[col] = value;
+  }
 
-            Point p(y, x);
-            RGBImage::ColorType c = image.colorAtPoint(p);
-            sum[c] += image.constPixelAtPoint(p).value();
-            count[c]++;
+  /*
+   * Averages each missing color over the 3x3 neighborhood, for the pixels
+   * less than border from an edge. Run through withFilterPattern().
+   */
+  template<typename OutputImageType, typename InputImageType>
+  class BorderInterpolation {
+    typedef typename InputImageType::PixelType GrayPixelType;
+    typedef typename SumTraits<typename InputImageType::ValueType>::SumType
+      SumType;
+
+    OutputImageType& mRgbImage;
+    const InputImageType& mImage;
+    const int mBorder;
+
+  public:
+    BorderInterpolation(
+        OutputImageType& rgbImage, const InputImageType& image, int border)
+      : mRgbImage(rgbImage), mImage(image), mBorder(border) {}
+
+    template<typename Pattern>
+    void operator()(const Pattern& pattern) {
+      const int width = mImage.width(), height = mImage.height();
+      const int top = 0, left = 0, right = width, bottom = height;
+      const int border = mBorder;
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+      for (int row = top; row < bottom; row++) {
+        const int yStart = std::max(row - 1, top);
+        const int yEnd = std::min(row + 1, bottom - 1);
+
+        for (int col = left; col < right; col++) {
+          // Skip the interior, if the border leaves any
+          if (col == border && row >= border && row < bottom - border) {
+            col = std::max(col, right - border);
           }
-        }
 
-        Point curP(row, col);
-        RGBImage::ColorType curC = image.colorAtPoint(curP);
-        for (RGBImage::ColorType c = 0; c < 3; c++) {
-          if (c == curC) {
-            rgbImage.pixelAtPoint(curP)[c] =
-                image.constPixelAtPoint(curP).value();
-          } else if (count[c]) {
-            rgbImage.pixelAtPoint(curP)[c] = sum[c] / count[c];
+          const int xStart = std::max(col - 1, left);
+          const int xEnd = std::min(col + 1, right - 1);
+
+          SumType sum[3] = { 0, 0, 0 };
+          unsigned int count[3] = { 0, 0, 0 };
+
+          for (int y = yStart; y <= yEnd; y++) {
+            const GrayPixelType* grayRow(mImage.constPixelsAtRow(y));
+
+            for (int x = xStart; x <= xEnd; x++) {
+              const unsigned int c = pattern.colorAtPoint(y, x);
+              sum[c] += grayRow[x].value();
+              count[c]++;
+            }
+          }
+
+          const unsigned int curC = pattern.colorAtPoint(row, col);
+          for (unsigned int c = 0; c < 3; c++) {
+            if (c == curC) {
+              setValue(mRgbImage, row, col, c,
+                  mImage.constPixelsAtRow(row)[col].value());
+            } else if (count[c]) {
+              setValue(mRgbImage, row, col, c, sum[c] / count[c]);
+            } else {
+              // A 1-pixel line can lack a color entirely
+              setValue(mRgbImage, row, col, c, 0);
+            }
           }
         }
       }
     }
+  };
+
+  template<typename OutputImageType, typename InputImageType>
+  void interpolateBorder(
+      OutputImageType& rgbImage, const InputImageType& image, int border) {
+    BorderInterpolation<OutputImageType, InputImageType> interpolation(
+        rgbImage, image, border);
+    withFilterPattern(image.filters(), interpolation);
   }
 } // namespace {}
 
@@ -59,13 +166,15 @@ class BilinearInterpolator {
     unsigned int adjacentColors[8];
     unsigned int otherColors[2];
     unsigned int divisions[2];
+    float scales[2];
   };
 
   class PixelsInstructions {
     PixelInstructions pixels[16][16];
 
     public:
-    PixelsInstructions(const GrayImage& image)
+    template<typename ImageType>
+    PixelsInstructions(const ImageType& image)
     {
       for (unsigned int row = 0; row < 16; row++) {
         for (unsigned int col = 0; col < 16; col++) {
@@ -96,6 +205,7 @@ class BilinearInterpolator {
 
             instructions.otherColors[colorIndex] = color;
             instructions.divisions[colorIndex] = 256 / sums[color];
+            instructions.scales[colorIndex] = 1.0f / sums[color];
 
             colorIndex++;
           }
@@ -110,13 +220,98 @@ class BilinearInterpolator {
     }
   };
 
+  /*
+   * Weighted neighbor values and their averages. 16-bit values use the
+   * original fixed-point arithmetic; floats use plain float arithmetic.
+   */
+  static unsigned int weigh(unsigned short value, unsigned int shift) {
+    return static_cast<unsigned int>(value) << shift;
+  }
+  static float weigh(float value, unsigned int shift) {
+    return value * (1 << shift);
+  }
+  static unsigned short average(
+      unsigned int sum, const PixelInstructions& instructions,
+      unsigned int colorIndex) {
+    return static_cast<unsigned short>(
+        sum * instructions.divisions[colorIndex] >> 8);
+  }
+  static float average(
+      float sum, const PixelInstructions& instructions,
+      unsigned int colorIndex) {
+    return sum * instructions.scales[colorIndex];
+  }
+
+  ImagePool* mPool;
+  bool mPadsBorder;
+
 public:
-  RGBImage* interpolate(const GrayImage& image) {
-    std::auto_ptr<RGBImage> rgbImagePtr(
-        new RGBImage(image.cameraData(), image.width(), image.height()));
-    RGBImage& rgbImage(*rgbImagePtr);
+  BilinearInterpolator(ImagePool* pool, bool padsBorder = false)
+    : mPool(pool), mPadsBorder(padsBorder) {}
+
+  template<typename RGBImageType, typename GrayImageType>
+  RGBImageType* interpolate(const GrayImageType& image) {
+    std::auto_ptr<RGBImageType> rgbImagePtr(
+        new RGBImageType(image.profile(), image.width(), image.height(),
+          ImageBuffer::UNINITIALIZED, mPool));
+    interpolateInto(image, ImageView<typename RGBImageType::PixelType>(
+          *rgbImagePtr));
+    return rgbImagePtr.release();
+  }
+
+  template<typename GrayImageType, typename RGBPixelType>
+  void interpolateInto(
+      const GrayImageType& image, ImageView<RGBPixelType> rgbImage) {
+    const unsigned int border = 1;
+
+    if (mPadsBorder && image.width() > border && image.height() > border
+        && canMirrorPad(image.filters())) {
+      GrayImageType padded(image.profile(), image.width() + 2 * border,
+          image.height() + 2 * border, ImageBuffer::UNINITIALIZED, mPool);
+      mirrorPad(image, border, padded);
+      interpolateInterior(padded, rgbImage, border);
+    } else {
+      interpolateBorder(rgbImage, image, border);
+      interpolateInterior(image, rgbImage, 0);
+    }
+  }
 
-    interpolateBorder(rgbImage, image, 1);
+private:
+  /*
+   * Runs one of kernels' row loops, for 16-bit or float values.
+   */
+  static void interpolateRow(
+      const BilinearKernels& kernels, bool greenPixels,
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, unsigned int c, int n) {
+    if (n <= 0) return;
+    (greenPixels ? kernels.greenPixels : kernels.redBluePixels)(
+        gray, rowLength, rgb, c, n);
+  }
+  static void interpolateRow(
+      const BilinearKernels& kernels, bool greenPixels,
+      const float* gray, std::ptrdiff_t rowLength, float* rgb,
+      unsigned int c, int n) {
+    if (n <= 0) return;
+    (greenPixels ? kernels.greenPixelsFloat : kernels.redBluePixelsFloat)(
+        gray, rowLength, rgb, c, n);
+  }
+
+  /*
+   * Interpolates all but the 1-pixel border of image, into rgbImage offset
+   * up and left by padding.
+   *
+   * Bayer sensors go through BilinearKernels, two runs of same-colored
+   * pixels per row. Other patterns look each pixel's neighbors up in
+   * PixelsInstructions. Either way, rows are split across threads.
+   */
+  template<typename GrayImageType, typename RGBPixelType>
+  void interpolateInterior(
+      const GrayImageType& image, ImageView<RGBPixelType>& rgbImage,
+      unsigned int padding) {
+    typedef typename GrayImageType::PixelType GrayPixelType;
+    typedef typename GrayImageType::ValueType ValueType;
+    typedef typename SumTraits<ValueType>::SumType SumType;
 
     const int width = image.width();
     const int height = image.height();
@@ -126,46 +321,77 @@ public:
     const unsigned int left = 1;
     const unsigned int right = width - 1;
 
+    if (isBayer(image.filters())) {
+      const BilinearKernels& kernels(BilinearKernels::active());
+
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+      for (int row = top; row < static_cast<int>(bottom); row++) {
+        const BayerRow bayer(image, row, left);
+
+        interpolateRow(kernels, true,
+            &image.constPixelsAtPoint(row, bayer.gCol)[0].value(), width,
+            rgbImage.pixelsAtPoint(
+              row - padding, bayer.gCol - padding)[0].array(),
+            bayer.rowC, everyOther(bayer.gCol, right));
+        interpolateRow(kernels, false,
+            &image.constPixelsAtPoint(row, bayer.rbCol)[0].value(), width,
+            rgbImage.pixelsAtPoint(
+              row - padding, bayer.rbCol - padding)[0].array(),
+            bayer.rowC, everyOther(bayer.rbCol, right));
+      }
+      return;
+    }
+
     const int adjacentOffsets[8] = {
       -width - 1, -width, -width + 1, -1, 1, width -1 , width, width + 1
     };
     const PixelsInstructions pixelsInstructions(image);
 
-    for (unsigned int row = top; row < bottom; row++) {
-      RGBImage::PixelType* pix(rgbImage.pixelsAtPoint(row, left));
-      const GrayImage::PixelType* grayPix(image.constPixelsAtPoint(row, left));
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+    for (int row = top; row < static_cast<int>(bottom); row++) {
+      RGBPixelType* pix(
+          rgbImage.pixelsAtPoint(row - padding, left - padding));
+      const GrayPixelType* grayPix(image.constPixelsAtPoint(row, left));
+
+      // We never write each pixel's own color, so it must read 0
+      std::fill(pix, pix + (right - left), RGBPixelType());
 
       for (unsigned int col = left; col < right; col++, pix++, grayPix++) {
         const PixelInstructions& instructions(
             pixelsInstructions.getPixelInstructions(row, col));
 
-        unsigned int sums[3] = { 0, 0, 0 };
+        SumType sums[3] = { 0, 0, 0 };
 
         for (unsigned int adjIndex = 0; adjIndex < 8; adjIndex++) {
           const int adjOffset = adjacentOffsets[adjIndex];
           const unsigned int adjWeight = instructions.adjacentWeights[adjIndex];
           const unsigned int adjColor = instructions.adjacentColors[adjIndex];
 
-          sums[adjColor] +=
-              static_cast<unsigned int>(grayPix[adjOffset].value())
-              << adjWeight;
+          sums[adjColor] += weigh(grayPix[adjOffset].value(), adjWeight);
         }
 
         for (unsigned int colorIndex = 0; colorIndex < 2; colorIndex++) {
           const unsigned int color = instructions.otherColors[colorIndex];
-          const unsigned int division = instructions.divisions[colorIndex];
 
-          pix[0][color] =
-              static_cast<RGBImage::ValueType>(sums[color] * division >> 8);
+          pix[0][color] = average(sums[color], instructions, colorIndex);
         }
       }
     }
-
-    return rgbImagePtr.release();
   }
 };
 
-namespace { std::vector<float> xyzCbrtLookup; } // FIXME make singleton
+namespace {
+  /*
+   * The tile size AHDInterpolator picks when the caller doesn't: chosen once
+   * per process, by AHDInterpolator::autotuneTileSize().
+   */
+  TileSize autotunedAhdTileSize;
+  pthread_once_t autotunedAhdTileSizeOnce = PTHREAD_ONCE_INIT;
+} // namespace {}
 
 class AHDInterpolator {
 private:
@@ -191,74 +417,156 @@ private:
   typedef ImageTile<RGBImage> RGBImageTile;
   typedef ImageTile<LABImage> LABImageTile;
 
-  typedef RGBImage::ColorType Color;
+public:
+  /*
+   * The scratch-pads one thread needs to interpolate one tile.
+   */
+  struct Tiles {
+    RGBImageTile hImageTile;
+    RGBImageTile vImageTile;
+    LABImageTile hLabImageTile;
+    LABImageTile vLabImageTile;
+    HomogeneityTile homoTile;
+
+    Tiles(const Point& imageSize, const Point& tileSize, unsigned int border,
+        unsigned int margin)
+      : hImageTile(imageSize, Point(0, 0), tileSize, border, margin),
+      vImageTile(imageSize, Point(0, 0), tileSize, border, margin),
+      hLabImageTile(imageSize, Point(0, 0), tileSize, border, margin),
+      vLabImageTile(imageSize, Point(0, 0), tileSize, border, margin),
+      homoTile(imageSize, Point(0, 0), tileSize, border, margin)
+    {
+    }
 
-  static const unsigned int H = 0;
-  static const unsigned int V = 1;
+    void setImageSize(const Point& imageSize)
+    {
+      hImageTile.setImageSize(imageSize);
+      vImageTile.setImageSize(imageSize);
+      hLabImageTile.setImageSize(imageSize);
+      vLabImageTile.setImageSize(imageSize);
+      homoTile.setImageSize(imageSize);
+    }
 
-  float xyzCbrtMin;
-  float xyzCbrtMax;
+    void setTopLeft(const Point& topLeft)
+    {
+      hImageTile.setTopLeft(topLeft);
+      vImageTile.setTopLeft(topLeft);
+      hLabImageTile.setTopLeft(topLeft);
+      vLabImageTile.setTopLeft(topLeft);
+      homoTile.setTopLeft(topLeft);
+    }
+  };
 
-public:
-  AHDInterpolator()
-  {
-    if (xyzCbrtLookup.size() != 0x20000) {
-      // This is thread-safe: worst-case we just set the same value multiple
-      // times.
-      xyzCbrtLookup.reserve(0x20000);
-
-      for (int i = 0; i < 0x10000; i++) {
-        double r = i / 65535.0;
-        xyzCbrtLookup[i] = 64.0f * (r > 0.008856 ? std::pow(r, 1.0/3) : 7.787*r + 16.0/116);
+  /*
+   * Tiles for each thread, kept from one interpolation to the next.
+   */
+  class TilesCache {
+    std::vector<Tiles*> mTiles;
+
+    TilesCache(const TilesCache&);
+    TilesCache& operator=(const TilesCache&);
+
+  public:
+    TilesCache() {}
+
+    ~TilesCache()
+    {
+      for (std::vector<Tiles*>::iterator it = mTiles.begin();
+          it != mTiles.end(); ++it) {
+        delete *it;
       }
+    }
 
-      xyzCbrtMin = xyzCbrtLookup[0];
-      xyzCbrtMax = xyzCbrtLookup[0xffff];
+    /*
+     * Makes room for this many threads. Call before a parallel section.
+     */
+    void reserveThreads(unsigned int nThreads)
+    {
+      if (mTiles.size() < nThreads) mTiles.resize(nThreads, 0);
+    }
 
-      for (int i = 0x10000; i <= 0x17fff; i++) {
-        xyzCbrtLookup[i] = xyzCbrtMax;
+    /*
+     * The Tiles for the given thread, allocated if needed.
+     *
+     * Each thread only touches its own slot, so this needs no locking.
+     */
+    Tiles& tilesForThread(
+        unsigned int thread, const Point& imageSize, const Point& tileSize,
+        unsigned int border, unsigned int margin)
+    {
+      Tiles*& tiles(mTiles[thread]);
+      if (tiles && (
+            static_cast<int>(tiles->hImageTile.height()) != tileSize.row
+            || static_cast<int>(tiles->hImageTile.width()) != tileSize.col)) {
+        // The tile size changed since last time
+        delete tiles;
+        tiles = 0;
       }
-      for (int i = 0x18000; i <= 0x1ffff; i++) {
-        xyzCbrtLookup[i] = xyzCbrtMin;
+      if (!tiles) {
+        tiles = new Tiles(imageSize, tileSize, border, margin);
       }
+      tiles->setImageSize(imageSize);
+      return *tiles;
     }
-  }
+  };
+
+  /*
+   * Pixels each tile overlaps its neighbors on each side.
+   */
+  static const unsigned int Margin = 3;
 
 private:
+  ImagePool* mPool;
+  TilesCache* mTilesCache;
+  const AHDKernels& mKernels;
+  TileSize mTileSize;
+  bool mFixedPointLab;
+  bool mPadsBorder;
 
-  /**
-   * Returns cbrt(f/65536), unless f is <= 580 in which case it's a linear
-   * formula.
-   *
-   * Google how to convert RGB to XYZ to LAB. This formula pops up.
-   *
-   * The return value is multiplied by 64.0f, because we convert to an integer.
-   *
-   * If f is a small negative number or a bit over 65535, it will be clamped.
-   * This will only work between around -32767 and 98302.
+  /*
+   * Picks autotunedAhdTileSize from the L2 cache size, or reads the one a
+   * previous process picked on this host from $REFINERY_TILE_SIZE_FILE.
    */
-  float xyz64Cbrt(float f) const
+  static void autotuneTileSize()
   {
-    unsigned int i(static_cast<int>(f) & 0x1ffff);
+    const std::size_t bytesPerPixel =
+      2 * sizeof(RGBImageTile::PixelType)
+      + 2 * sizeof(LABImageTile::PixelType)
+      + sizeof(HomogeneityTile::PixelType);
+
+    const std::size_t cacheBytes = TileSize::detectCacheSize();
+    const char* path = std::getenv("REFINERY_TILE_SIZE_FILE");
+
+    if (path && *path
+        && TileSize::read(path, cacheBytes, autotunedAhdTileSize)) {
+      return;
+    }
+
+    autotunedAhdTileSize =
+      TileSize::forCache(cacheBytes, bytesPerPixel, Margin);
 
-    return xyzCbrtLookup[i];
+    if (path && *path) {
+      autotunedAhdTileSize.write(path, cacheBytes); // failure is harmless
+    }
   }
 
-  /**
-   * Returns v bounded by bound1 and bound2.
-   *
-   * bound1 is the min and bound2 is the max, or vice-versa.
-   */
-  RGBImage::ValueType bound(
-      const RGBImage::ValueType& v,
-      const RGBImage::ValueType& bound1, const RGBImage::ValueType& bound2)
+public:
+  AHDInterpolator(
+      ImagePool* pool, TilesCache* tilesCache = 0,
+      const TileSize& tileSize = TileSize(), bool fixedPointLab = false,
+      bool padsBorder = false)
+    : mPool(pool), mTilesCache(tilesCache), mKernels(AHDKernels::active()),
+      mTileSize(tileSize), mFixedPointLab(fixedPointLab),
+      mPadsBorder(padsBorder)
   {
-    return std::min(
-      std::max(bound1, std::min(v, bound2)),
-      std::max(bound2, std::min(v, bound1))
-      );
+    if (!mTileSize.isSet()) {
+      pthread_once(&autotunedAhdTileSizeOnce, &autotuneTileSize);
+      mTileSize = autotunedAhdTileSize;
+    }
   }
 
+private:
+
   /*
    * Make G values from hImageTile and vImageTile be the approximated Gs we
    * get after looking at original grayscale image.
@@ -271,402 +579,180 @@ private:
       const GrayImage& image,
       RGBImageTile& hImageTile, RGBImageTile& vImageTile)
   {
-    const unsigned int top = hImageTile.top();
-    const unsigned int left = hImageTile.left();
-    const unsigned int right = hImageTile.right();
-    const unsigned int bottom = hImageTile.bottom();
+    const int top = hImageTile.top();
+    const int left = hImageTile.left();
+    const int right = hImageTile.right();
+    const int bottom = hImageTile.bottom();
 
     const int width = image.width();
 
-    for (unsigned int row = top; row < bottom; row++) {
-      unsigned int col =
+    for (int row = top; row < bottom; row++) {
+      const int col =
           left + (image.colorAtPoint(Point(row, left)) & 1); // 1st R or B
 
-      const GrayImage::PixelType* pix(image.constPixelsAtPoint(row, col));
-
-      const GrayImage::PixelType* pixAbove(&pix[-width]);
-      const GrayImage::PixelType* pix2Above(&pix[-2 * width]);
-      const GrayImage::PixelType* pixBelow(&pix[width]);
-      const GrayImage::PixelType* pix2Below(&pix[2 * width]);
-
-      RGBImageTile::PixelType* hPix(hImageTile.pixelsAtImageCoords(row, col));
-      RGBImageTile::PixelType* vPix(vImageTile.pixelsAtImageCoords(row, col));
-
-      for (; col < right;
-          col += 2, pix += 2, hPix += 2, vPix += 2,
-          pixAbove += 2, pix2Above += 2, pixBelow += 2, pix2Below += 2) {
-        RGBImage::ValueType hValue =
-          ((pix[-1].value() + pix[0].value() + pix[1].value()) * 2 // G, c, G
-           - pix[-2].value() - pix[2].value()) >> 2; // c, c
-        hPix[0].g() = bound(hValue, pix[-1].value(), pix[1].value()); // G, G
-
-        RGBImage::ValueType vValue =
-          ((pixAbove[0].value() + pix[0].value() + pixBelow[0].value()) * 2 // G, c, G
-            - pix2Above[0].value() - pix2Below[0].value()) >> 2; // c, c
-        vPix[0].g() = bound(vValue, pixAbove[0].value(), pixBelow[0].value()); // G, G
-      }
+      mKernels.green(
+          &image.constPixelsAtPoint(row, col)[0].value(), width,
+          &hImageTile.pixelsAtImageCoords(row, col)[0].g(),
+          &vImageTile.pixelsAtImageCoords(row, col)[0].g(),
+          everyOther(col, right));
     }
   }
 
-  RGBImage::ValueType clamp16(int val) {
-    // Assume right-shift of signed values leaves 1s, not 0s
-    const unsigned int trashBits = val >> 16;
-    return trashBits ? (~trashBits >> 16) : val;
-  }
-
-  inline void incrPointers(
-      int n, const GrayImage::PixelType* (&pix),
-      const GrayImage::PixelType* (&pixAbove),
-      const GrayImage::PixelType* (&pixBelow),
-      const RGBImageTile::PixelType* (&dPixAbove),
-      const RGBImageTile::PixelType* (&dPixBelow))
-  {
-    pix += n;
-    pixAbove += n;
-    pixBelow += n;
-    dPixAbove += n;
-    dPixBelow += n;
-  }
-
-  inline void fillRandBinGPixel(
-      RGBImageTile::PixelType* dPix, const Color rowC, const Color colC,
-      const GrayImage::PixelType* pix,
-      const GrayImage::PixelType* pixAbove,
-      const GrayImage::PixelType* pixBelow,
-      const RGBImageTile::PixelType* dPixAbove,
-      const RGBImageTile::PixelType* dPixBelow)
-  {
-    const int colCValue =
-        pix[0].value() + // G
-        ((pixAbove[0].value() + pixBelow[0].value() // colC, colC
-          - dPixAbove[0].g() - dPixBelow[0].g()) >> 1); // G, G
-    dPix[0][colC] = clamp16(colCValue);
-
-    const int rowCValue =
-        pix[0].value() + // G
-        ((pix[-1].value() + pix[1].value() // rowC, rowC
-          - dPix[-1].g() - dPix[1].g()) >> 1); // G, G
-    dPix[0][rowC] = clamp16(rowCValue);
-  }
-
-  inline void fillRandBinBorRPixel(
-      RGBImageTile::PixelType* dPix, const Color rowC, const Color colC,
-      const GrayImage::PixelType* pix,
-      const GrayImage::PixelType* pixAbove,
-      const GrayImage::PixelType* pixBelow,
-      const RGBImageTile::PixelType* dPixAbove,
-      const RGBImageTile::PixelType* dPixBelow)
-  {
-    const int colCValue =
-        dPix[0].g() + // G
-        ((pixAbove[-1].value() + pixAbove[1].value() // colC, colC
-          + pixBelow[-1].value() + pixBelow[1].value() // colC, colC
-          - dPixAbove[-1].g() - dPixAbove[1].g() // G, G
-          - dPixBelow[-1].g() - dPixBelow[1].g() // G, G
-          + 1) >> 2);
-    dPix[0][colC] = clamp16(colCValue);
-  }
-
   void fillDirectionalImage(const GrayImage& image, RGBImageTile& dirImageTile)
   {
-    const unsigned int top = dirImageTile.top() + 1;
-    const unsigned int left = dirImageTile.left() + 1;
-    const unsigned int right = dirImageTile.right() - 1;
-    const unsigned int bottom = dirImageTile.bottom() - 1;
+    const int top = dirImageTile.top() + 1;
+    const int left = dirImageTile.left() + 1;
+    const int right = dirImageTile.right() - 1;
+    const int bottom = dirImageTile.bottom() - 1;
 
     const int width = image.width();
-    const int dWidth = dirImageTile.width();
-
-    const Color G = 1;
-
-    for (unsigned int row = top; row < bottom; row++) {
-      /*
-       * We assume the bayer pattern in the filter looks like one of these
-       * (copied from dcraw comments):
-       *
-       *    0 1 2 3 4 5    0 1 2 3 4 5    0 1 2 3 4 5    0 1 2 3 4 5
-       *    0 B G B G B G  0 G R G R G R  0 G B G B G B  0 R G R G R G
-       *    1 G R G R G R  1 B G B G B G  1 R G R G R G  1 G B G B G B
-       *    2 B G B G B G  2 G R G R G R  2 G B G B G B  2 R G R G R G
-       *    3 G R G R G R  3 B G B G B G  3 R G R G R G  3 G B G B G B
-       *
-       * So we know:
-       * - every 2nd row starts with the same color; the other is green
-       * - horizontally, we only see two colors on a row (one is green)
-       * - vertically, we only see two colors on a column (one is green)
-       * - if we're looking at a green pixel and we know the row's other
-       *   color c, the column's color is 2-c
-       */
-
-      Color rowC;
-      Color colC;
-
-      Color c(image.colorAtPoint(Point(row, left)));
-      if (c == G) {
-        rowC = image.colorAtPoint(Point(row, left + 1));
-        colC = 2 - rowC;
-      } else {
-        rowC = c;
-        colC = 2 - c;
-      }
-
-      RGBImageTile::PixelType* dPix(
-          &dirImageTile.pixelsAtImageCoords(row, left + (c != G))[0]);
-      const RGBImageTile::PixelType* dPixAbove(&dPix[-dWidth]);
-      const RGBImageTile::PixelType* dPixBelow(&dPix[dWidth]);
-
-      const GrayImage::PixelType* pix(
-          image.constPixelsAtPoint(row, left + (c != G)));
-      const GrayImage::PixelType* pixAbove(&pix[-width]);
-      const GrayImage::PixelType* pixBelow(&pix[width]);
-
-      for (unsigned int col = left + (c != G); col < right; col += 2) {
-        dPix[0].g() = pix[0].value(); // see createGreenDirectionalImages comment
+    const int dRowLength = dirImageTile.width() * 3;
 
-        fillRandBinGPixel(
-            dPix, rowC, colC, pix, pixAbove, pixBelow, dPixAbove, dPixBelow);
-        dPix += 2;
-        incrPointers(2, pix, pixAbove, pixBelow, dPixAbove, dPixBelow);
-      }
-
-      dPix = dirImageTile.pixelsAtImageCoords(row, left + (c == G));
-      dPixAbove = &dPix[-dWidth];
-      dPixBelow = &dPix[dWidth];
-
-      pix = &image.constPixelsAtRow(row)[left + (c == G)];
-      pixAbove = &pix[-width];
-      pixBelow = &pix[width];
-
-      for (unsigned int col = left + (c == G); col < right; col += 2) {
-        dPix[0][rowC] = pix[0].value();
+    for (int row = top; row < bottom; row++) {
+      const BayerRow bayer(image, row, left);
 
-        fillRandBinBorRPixel(
-            dPix, rowC, colC, pix, pixAbove, pixBelow, dPixAbove, dPixBelow);
+      mKernels.fillGreenPixels(
+          &image.constPixelsAtPoint(row, bayer.gCol)[0].value(), width,
+          dirImageTile.pixelsAtImageCoords(row, bayer.gCol)[0].array(),
+          dRowLength, bayer.rowC, everyOther(bayer.gCol, right));
 
-        dPix += 2;
-        incrPointers(2, pix, pixAbove, pixBelow, dPixAbove, dPixBelow);
-      }
+      mKernels.fillRedBluePixels(
+          &image.constPixelsAtPoint(row, bayer.rbCol)[0].value(), width,
+          dirImageTile.pixelsAtImageCoords(row, bayer.rbCol)[0].array(),
+          dRowLength, bayer.rowC, everyOther(bayer.rbCol, right));
     }
   }
 
-  void rgbToLab(
-      const RGBImage::PixelType& rgb, LABImage::PixelType& lab,
-      const float (&cameraToXyz)[3][4])
-  {
-    float cbrtX = xyz64Cbrt(0.5f
-        + cameraToXyz[0][0] * rgb.r()
-        + cameraToXyz[0][1] * rgb.g()
-        + cameraToXyz[0][2] * rgb.b());
-    float cbrtY = xyz64Cbrt(0.5f
-        + cameraToXyz[1][0] * rgb.r()
-        + cameraToXyz[1][1] * rgb.g()
-        + cameraToXyz[1][2] * rgb.b());
-    float cbrtZ = xyz64Cbrt(0.5f
-        + cameraToXyz[2][0] * rgb.r()
-        + cameraToXyz[2][1] * rgb.g()
-        + cameraToXyz[2][2] * rgb.b());
-
-    lab.l() = static_cast<LABImage::ValueType>(116.0f * cbrtY - (64.0f*16.0f));
-    lab.a() = static_cast<LABImage::ValueType>(500.0f * (cbrtX - cbrtY));
-    lab.b() = static_cast<LABImage::ValueType>(200.0f * (cbrtY - cbrtZ));
-  }
-
   void createCielabImage(
       const RGBImageTile& imageTile, LABImageTile& labImageTile,
-      const float (&cameraToXyz)[3][4])
+      const CielabConverter& cielab)
   {
-    const unsigned int top = imageTile.top() + 1;
-    const unsigned int left = imageTile.left() + 1;
-    const unsigned int right = imageTile.right() - 1;
-    const unsigned int bottom = imageTile.bottom() - 1;
-
-    for (unsigned int row = top; row < bottom; row++) {
-      const RGBImageTile::PixelType* pix(
-          &imageTile.constPixelsAtImageCoords(row, left)[0]);
-
-      LABImageTile::PixelType* lPix(
-          &labImageTile.pixelsAtImageCoords(row, left)[0]);
-
-      for (unsigned int col = left; col < right; col++) {
-        rgbToLab(pix[0], lPix[0], cameraToXyz);
-        pix++;
-        lPix++;
-      }
-    }
-  }
+    const int top = imageTile.top() + 1;
+    const int left = imageTile.left() + 1;
+    const int right = imageTile.right() - 1;
+    const int bottom = imageTile.bottom() - 1;
 
-  unsigned int epsilon(const unsigned int (&diff)[2][4])
-  {
-    return std::min(
-        std::max(diff[H][0], diff[H][1]),
-        std::max(diff[V][2], diff[V][3])) + 1;
+    for (int row = top; row < bottom; row++) {
+      const RGBImageTile::ValueType* rgb(
+          imageTile.constPixelsAtImageCoords(row, left)[0].constArray());
+      LABImageTile::ValueType* lab(
+          labImageTile.pixelsAtImageCoords(row, left)[0].array());
+
+      cielab.convertRow(rgb, lab, right - left);
+    }
   }
 
   void fillHomogeneityMap(
       const LABImageTile& hLabImageTile, const LABImageTile& vLabImageTile,
       HomogeneityTile& homoTile)
   {
-    const unsigned int top = hLabImageTile.top() + 2;
-    const unsigned int left = hLabImageTile.left() + 2;
-    const unsigned int right = hLabImageTile.right() - 2;
-    const unsigned int bottom = hLabImageTile.bottom() - 2;
-
-    const int width = hLabImageTile.width();
+    const int top = hLabImageTile.top() + 2;
+    const int left = hLabImageTile.left() + 2;
+    const int right = hLabImageTile.right() - 2;
+    const int bottom = hLabImageTile.bottom() - 2;
 
-    const int ADJ[4] = { -1, 1, -width, width };
+    const int labRowLength = hLabImageTile.width() * 3;
 
-    for (unsigned int row = top; row < bottom; row++) {
-      HomogeneityTile::PixelType* homoPix(
-          &homoTile.pixelsAtImageCoords(row, left)[0]);
-
-      const LABImageTile::PixelType* labPix[2] = {
-        &hLabImageTile.constPixelsAtImageCoords(row, left)[0],
-        &vLabImageTile.constPixelsAtImageCoords(row, left)[0]
-      };
-
-      const LABImageTile::PixelType* labAdjPix[2][4];
-      for (unsigned int adjDir = 0; adjDir < 4; adjDir++) {
-        labAdjPix[H][adjDir] = &labPix[H][ADJ[adjDir]];
-        labAdjPix[V][adjDir] = &labPix[V][ADJ[adjDir]];
-      }
-
-      for (unsigned int col = left; col < right; col++, homoPix++) {
-        unsigned int lDiff[2][4], abDiff[2][4];
-
-        for (unsigned int dir = H; dir <= V; dir++) {
-          const LABImageTile::PixelType* dirLabPix(labPix[dir]);
-
-          for (unsigned int adjDir = 0; adjDir < 4; adjDir++) {
-            const LABImageTile::PixelType* adjLabPix(labAdjPix[dir][adjDir]);
-
-            const int adjDiffL = dirLabPix[0].l() - adjLabPix[0].l();
-            lDiff[dir][adjDir] = std::abs(adjDiffL);
-
-            const int adjDiffA = dirLabPix[0].a() - adjLabPix[0].a();
-            const int adjDiffB = dirLabPix[0].b() - adjLabPix[0].b();
-            abDiff[dir][adjDir] = adjDiffA * adjDiffA + adjDiffB * adjDiffB;
-
-            labAdjPix[dir][adjDir]++;
-          }
+    for (int row = top; row < bottom; row++) {
+      mKernels.homogeneity(
+          hLabImageTile.constPixelsAtImageCoords(row, left)[0].constArray(),
+          vLabImageTile.constPixelsAtImageCoords(row, left)[0].constArray(),
+          labRowLength, &homoTile.pixelsAtImageCoords(row, left)[0].h,
+          right - left);
+    }
+  }
 
-          labPix[dir]++;
-        }
+  /*
+   * Writes a row of output pixels, interleaved or planar.
+   */
+  void writeRow(
+      RGBImageView& rgbImage, int row, int left, int n,
+      const HomogeneityTile::PixelType* homoPix,
+      const RGBImageTile::PixelType* hPix, const RGBImageTile::PixelType* vPix)
+  {
+    RGBImage::PixelType* pix(rgbImage.pixelsAtPoint(row, left));
 
-        const unsigned int lEps = epsilon(lDiff);
-        const unsigned int abEps = epsilon(abDiff);
-
-        for (unsigned int dir = H; dir <= V; dir++) {
-          unsigned int homogeneity = 0;
-          for (unsigned int adjDir = 0; adjDir < 4; adjDir++) {
-#if 0
-            /* This is the slow way--it uses branches */
-            if (lDiff[dir][adjDir] < lEps && abDiff[dir][adjDir] < abEps)
-            {
-              homogeneity++;
-            }
-#else
-            /*
-             * Here's a branch-free equivalent. It assumes negative numbers
-             * start with a 1 bit (which the C standard mandates)
-             */
-            homogeneity += (
-                ((lDiff[dir][adjDir] - lEps) & (abDiff[dir][adjDir] - abEps))
-                >> (sizeof(lEps) * 8 - 1));
-#endif
-          }
+    mKernels.blendInterleaved(
+        &homoPix[0].h, hPix[0].constArray(), vPix[0].constArray(),
+        &pix[0].r(), &pix[0].g(), &pix[0].b(), n);
+  }
 
-          homoPix[0][dir] = homogeneity;
-        }
-      }
-    }
+  void writeRow(
+      PlanarRGBImage& rgbImage, int row, int left, int n,
+      const HomogeneityTile::PixelType* homoPix,
+      const RGBImageTile::PixelType* hPix, const RGBImageTile::PixelType* vPix)
+  {
+    mKernels.blendPlanar(
+        &homoPix[0].h, hPix[0].constArray(), vPix[0].constArray(),
+        &rgbImage.planeRow(0, row)[left], &rgbImage.planeRow(1, row)[left],
+        &rgbImage.planeRow(2, row)[left], n);
   }
 
+  /*
+   * Writes the tile's interior to rgbImage, offset up and left by padding.
+   */
+  template<typename OutputImageType>
   void fillImage(
-      RGBImage& rgbImage,
+      OutputImageType& rgbImage, int padding,
       const RGBImageTile& hImageTile, const RGBImageTile& vImageTile,
       HomogeneityTile& homoTile)
   {
-    const unsigned int top = hImageTile.top() + 3;
-    const unsigned int left = hImageTile.left() + 3;
-    const unsigned int right = hImageTile.right() - 3;
-    const unsigned int bottom = hImageTile.bottom() - 3;
+    const int top = hImageTile.top() + 3;
+    const int left = hImageTile.left() + 3;
+    const int right = hImageTile.right() - 3;
+    const int bottom = hImageTile.bottom() - 3;
 
-    const int tileWidth = hImageTile.width();
+    const int homoRowLength = homoTile.width() * 3;
 
-    for (unsigned int row = top; row < bottom; row++) {
+    for (int row = top; row < bottom; row++) {
       HomogeneityTile::PixelType* homoPix(
-          &homoTile.pixelsAtImageCoords(row, left)[0]);
-      const HomogeneityTile::PixelType* homoPixAbove(&homoPix[-tileWidth]);
-      const HomogeneityTile::PixelType* homoPixBelow(&homoPix[tileWidth]);
-
-      for (unsigned int col = left; col < right;
-          col++, homoPix++, homoPixAbove++, homoPixBelow++) {
-
-        unsigned int hm[2] = { 0, 0 };
-        for (unsigned int dir = H; dir <= V; dir++) {
-          for (int i = -1; i <= 1; i++) {
-            hm[dir] += homoPixAbove[i].at(dir);
-            hm[dir] += homoPix[i].at(dir);
-            hm[dir] += homoPixBelow[i].at(dir);
-          }
-        }
-
-        homoPix[0].diff = hm[H] - hm[V];
-      }
-    }
+          homoTile.pixelsAtImageCoords(row, left));
 
-    for (unsigned int row = top; row < bottom; row++) {
-      RGBImage::PixelType* pix(rgbImage.pixelsAtPoint(row, left));
+      mKernels.homogeneityDiff(&homoPix[0].h, homoRowLength, right - left);
 
-      const HomogeneityTile::PixelType* homoPix(
-          homoTile.constPixelsAtImageCoords(row, left));
-      const RGBImageTile::PixelType* hPix(
-          hImageTile.constPixelsAtImageCoords(row, left));
-      const RGBImageTile::PixelType* vPix(
+      writeRow(rgbImage, row - padding, left - padding, right - left,
+          homoPix, hImageTile.constPixelsAtImageCoords(row, left),
           vImageTile.constPixelsAtImageCoords(row, left));
-
-      for (unsigned int col = left; col < right;
-          col++, pix++, hPix++, vPix++, homoPix++) {
-        if (homoPix[0].diff > 0) {
-          pix[0] = hPix[0];
-        } else if (homoPix[0].diff < 0) {
-          pix[0] = vPix[0];
-        } else {
-          pix[0].r() = (hPix[0].r() + vPix[0].r()) >> 1;
-          pix[0].g() = (hPix[0].g() + vPix[0].g()) >> 1;
-          pix[0].b() = (hPix[0].b() + vPix[0].b()) >> 1;
-        }
-      }
     }
   }
 
-public:
-  RGBImage* interpolate(const GrayImage& image) {
+  template<typename OutputImageType>
+  void interpolateInto(const GrayImage& image, OutputImageType& rgbImage) {
     const unsigned int border = 5;
 
-    const Camera::ColorConversionData colorData(
-        image.cameraData().colorConversionData());
-    float cameraToXyz[3][4];
-    for (unsigned int i = 0; i < 3; i++) {
-      for (unsigned int j = 0; j < image.cameraData().colors(); j++) {
-        // convert from double to float, for speed
-        cameraToXyz[i][j] = colorData.cameraToXyz[i][j];
+    if (mPadsBorder && image.width() > border && image.height() > border
+        && canMirrorPad(image.filters())) {
+      GrayImage padded(image.profile(), image.width() + 2 * border,
+          image.height() + 2 * border, ImageBuffer::UNINITIALIZED, mPool);
+      mirrorPad(image, border, padded);
+      interpolateInterior(padded, rgbImage, border);
+    } else {
+      interpolateBorder(rgbImage, image, border);
+      if (image.width() > 2 * border && image.height() > 2 * border) {
+        interpolateInterior(image, rgbImage, 0);
       }
     }
+  }
 
-    std::auto_ptr<RGBImage> rgbImagePtr(new RGBImage(
-          image.cameraData(), image.width(), image.height()));
-    RGBImage& rgbImage(*rgbImagePtr);
+  /*
+   * Interpolates all but the 5-pixel border of image, into rgbImage offset
+   * up and left by padding.
+   */
+  template<typename OutputImageType>
+  void interpolateInterior(
+      const GrayImage& image, OutputImageType& rgbImage, int padding) {
+    const unsigned int border = 5;
 
-    interpolateBorder(rgbImage, image, border);
+    const CielabConverter cielab(
+        mKernels, image.profile(), mFixedPointLab);
 
     const unsigned int height = image.height();
     const unsigned int width = image.width();
 
-    const unsigned int tileHeight = 256;
-    const unsigned int tileWidth = 256;
+    const unsigned int tileHeight = mTileSize.height;
+    const unsigned int tileWidth = mTileSize.width;
 
-    const unsigned int margin = 3;
+    const unsigned int margin = Margin;
     const unsigned int left = border - margin;
     const unsigned int top = border - margin;
     const unsigned int bottom = height - border;
@@ -675,19 +761,40 @@ public:
     Point imageSize(height, width);
     Point tileSize(tileHeight, tileWidth);
 
+    if (mTilesCache) {
+#if _OPENMP
+      mTilesCache->reserveThreads(omp_get_max_threads());
+#else
+      mTilesCache->reserveThreads(1);
+#endif /* _OPENMP */
+    }
+
 #if _OPENMP
 #pragma omp parallel
 #endif /* _OPENMP */
     {
       Point tileTopLeft(border - margin, border - margin);
 
-      RGBImageTile hImageTile(imageSize, tileTopLeft, tileSize, border, margin);
-      RGBImageTile vImageTile(imageSize, tileTopLeft, tileSize, border, margin);
-      LABImageTile hLabImageTile(
-          imageSize, tileTopLeft, tileSize, border, margin);
-      LABImageTile vLabImageTile(
-          imageSize, tileTopLeft, tileSize, border, margin);
-      HomogeneityTile homoTile(imageSize, tileTopLeft, tileSize, border, margin);
+      std::auto_ptr<Tiles> ownTiles;
+      Tiles* tiles;
+      if (mTilesCache) {
+#if _OPENMP
+        const unsigned int thread = omp_get_thread_num();
+#else
+        const unsigned int thread = 0;
+#endif /* _OPENMP */
+        tiles = &mTilesCache->tilesForThread(
+            thread, imageSize, tileSize, border, margin);
+      } else {
+        ownTiles.reset(new Tiles(imageSize, tileSize, border, margin));
+        tiles = ownTiles.get();
+      }
+
+      RGBImageTile& hImageTile(tiles->hImageTile);
+      RGBImageTile& vImageTile(tiles->vImageTile);
+      LABImageTile& hLabImageTile(tiles->hLabImageTile);
+      LABImageTile& vLabImageTile(tiles->vLabImageTile);
+      HomogeneityTile& homoTile(tiles->homoTile);
 
 #if _OPENMP
 #pragma omp for schedule(dynamic)
@@ -698,48 +805,405 @@ public:
         for (unsigned int col = left; col < right; col += tileWidth - 2*margin) {
           tileTopLeft.col = col;
 
-          hImageTile.setTopLeft(tileTopLeft);
-          vImageTile.setTopLeft(tileTopLeft);
-          hLabImageTile.setTopLeft(tileTopLeft);
-          vLabImageTile.setTopLeft(tileTopLeft);
-          homoTile.setTopLeft(tileTopLeft);
+          tiles->setTopLeft(tileTopLeft);
 
           createGreenDirectionalImages(image, hImageTile, vImageTile);
 
           fillDirectionalImage(image, hImageTile);
           fillDirectionalImage(image, vImageTile);
 
-          createCielabImage(hImageTile, hLabImageTile, cameraToXyz);
-          createCielabImage(vImageTile, vLabImageTile, cameraToXyz);
+          createCielabImage(hImageTile, hLabImageTile, cielab);
+          createCielabImage(vImageTile, vLabImageTile, cielab);
 
           fillHomogeneityMap(hLabImageTile, vLabImageTile, homoTile);
 
-          fillImage(rgbImage, hImageTile, vImageTile, homoTile);
+          fillImage(rgbImage, padding, hImageTile, vImageTile, homoTile);
         }
       }
     }
+  }
 
+public:
+  RGBImage* interpolate(const GrayImage& image) {
+    std::auto_ptr<RGBImage> rgbImagePtr(new RGBImage(
+          image.profile(), image.width(), image.height(),
+          ImageBuffer::UNINITIALIZED, mPool));
+    RGBImageView rgbView(*rgbImagePtr);
+    interpolateInto(image, rgbView);
+    return rgbImagePtr.release();
+  }
+
+  void interpolate(const GrayImage& image, RGBImageView rgbView) {
+    interpolateInto(image, rgbView);
+  }
+
+  PlanarRGBImage* interpolateToPlanar(const GrayImage& image) {
+    std::auto_ptr<PlanarRGBImage> rgbImagePtr(new PlanarRGBImage(
+          image.profile(), image.width(), image.height(),
+          ImageBuffer::UNINITIALIZED, mPool));
+    interpolateInto(image, *rgbImagePtr);
     return rgbImagePtr.release();
   }
 };
 
+class PPGInterpolator {
+  /*
+   * Rows per band: each thread estimates green a few rows ahead of the rows
+   * it fills in, so the rows it reads back are still in cache.
+   */
+  static const int BandHeight = 32;
+
+  const PPGKernels& mKernels;
+  ImagePool* mPool;
+
+  /*
+   * Estimates green at the red and blue pixels of one row, from the gray
+   * values up to 3 pixels away.
+   */
+  void createGreenRow(
+      const GrayImage& image, RGBImageView& rgbImage, int row)
+  {
+    const int left = 3;
+    const int right = image.width() - 3;
+    const int col = left + (image.colorAtPoint(row, left) & 1); // 1st R or B
+
+    mKernels.green(&image.constPixelsAtPoint(row, col)[0].value(),
+        image.width(), rgbImage.pixelsAtPoint(row, col)[0].array(),
+        image.colorAtPoint(row, col), everyOther(col, right));
+  }
+
+  /*
+   * Fills in the colors green left out in one row. This reads the green
+   * estimates of the rows above and below.
+   */
+  void fillRow(const GrayImage& image, RGBImageView& rgbImage, int row)
+  {
+    const int left = 1;
+    const int right = image.width() - 1;
+    const std::ptrdiff_t rgbRowLength = rgbImage.stride() * 3;
+
+    const BayerRow bayer(image, row, left);
+
+    mKernels.fillGreenPixels(
+        &image.constPixelsAtPoint(row, bayer.gCol)[0].value(),
+        rgbImage.pixelsAtPoint(row, bayer.gCol)[0].array(), rgbRowLength,
+        bayer.rowC, everyOther(bayer.gCol, right));
+
+    mKernels.fillRedBluePixels(
+        rgbImage.pixelsAtPoint(row, bayer.rbCol)[0].array(), rgbRowLength,
+        bayer.rowC, everyOther(bayer.rbCol, right));
+  }
+
+  void interpolateInto(const GrayImage& image, RGBImageView rgbImage) {
+    const int border = 3;
+    const int width = image.width();
+    const int height = image.height();
+
+    // Green estimates reach 3 pixels; the rest is filled in to 1 pixel
+    interpolateBorder(rgbImage, image, border);
+    if (width <= 2 * border || height <= 2 * border) return;
+
+    const int top = 1;
+    const int bottom = height - 1;
+
+#if _OPENMP
+#pragma omp parallel
+#endif /* _OPENMP */
+    {
+      // Each band's rows but its first and last only need its own green
+#if _OPENMP
+#pragma omp for schedule(dynamic)
+#endif /* _OPENMP */
+      for (int bandTop = top; bandTop < bottom; bandTop += BandHeight) {
+        const int bandBottom = std::min(bandTop + BandHeight, bottom);
+
+        for (int row = bandTop; row < bandBottom; row++) {
+          if (row >= border && row < height - border) {
+            createGreenRow(image, rgbImage, row);
+          }
+          if (row - 1 > bandTop) {
+            fillRow(image, rgbImage, row - 1);
+          }
+        }
+      }
+
+      // The first and last rows read their neighbor bands' green, too
+#if _OPENMP
+#pragma omp for
+#endif /* _OPENMP */
+      for (int bandTop = top; bandTop < bottom; bandTop += BandHeight) {
+        const int bandBottom = std::min(bandTop + BandHeight, bottom);
+
+        fillRow(image, rgbImage, bandTop);
+        if (bandBottom - 1 > bandTop) {
+          fillRow(image, rgbImage, bandBottom - 1);
+        }
+      }
+    }
+  }
+
+public:
+  PPGInterpolator(ImagePool* pool)
+    : mKernels(PPGKernels::active()), mPool(pool) {}
+
+  RGBImage* interpolate(const GrayImage& image) {
+    std::auto_ptr<RGBImage> rgbImagePtr(new RGBImage(
+          image.profile(), image.width(), image.height(),
+          ImageBuffer::UNINITIALIZED, mPool));
+    interpolateInto(image, RGBImageView(*rgbImagePtr));
+    return rgbImagePtr.release();
+  }
+
+  void interpolate(const GrayImage& image, const RGBImageView& rgbView) {
+    interpolateInto(image, rgbView);
+  }
+};
+
+class MHCInterpolator {
+  const MHCKernels& mKernels;
+  ImagePool* mPool;
+
+  void interpolateRow(const GrayImage& image, RGBImageView& rgbImage, int row)
+  {
+    const int left = 2;
+    const int right = image.width() - 2;
+
+    const BayerRow bayer(image, row, left);
+
+    mKernels.greenPixels(
+        &image.constPixelsAtPoint(row, bayer.gCol)[0].value(), image.width(),
+        rgbImage.pixelsAtPoint(row, bayer.gCol)[0].array(), bayer.rowC,
+        everyOther(bayer.gCol, right));
+
+    mKernels.redBluePixels(
+        &image.constPixelsAtPoint(row, bayer.rbCol)[0].value(), image.width(),
+        rgbImage.pixelsAtPoint(row, bayer.rbCol)[0].array(), bayer.rowC,
+        everyOther(bayer.rbCol, right));
+  }
+
+  void interpolateInto(const GrayImage& image, RGBImageView rgbImage) {
+    const int border = 2;
+    const int width = image.width();
+    const int height = image.height();
+
+    interpolateBorder(rgbImage, image, border);
+    if (width <= 2 * border || height <= 2 * border) return;
+
+    // Every row reads only gray values, so rows are independent
+#if _OPENMP
+#pragma omp parallel for schedule(static)
+#endif /* _OPENMP */
+    for (int row = border; row < height - border; row++) {
+      interpolateRow(image, rgbImage, row);
+    }
+  }
+
+public:
+  MHCInterpolator(ImagePool* pool)
+    : mKernels(MHCKernels::active()), mPool(pool) {}
+
+  RGBImage* interpolate(const GrayImage& image) {
+    std::auto_ptr<RGBImage> rgbImagePtr(new RGBImage(
+          image.profile(), image.width(), image.height(),
+          ImageBuffer::UNINITIALIZED, mPool));
+    interpolateInto(image, RGBImageView(*rgbImagePtr));
+    return rgbImagePtr.release();
+  }
+
+  void interpolate(const GrayImage& image, const RGBImageView& rgbView) {
+    interpolateInto(image, rgbView);
+  }
+};
+
+class Interpolator::Scratch {
+public:
+  AHDInterpolator::TilesCache ahdTiles;
+};
+
 Interpolator::Interpolator(const Interpolator::Type& type)
-  : mType(type)
+  : mType(type), mPool(0), mScratch(0), mTileHeight(0), mTileWidth(0),
+  mFixedPointLab(false), mPadsBorder(false)
 {
 }
 
+Interpolator::Interpolator(const Interpolator& rhs)
+  : mType(rhs.mType), mPool(rhs.mPool),
+  mScratch(rhs.mScratch ? new Scratch : 0),
+  mTileHeight(rhs.mTileHeight), mTileWidth(rhs.mTileWidth),
+  mFixedPointLab(rhs.mFixedPointLab), mPadsBorder(rhs.mPadsBorder)
+{
+}
+
+Interpolator& Interpolator::operator=(const Interpolator& rhs)
+{
+  mType = rhs.mType;
+  mPool = rhs.mPool;
+  mTileHeight = rhs.mTileHeight;
+  mTileWidth = rhs.mTileWidth;
+  mFixedPointLab = rhs.mFixedPointLab;
+  mPadsBorder = rhs.mPadsBorder;
+  setReusesScratch(rhs.reusesScratch());
+  return *this;
+}
+
+Interpolator::~Interpolator()
+{
+  delete mScratch;
+}
+
+void Interpolator::setReusesScratch(bool reuse)
+{
+  if (reuse && !mScratch) {
+    mScratch = new Scratch;
+  } else if (!reuse && mScratch) {
+    delete mScratch;
+    mScratch = 0;
+  }
+}
+
+void Interpolator::setTileSize(unsigned int height, unsigned int width)
+{
+  const unsigned int minSize = 2 * AHDInterpolator::Margin + 2;
+  if ((height || width) && (height < minSize || width < minSize)) {
+    throw std::invalid_argument(
+        "Interpolator tiles must be 0x0 or at least 8x8 pixels");
+  }
+
+  mTileHeight = height;
+  mTileWidth = width;
+}
+
 RGBImage* Interpolator::interpolate(const GrayImage& image)
 {
   switch (mType) {
     case INTERPOLATE_AHD:
       {
-        AHDInterpolator ahdInterpolator;
+        AHDInterpolator ahdInterpolator(
+            mPool, mScratch ? &mScratch->ahdTiles : 0,
+            TileSize(mTileHeight, mTileWidth), mFixedPointLab, mPadsBorder);
         return ahdInterpolator.interpolate(image);
       }
     case INTERPOLATE_BILINEAR:
       {
-        BilinearInterpolator bilinearInterpolator;
-        return bilinearInterpolator.interpolate(image);
+        BilinearInterpolator bilinearInterpolator(mPool, mPadsBorder);
+        return bilinearInterpolator.interpolate<RGBImage>(image);
+      }
+    case INTERPOLATE_PPG:
+      {
+        PPGInterpolator ppgInterpolator(mPool);
+        return ppgInterpolator.interpolate(image);
+      }
+    case INTERPOLATE_MHC:
+      {
+        MHCInterpolator mhcInterpolator(mPool);
+        return mhcInterpolator.interpolate(image);
+      }
+    default:
+      return 0;
+  }
+}
+
+void Interpolator::interpolate(const GrayImage& image, RGBImage& outImage)
+{
+  interpolate(image, RGBImageView(outImage));
+}
+
+void Interpolator::interpolate(
+    const GrayImage& image, const RGBImageView& outView)
+{
+  if (outView.width() != image.width() || outView.height() != image.height()) {
+    throw std::invalid_argument(
+        "Interpolator output must be the same size as the input image");
+  }
+
+  switch (mType) {
+    case INTERPOLATE_AHD:
+      {
+        AHDInterpolator ahdInterpolator(
+            mPool, mScratch ? &mScratch->ahdTiles : 0,
+            TileSize(mTileHeight, mTileWidth), mFixedPointLab, mPadsBorder);
+        ahdInterpolator.interpolate(image, outView);
+      }
+      break;
+    case INTERPOLATE_BILINEAR:
+      {
+        BilinearInterpolator bilinearInterpolator(mPool, mPadsBorder);
+        bilinearInterpolator.interpolateInto(image, outView);
+      }
+      break;
+    case INTERPOLATE_PPG:
+      {
+        PPGInterpolator ppgInterpolator(mPool);
+        ppgInterpolator.interpolate(image, outView);
+      }
+      break;
+    case INTERPOLATE_MHC:
+      {
+        MHCInterpolator mhcInterpolator(mPool);
+        mhcInterpolator.interpolate(image, outView);
+      }
+      break;
+  }
+}
+
+void Interpolator::interpolate(
+    const GrayImage& image, unsigned short* outValues)
+{
+  interpolate(image, RGBImageView(image.profile(),
+        reinterpret_cast<RGBImage::PixelType*>(outValues),
+        image.width(), image.height(), image.width()));
+}
+
+FloatRGBImage* Interpolator::interpolate(const FloatGrayImage& image)
+{
+  if (mType != INTERPOLATE_BILINEAR) {
+    throw std::invalid_argument(
+        "Only INTERPOLATE_BILINEAR can interpolate float images");
+  }
+
+  BilinearInterpolator bilinearInterpolator(mPool, mPadsBorder);
+  return bilinearInterpolator.interpolate<FloatRGBImage>(image);
+}
+
+void Interpolator::interpolate(
+    const FloatGrayImage& image, FloatRGBImage& outImage)
+{
+  if (mType != INTERPOLATE_BILINEAR) {
+    throw std::invalid_argument(
+        "Only INTERPOLATE_BILINEAR can interpolate float images");
+  }
+  if (outImage.width() != image.width()
+      || outImage.height() != image.height()) {
+    throw std::invalid_argument(
+        "Interpolator output must be the same size as the input image");
+  }
+
+  BilinearInterpolator bilinearInterpolator(mPool, mPadsBorder);
+  bilinearInterpolator.interpolateInto(
+      image, ImageView<FloatRGBImage::PixelType>(outImage));
+}
+
+PlanarRGBImage* Interpolator::interpolateToPlanar(const GrayImage& image)
+{
+  switch (mType) {
+    case INTERPOLATE_AHD:
+      {
+        AHDInterpolator ahdInterpolator(
+            mPool, mScratch ? &mScratch->ahdTiles : 0,
+            TileSize(mTileHeight, mTileWidth), mFixedPointLab, mPadsBorder);
+        return ahdInterpolator.interpolateToPlanar(image);
+      }
+    case INTERPOLATE_BILINEAR:
+    case INTERPOLATE_PPG:
+    case INTERPOLATE_MHC:
+      {
+        // These write pixels through an interleaved pointer walk
+        std::auto_ptr<RGBImage> rgbImage(interpolate(image));
+        std::auto_ptr<PlanarRGBImage> ret(new PlanarRGBImage(
+              image.profile(), image.width(), image.height(),
+              ImageBuffer::UNINITIALIZED, mPool));
+        deinterleave(*rgbImage, *ret);
+        return ret.release();
       }
     default:
       return 0;
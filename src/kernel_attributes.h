@@ -0,0 +1,40 @@
+#ifndef _REFINERY_KERNEL_ATTRIBUTES_H
+#define _REFINERY_KERNEL_ATTRIBUTES_H
+
+/*
+ * Function attributes for row kernels that are compiled once per
+ * instruction set, as in AHDKernels.
+ *
+ * A kernel body is an always-inline function; each instruction set gets a
+ * wrapper function, with REFINERY_KERNEL_SCALAR or
+ * REFINERY_KERNEL_SIMD("target"), which is where the compiler vectorizes
+ * the body. SIMD wrappers only exist when REFINERY_KERNEL_X86 is set.
+ *
+ * Every version must round floats the same way, so none may fuse a multiply
+ * and an add (AVX-512F implies FMA, and GCC fuses by default).
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define REFINERY_KERNEL_X86 1
+#endif
+
+#if defined(__GNUC__)
+#  define REFINERY_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#  define REFINERY_KERNEL_INLINE inline
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  define REFINERY_KERNEL_SCALAR \
+     __attribute__((optimize("no-tree-vectorize", "fp-contract=off")))
+#  define REFINERY_KERNEL_SIMD(Target) \
+     __attribute__((target(Target), optimize("fp-contract=off")))
+#else
+#  define REFINERY_KERNEL_SCALAR
+#  define REFINERY_KERNEL_SIMD(Target) __attribute__((target(Target)))
+#endif
+#if defined(__clang__)
+#  pragma STDC FP_CONTRACT OFF
+#endif
+
+#endif /* _REFINERY_KERNEL_ATTRIBUTES_H */
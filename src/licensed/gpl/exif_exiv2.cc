@@ -22,6 +22,12 @@
 
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include <boost/tr1/unordered_map.hpp>
 
 #include <exiv2/exif.hpp>
 #include <exiv2/tags.hpp>
@@ -29,76 +35,174 @@
 namespace refinery {
 
 class Exiv2ExifData::Impl {
+  /*
+   * One Exif datum, plus whatever conversions have been asked of it.
+   *
+   * Camera code tends to call hasKey() and then getInt() (or getString(),
+   * ...) with the same key, often once per image. Each conversion is done
+   * the first time and then reused.
+   */
+  struct Entry {
+    Exiv2::ExifData::const_iterator datum;
+
+    bool hasString;
+    bool stringOk;
+    std::string stringValue;
+
+    bool hasInt;
+    bool intOk;
+    int intValue;
+
+    bool hasFloat;
+    bool floatOk;
+    float floatValue;
+
+    bool hasBytes;
+    std::vector<byte> bytesValue;
+
+    Entry(const Exiv2::ExifData::const_iterator& datum)
+      : datum(datum), hasString(false), stringOk(false),
+        hasInt(false), intOk(false), intValue(0),
+        hasFloat(false), floatOk(false), floatValue(0.0f),
+        hasBytes(false) {}
+  };
+  typedef std::tr1::unordered_map<std::string, Entry> IndexType;
+
   Exiv2::ExifData& exiv2ExifData;
+  mutable IndexType mIndex; // keys are fixed at construction; values aren't
+  mutable pthread_mutex_t mMutex; // guards every Entry's cached conversions
+
+  class Lock {
+    pthread_mutex_t& mMutex;
+  public:
+    Lock(pthread_mutex_t& mutex) : mMutex(mutex) {
+      pthread_mutex_lock(&mMutex);
+    }
+    ~Lock() { pthread_mutex_unlock(&mMutex); }
+  };
+
+  /*
+   * Builds the key => value index, in one pass over the Exiv2 data.
+   *
+   * Without it, every lookup would parse the dotted key into an
+   * Exiv2::ExifKey and then findKey() would search linearly.
+   */
+  void buildIndex()
+  {
+    for (Exiv2::ExifData::const_iterator it(exiv2ExifData.begin());
+        it != exiv2ExifData.end(); ++it) {
+      // findKey() returns the first match, so don't overwrite
+      mIndex.insert(IndexType::value_type(it->key(), Entry(it)));
+    }
+  }
+
+  /*
+   * The entry for key, or 0.
+   *
+   * The index holds each datum's canonical key. Exiv2::ExifKey accepts
+   * other spellings, too, such as "Exif.Image.0x0110" for
+   * "Exif.Image.Model", so a miss falls back to it. Like findKey(), that
+   * throws on a key Exiv2 can't parse.
+   */
+  Entry* findEntry(const char* key) const
+  {
+    IndexType::iterator it(mIndex.find(key));
+    if (it == mIndex.end()) {
+      const std::string canonicalKey(Exiv2::ExifKey(key).key());
+      if (canonicalKey != key) it = mIndex.find(canonicalKey);
+    }
+    return it == mIndex.end() ? 0 : &it->second;
+  }
 
-  const Exiv2::Value& getValue(const char* key) const
+  Entry& getEntry(const char* key) const
   {
-    Exiv2::ExifKey exifKey(key);
-    Exiv2::ExifData::const_iterator it(exiv2ExifData.findKey(exifKey));
-    if (it == exiv2ExifData.end()) {
+    Entry* entry = findEntry(key);
+    if (!entry) {
       throw std::logic_error(std::string("Invalid Exif key `") + key + "'");
     }
 
-    return it->value();
+    return *entry;
+  }
+
+  void throwWrongType(
+      const char* typeName, const Exiv2::Value& value, const char* key) const
+  {
+    std::stringstream err;
+    err << "Exif value should be type " << typeName << ", but has type ID "
+        << value.typeId() << ": " << key;
+    throw std::logic_error(err.str());
   }
 
 public:
 
-  Impl(Exiv2::ExifData& exiv2ExifData) : exiv2ExifData(exiv2ExifData) {}
+  Impl(Exiv2::ExifData& exiv2ExifData) : exiv2ExifData(exiv2ExifData)
+  {
+    pthread_mutex_init(&mMutex, 0);
+    buildIndex();
+  }
 
-  bool hasKey(const char* key) const
+  ~Impl()
   {
-    Exiv2::ExifKey exifKey(key);
-    Exiv2::ExifData::const_iterator it(exiv2ExifData.findKey(exifKey));
+    pthread_mutex_destroy(&mMutex);
+  }
 
-    return it != exiv2ExifData.end();
+  bool hasKey(const char* key) const
+  {
+    return findEntry(key) != 0;
   }
 
   std::string getString(const char* key) const
   {
-    const Exiv2::Value& value(getValue(key));
-    std::string ret(value.toString());
-    if (!value.ok()) {
-      std::stringstream err;
-      err << "Exif value should be type string, but has type ID "
-          << value.typeId() << ": " << key;
-      throw std::logic_error(err.str());
+    Entry& entry(getEntry(key));
+    Lock lock(mMutex);
+    if (!entry.hasString) {
+      entry.stringValue = entry.datum->value().toString();
+      entry.stringOk = entry.datum->value().ok();
+      entry.hasString = true;
     }
-    return ret;
+    if (!entry.stringOk) throwWrongType("string", entry.datum->value(), key);
+    return entry.stringValue;
   }
 
   void getBytes(const char* key, std::vector<byte>& outBytes) const
   {
-    const Exiv2::Value& value(getValue(key));
-    long nBytes(value.size());
-    outBytes.assign(nBytes, 0);
-    value.copy(&outBytes[0], Exiv2::bigEndian);
+    Entry& entry(getEntry(key));
+    Lock lock(mMutex);
+    if (!entry.hasBytes) {
+      long nBytes(entry.datum->value().size());
+      entry.bytesValue.assign(nBytes, 0);
+      if (nBytes) {
+        entry.datum->value().copy(&entry.bytesValue[0], Exiv2::bigEndian);
+      }
+      entry.hasBytes = true;
+    }
+    outBytes = entry.bytesValue;
   }
 
   int getInt(const char* key) const
   {
-    const Exiv2::Value& value(getValue(key));
-    long ret = value.toLong();
-    if (!value.ok()) {
-      std::stringstream err;
-      err << "Exif value should be type long, but has type ID "
-        << value.typeId() << ": " << key;
-      throw std::logic_error(err.str());
+    Entry& entry(getEntry(key));
+    Lock lock(mMutex);
+    if (!entry.hasInt) {
+      entry.intValue = entry.datum->value().toLong();
+      entry.intOk = entry.datum->value().ok();
+      entry.hasInt = true;
     }
-    return ret;
+    if (!entry.intOk) throwWrongType("long", entry.datum->value(), key);
+    return entry.intValue;
   }
 
   float getFloat(const char* key) const
   {
-    const Exiv2::Value& value(getValue(key));
-    float ret = value.toFloat();
-    if (!value.ok()) {
-      std::stringstream err;
-      err << "Exif value should be type float, but has type ID "
-        << value.typeId() << ": " << key;
-      throw std::logic_error(err.str());
+    Entry& entry(getEntry(key));
+    Lock lock(mMutex);
+    if (!entry.hasFloat) {
+      entry.floatValue = entry.datum->value().toFloat();
+      entry.floatOk = entry.datum->value().ok();
+      entry.hasFloat = true;
     }
-    return ret;
+    if (!entry.floatOk) throwWrongType("float", entry.datum->value(), key);
+    return entry.floatValue;
   }
 };
 
@@ -0,0 +1,85 @@
+#include "refinery/memory_stats.h"
+
+namespace refinery {
+
+namespace {
+  // One slot per category, then the total
+  const int TotalSlot = MemoryStats::NCategories;
+
+  std::size_t currentBytes[MemoryStats::NCategories + 1];
+  std::size_t peakBytes[MemoryStats::NCategories + 1];
+
+  void raisePeak(int slot, std::size_t bytes)
+  {
+    std::size_t peak = peakBytes[slot];
+    while (bytes > peak) {
+      const std::size_t old(
+          __sync_val_compare_and_swap(&peakBytes[slot], peak, bytes));
+      if (old == peak) break;
+      peak = old;
+    }
+  }
+
+  void add(int slot, std::size_t bytes)
+  {
+    raisePeak(slot, __sync_add_and_fetch(&currentBytes[slot], bytes));
+  }
+
+  void subtract(int slot, std::size_t bytes)
+  {
+    __sync_sub_and_fetch(&currentBytes[slot], bytes);
+  }
+
+  MemoryStats::Usage usage(int slot)
+  {
+    MemoryStats::Usage ret;
+    ret.current = currentBytes[slot];
+    ret.peak = peakBytes[slot];
+    return ret;
+  }
+} // namespace {}
+
+MemoryStats MemoryStats::snapshot()
+{
+  __sync_synchronize();
+
+  MemoryStats ret;
+  ret.total = usage(TotalSlot);
+  for (int i = 0; i < NCategories; i++) {
+    ret.categories[i] = usage(i);
+  }
+  return ret;
+}
+
+void MemoryStats::resetPeaks()
+{
+  for (int i = 0; i <= TotalSlot; i++) {
+    __sync_lock_test_and_set(&peakBytes[i], currentBytes[i]);
+  }
+  __sync_synchronize();
+}
+
+const char* MemoryStats::categoryName(Category category)
+{
+  switch (category) {
+    case IMAGES: return "images";
+    case TILES: return "tiles";
+    case DECODERS: return "decoders";
+    case CACHES: return "caches";
+    default: return "unknown";
+  }
+}
+
+void MemoryStats::allocated(Category category, std::size_t bytes)
+{
+  add(category, bytes);
+  add(TotalSlot, bytes);
+}
+
+void MemoryStats::freed(Category category, std::size_t bytes)
+{
+  subtract(category, bytes);
+  subtract(TotalSlot, bytes);
+}
+
+} // namespace refinery
@@ -0,0 +1,148 @@
+#include "mhc_kernels.h"
+
+#include <cassert>
+
+#include "kernel_attributes.h"
+
+namespace refinery {
+
+namespace {
+  /*
+   * The kernel bodies, as in ahd_kernels.cc. The coefficients are Malvar,
+   * He and Cutler's, times 16 (theirs are eighths, some halved).
+   */
+
+  REFINERY_KERNEL_INLINE unsigned short clip16(int val)
+  {
+    return val < 0 ? 0 : val > 0xffff ? 0xffff : val;
+  }
+
+  /*
+   * Rounds a sum of values times 16.
+   */
+  REFINERY_KERNEL_INLINE unsigned short scale(int sum)
+  {
+    return clip16((sum + 8) >> 4);
+  }
+
+  template<int OwnC>
+  REFINERY_KERNEL_INLINE void redBluePixelsRow(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, int n)
+  {
+    const int OtherC = 2 - OwnC;
+
+    const unsigned short* above(gray - rowLength);
+    const unsigned short* above2(gray - 2 * rowLength);
+    const unsigned short* below(gray + rowLength);
+    const unsigned short* below2(gray + 2 * rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+      const int c = gray[x];
+      const int far = // own color, 2 pixels away
+        above2[x] + below2[x] + gray[x - 2] + gray[x + 2];
+
+      rgb[d + OwnC] = c;
+
+      rgb[d + 1] = scale(8 * c - 2 * far
+          + 4 * (above[x] + below[x] + gray[x - 1] + gray[x + 1])); // G
+
+      rgb[d + OtherC] = scale(12 * c - 3 * far
+          + 4 * (above[x - 1] + above[x + 1] // otherC
+            + below[x - 1] + below[x + 1])); // otherC
+    }
+  }
+
+  template<int RowC>
+  REFINERY_KERNEL_INLINE void greenPixelsRow(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, int n)
+  {
+    const int ColC = 2 - RowC;
+
+    const unsigned short* above(gray - rowLength);
+    const unsigned short* above2(gray - 2 * rowLength);
+    const unsigned short* below(gray + rowLength);
+    const unsigned short* below2(gray + 2 * rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+      const int g = gray[x];
+      const int diagonals = // G
+        above[x - 1] + above[x + 1] + below[x - 1] + below[x + 1];
+      const int hFar = gray[x - 2] + gray[x + 2]; // G, G
+      const int vFar = above2[x] + below2[x]; // G, G
+
+      rgb[d + 1] = g;
+
+      rgb[d + RowC] = scale(10 * g - 2 * diagonals - 2 * hFar + vFar
+          + 8 * (gray[x - 1] + gray[x + 1])); // rowC, rowC
+
+      rgb[d + ColC] = scale(10 * g - 2 * diagonals - 2 * vFar + hFar
+          + 8 * (above[x] + below[x])); // colC, colC
+    }
+  }
+} // namespace {}
+
+/*
+ * Defines one instruction set's kernels, as in ahd_kernels.cc.
+ */
+#define REFINERY_MHC_KERNELS(Name, Attributes) \
+  namespace { \
+    Attributes void redBluePixels##Name( \
+        const unsigned short* gray, std::ptrdiff_t rowLength, \
+        unsigned short* rgb, unsigned int ownC, int n) \
+    { \
+      if (ownC == 0) { \
+        redBluePixelsRow<0>(gray, rowLength, rgb, n); \
+      } else { \
+        redBluePixelsRow<2>(gray, rowLength, rgb, n); \
+      } \
+    } \
+    Attributes void greenPixels##Name( \
+        const unsigned short* gray, std::ptrdiff_t rowLength, \
+        unsigned short* rgb, unsigned int rowC, int n) \
+    { \
+      if (rowC == 0) { \
+        greenPixelsRow<0>(gray, rowLength, rgb, n); \
+      } else { \
+        greenPixelsRow<2>(gray, rowLength, rgb, n); \
+      } \
+    } \
+    const MHCKernels kernels##Name = { \
+      &redBluePixels##Name, &greenPixels##Name \
+    }; \
+  }
+
+REFINERY_MHC_KERNELS(Scalar, REFINERY_KERNEL_SCALAR)
+#if REFINERY_KERNEL_X86
+REFINERY_MHC_KERNELS(Sse41, REFINERY_KERNEL_SIMD("sse4.1"))
+REFINERY_MHC_KERNELS(Avx2, REFINERY_KERNEL_SIMD("avx2"))
+REFINERY_MHC_KERNELS(Avx512, REFINERY_KERNEL_SIMD("avx512f,avx512bw"))
+#endif /* REFINERY_KERNEL_X86 */
+
+#undef REFINERY_MHC_KERNELS
+
+const MHCKernels& MHCKernels::forInstructionSet(InstructionSet set)
+{
+  assert(AHDKernels::supported(set));
+
+  switch (set) {
+#if REFINERY_KERNEL_X86
+    case AHDKernels::SSE4_1: return kernelsSse41;
+    case AHDKernels::AVX2: return kernelsAvx2;
+    case AHDKernels::AVX512: return kernelsAvx512;
+#endif /* REFINERY_KERNEL_X86 */
+    default: return kernelsScalar;
+  }
+}
+
+const MHCKernels& MHCKernels::active()
+{
+  return forInstructionSet(AHDKernels::activeInstructionSet());
+}
+
+} // namespace refinery
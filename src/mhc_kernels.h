@@ -0,0 +1,65 @@
+#ifndef _REFINERY_MHC_KERNELS_H
+#define _REFINERY_MHC_KERNELS_H
+
+#include <cstddef>
+
+#include "ahd_kernels.h"
+
+namespace refinery {
+
+/**
+ * The inner loops of Malvar-He-Cutler interpolation, one row at a time.
+ *
+ * Each missing color is a fixed 5x5 sum of gray values: a bilinear average,
+ * corrected by the local gradient (Laplacian) of the pixel's own color.
+ * With the coefficients doubled, they're small integers, and each output
+ * value is <tt>(sum + 8) >> 4</tt>, clipped.
+ *
+ * The kernels are compiled per instruction set as AHDKernels describes.
+ * Pixels are interleaved, as in an RGBImage, and each kernel works on every
+ * second pixel of a row. Every kernel reads the gray rows 2 above and 2
+ * below, and 2 columns on each side.
+ */
+struct MHCKernels {
+  typedef AHDKernels::InstructionSet InstructionSet;
+
+  /**
+   * Interpolates every second pixel of a row of red or blue pixels.
+   *
+   * \param[in] gray First red or blue gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[out] rgb First RGB pixel.
+   * \param[in] ownC The pixels' own color (0 or 2).
+   * \param[in] n Number of pixels.
+   */
+  void (*redBluePixels)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, unsigned int ownC, int n);
+
+  /**
+   * Interpolates every second pixel of a row of green pixels.
+   *
+   * \param[in] gray First green gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[out] rgb First RGB pixel.
+   * \param[in] rowC Color (0 or 2) of the row's other pixels.
+   * \param[in] n Number of pixels.
+   */
+  void (*greenPixels)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, unsigned int rowC, int n);
+
+  /**
+   * The kernels for \p set, which must be AHDKernels::supported().
+   */
+  static const MHCKernels& forInstructionSet(InstructionSet set);
+
+  /**
+   * The kernels for AHDKernels::active()'s instruction set.
+   */
+  static const MHCKernels& active();
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_MHC_KERNELS_H */
@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include "refinery/image.h"
+#include "refinery/image_view.h"
 
 namespace refinery {
 
@@ -28,25 +29,29 @@ class PpmImageWriter {
     mOutputStream.sputc(rgb.b() & 0xff);
   }
 
-  void writeImageBytes8Bit(const RGBImage& image)
+  void writeImageBytes8Bit(const ConstRGBImageView& image)
   {
-    const RGBImage::PixelType* pixel(image.constPixels());
-    const RGBImage::PixelType* endPixel(image.constPixelsEnd());
-
-    while (pixel < endPixel) {
-      writePixel8Bit(*pixel);
-      pixel++;
+    for (unsigned int row = 0; row < image.height(); row++) {
+      const RGBImage::PixelType* pixel(image.constPixelsAtRow(row));
+      const RGBImage::PixelType* endPixel(pixel + image.width());
+
+      while (pixel < endPixel) {
+        writePixel8Bit(*pixel);
+        pixel++;
+      }
     }
   }
 
-  void writeImageBytes16Bit(const RGBImage& image)
+  void writeImageBytes16Bit(const ConstRGBImageView& image)
   {
-    const RGBImage::PixelType* pixel(image.constPixels());
-    const RGBImage::PixelType* endPixel(image.constPixelsEnd());
-
-    while (pixel < endPixel) {
-      writePixel16Bit(*pixel);
-      pixel++;
+    for (unsigned int row = 0; row < image.height(); row++) {
+      const RGBImage::PixelType* pixel(image.constPixelsAtRow(row));
+      const RGBImage::PixelType* endPixel(pixel + image.width());
+
+      while (pixel < endPixel) {
+        writePixel16Bit(*pixel);
+        pixel++;
+      }
     }
   }
 
@@ -54,7 +59,7 @@ public:
   PpmImageWriter(std::ostream& output)
     : mOutput(output), mOutputStream(*(output.rdbuf())) {}
 
-  void writeImage(const RGBImage& image, unsigned int colorDepth)
+  void writeImage(const ConstRGBImageView& image, unsigned int colorDepth)
   {
     mOutput << "P6\n";
     mOutput << image.width() << " " << image.height() << "\n";
@@ -73,16 +78,30 @@ public:
 void ImageWriter::writeImage(
     const RGBImage& image, std::ostream& ostream, unsigned int colorDepth)
 {
-  PpmImageWriter(ostream).writeImage(image, colorDepth);
+  writeImage(ConstRGBImageView(image), ostream, colorDepth);
 }
 
 void ImageWriter::writeImage(
     const RGBImage& image, const char* filename, unsigned int colorDepth)
+{
+  writeImage(ConstRGBImageView(image), filename, colorDepth);
+}
+
+void ImageWriter::writeImage(
+    const ConstRGBImageView& view, std::ostream& ostream,
+    unsigned int colorDepth)
+{
+  PpmImageWriter(ostream).writeImage(view, colorDepth);
+}
+
+void ImageWriter::writeImage(
+    const ConstRGBImageView& view, const char* filename,
+    unsigned int colorDepth)
 {
   std::ofstream out(
       filename,
       std::ios::out | std::ios::binary | std::ios::trunc);
-  writeImage(image, out, colorDepth);
+  writeImage(view, out, colorDepth);
 }
 
 } // namespace refinery
@@ -0,0 +1,207 @@
+#include "ppg_kernels.h"
+
+#include <cassert>
+#include <cstdlib>
+
+#include "kernel_attributes.h"
+
+namespace refinery {
+
+namespace {
+  /*
+   * The kernel bodies, as in ahd_kernels.cc. They follow dcraw's
+   * ppg_interpolate(), in its order of operations.
+   */
+
+  REFINERY_KERNEL_INLINE int absDiff(int a, int b)
+  {
+    return a > b ? a - b : b - a;
+  }
+
+  REFINERY_KERNEL_INLINE unsigned short clip16(int val)
+  {
+    return val < 0 ? 0 : val > 0xffff ? 0xffff : val;
+  }
+
+  /*
+   * Limits val to the range between bound1 and bound2, in either order.
+   */
+  REFINERY_KERNEL_INLINE unsigned short bound(int val, int bound1, int bound2)
+  {
+    const int lo = bound1 < bound2 ? bound1 : bound2;
+    const int hi = bound1 < bound2 ? bound2 : bound1;
+    return val < lo ? lo : val > hi ? hi : val;
+  }
+
+  template<int OwnC>
+  REFINERY_KERNEL_INLINE void greenRow(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, int n)
+  {
+    const unsigned short* above(gray - rowLength);
+    const unsigned short* above2(gray - 2 * rowLength);
+    const unsigned short* above3(gray - 3 * rowLength);
+    const unsigned short* below(gray + rowLength);
+    const unsigned short* below2(gray + 2 * rowLength);
+    const unsigned short* below3(gray + 3 * rowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+      const int c = gray[x];
+
+      const int hGuess =
+        (gray[x - 1] + c + gray[x + 1]) * 2 // G, c, G
+        - gray[x - 2] - gray[x + 2]; // c, c
+      const int hDiff =
+        (absDiff(gray[x - 2], c) + absDiff(gray[x + 2], c)
+         + absDiff(gray[x - 1], gray[x + 1])) * 3
+        + (absDiff(gray[x + 3], gray[x + 1])
+           + absDiff(gray[x - 3], gray[x - 1])) * 2;
+
+      const int vGuess =
+        (above[x] + c + below[x]) * 2 // G, c, G
+        - above2[x] - below2[x]; // c, c
+      const int vDiff =
+        (absDiff(above2[x], c) + absDiff(below2[x], c)
+         + absDiff(above[x], below[x])) * 3
+        + (absDiff(below3[x], below[x])
+           + absDiff(above3[x], above[x])) * 2;
+
+      rgb[d + 1] = hDiff > vDiff
+        ? bound(vGuess >> 2, below[x], above[x])
+        : bound(hGuess >> 2, gray[x + 1], gray[x - 1]);
+      rgb[d + OwnC] = c;
+    }
+  }
+
+  template<int RowC>
+  REFINERY_KERNEL_INLINE void greenPixelsRow(
+      const unsigned short* gray, unsigned short* rgb,
+      std::ptrdiff_t rgbRowLength, int n)
+  {
+    const int ColC = 2 - RowC;
+
+    const unsigned short* rgbAbove(rgb - rgbRowLength);
+    const unsigned short* rgbBelow(rgb + rgbRowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int x = 2 * i;
+      const int d = 6 * i;
+      const int g = gray[x];
+
+      rgb[d + 1] = g;
+
+      rgb[d + RowC] = clip16(
+          (rgb[d - 3 + RowC] + rgb[d + 3 + RowC] + 2 * g // rowC, rowC, G
+           - rgb[d - 3 + 1] - rgb[d + 3 + 1]) >> 1); // G, G
+
+      rgb[d + ColC] = clip16(
+          (rgbAbove[d + ColC] + rgbBelow[d + ColC] + 2 * g // colC, colC, G
+           - rgbAbove[d + 1] - rgbBelow[d + 1]) >> 1); // G, G
+    }
+  }
+
+  template<int OwnC>
+  REFINERY_KERNEL_INLINE void redBluePixelsRow(
+      unsigned short* rgb, std::ptrdiff_t rgbRowLength, int n)
+  {
+    const int C = 2 - OwnC;
+
+    const unsigned short* rgbAbove(rgb - rgbRowLength);
+    const unsigned short* rgbBelow(rgb + rgbRowLength);
+
+    for (int i = 0; i < n; i++) {
+      const int d = 6 * i;
+      const int g = rgb[d + 1];
+
+      // Down-right diagonal, then down-left
+      const unsigned short* a0(&rgbAbove[d - 3]);
+      const unsigned short* b0(&rgbBelow[d + 3]);
+      const unsigned short* a1(&rgbAbove[d + 3]);
+      const unsigned short* b1(&rgbBelow[d - 3]);
+
+      const int diff0 = absDiff(a0[C], b0[C])
+        + absDiff(a0[1], g) + absDiff(b0[1], g);
+      const int guess0 = a0[C] + b0[C] + 2 * g - a0[1] - b0[1];
+
+      const int diff1 = absDiff(a1[C], b1[C])
+        + absDiff(a1[1], g) + absDiff(b1[1], g);
+      const int guess1 = a1[C] + b1[C] + 2 * g - a1[1] - b1[1];
+
+      rgb[d + C] = diff0 > diff1 ? clip16(guess1 >> 1)
+        : diff0 < diff1 ? clip16(guess0 >> 1)
+        : clip16((guess0 + guess1) >> 2);
+    }
+  }
+} // namespace {}
+
+/*
+ * Defines one instruction set's kernels, as in ahd_kernels.cc.
+ */
+#define REFINERY_PPG_KERNELS(Name, Attributes) \
+  namespace { \
+    Attributes void green##Name( \
+        const unsigned short* gray, std::ptrdiff_t rowLength, \
+        unsigned short* rgb, unsigned int ownC, int n) \
+    { \
+      if (ownC == 0) { \
+        greenRow<0>(gray, rowLength, rgb, n); \
+      } else { \
+        greenRow<2>(gray, rowLength, rgb, n); \
+      } \
+    } \
+    Attributes void fillGreenPixels##Name( \
+        const unsigned short* gray, unsigned short* rgb, \
+        std::ptrdiff_t rgbRowLength, unsigned int rowC, int n) \
+    { \
+      if (rowC == 0) { \
+        greenPixelsRow<0>(gray, rgb, rgbRowLength, n); \
+      } else { \
+        greenPixelsRow<2>(gray, rgb, rgbRowLength, n); \
+      } \
+    } \
+    Attributes void fillRedBluePixels##Name( \
+        unsigned short* rgb, std::ptrdiff_t rgbRowLength, unsigned int ownC, \
+        int n) \
+    { \
+      if (ownC == 0) { \
+        redBluePixelsRow<0>(rgb, rgbRowLength, n); \
+      } else { \
+        redBluePixelsRow<2>(rgb, rgbRowLength, n); \
+      } \
+    } \
+    const PPGKernels kernels##Name = { \
+      &green##Name, &fillGreenPixels##Name, &fillRedBluePixels##Name \
+    }; \
+  }
+
+REFINERY_PPG_KERNELS(Scalar, REFINERY_KERNEL_SCALAR)
+#if REFINERY_KERNEL_X86
+REFINERY_PPG_KERNELS(Sse41, REFINERY_KERNEL_SIMD("sse4.1"))
+REFINERY_PPG_KERNELS(Avx2, REFINERY_KERNEL_SIMD("avx2"))
+REFINERY_PPG_KERNELS(Avx512, REFINERY_KERNEL_SIMD("avx512f,avx512bw"))
+#endif /* REFINERY_KERNEL_X86 */
+
+#undef REFINERY_PPG_KERNELS
+
+const PPGKernels& PPGKernels::forInstructionSet(InstructionSet set)
+{
+  assert(AHDKernels::supported(set));
+
+  switch (set) {
+#if REFINERY_KERNEL_X86
+    case AHDKernels::SSE4_1: return kernelsSse41;
+    case AHDKernels::AVX2: return kernelsAvx2;
+    case AHDKernels::AVX512: return kernelsAvx512;
+#endif /* REFINERY_KERNEL_X86 */
+    default: return kernelsScalar;
+  }
+}
+
+const PPGKernels& PPGKernels::active()
+{
+  return forInstructionSet(AHDKernels::activeInstructionSet());
+}
+
+} // namespace refinery
@@ -0,0 +1,78 @@
+#ifndef _REFINERY_PPG_KERNELS_H
+#define _REFINERY_PPG_KERNELS_H
+
+#include <cstddef>
+
+#include "ahd_kernels.h"
+
+namespace refinery {
+
+/**
+ * The inner loops of PPG (Patterned Pixel Grouping) interpolation, one row
+ * at a time.
+ *
+ * The kernels are compiled per instruction set as AHDKernels describes.
+ * Pixels are interleaved, as in an RGBImage, and each kernel works on every
+ * second pixel of a row.
+ */
+struct PPGKernels {
+  typedef AHDKernels::InstructionSet InstructionSet;
+
+  /**
+   * Estimates green at every second pixel of a row of red or blue pixels.
+   *
+   * Each pixel gets its horizontal or its vertical estimate, whichever
+   * direction has the smaller gradients over three pixels each way. Its own
+   * color is copied, too.
+   *
+   * \param[in] gray First red or blue gray value.
+   * \param[in] rowLength Values per gray row.
+   * \param[out] rgb First RGB pixel.
+   * \param[in] ownC The pixels' own color (0 or 2).
+   * \param[in] n Number of pixels to estimate.
+   */
+  void (*green)(
+      const unsigned short* gray, std::ptrdiff_t rowLength,
+      unsigned short* rgb, unsigned int ownC, int n);
+
+  /**
+   * Fills in red and blue at every second pixel of a row of green pixels.
+   *
+   * \param[in] gray First green gray value.
+   * \param[in,out] rgb First RGB pixel; its neighbors' values are read.
+   * \param[in] rgbRowLength Values per RGB row.
+   * \param[in] rowC Color (0 or 2) of the row's other pixels.
+   * \param[in] n Number of pixels to fill.
+   */
+  void (*fillGreenPixels)(
+      const unsigned short* gray, unsigned short* rgb,
+      std::ptrdiff_t rgbRowLength, unsigned int rowC, int n);
+
+  /**
+   * Fills in the missing color at every second pixel of a row of red or
+   * blue pixels, from the diagonal with the smaller gradient.
+   *
+   * \param[in,out] rgb First RGB pixel, whose green is set; its diagonal
+   *                    neighbors' values are read.
+   * \param[in] rgbRowLength Values per RGB row.
+   * \param[in] ownC The pixels' own color (0 or 2).
+   * \param[in] n Number of pixels to fill.
+   */
+  void (*fillRedBluePixels)(
+      unsigned short* rgb, std::ptrdiff_t rgbRowLength, unsigned int ownC,
+      int n);
+
+  /**
+   * The kernels for \p set, which must be AHDKernels::supported().
+   */
+  static const PPGKernels& forInstructionSet(InstructionSet set);
+
+  /**
+   * The kernels for AHDKernels::active()'s instruction set.
+   */
+  static const PPGKernels& active();
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_PPG_KERNELS_H */
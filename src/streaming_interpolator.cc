@@ -0,0 +1,330 @@
+#include "refinery/streaming_interpolator.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "refinery/camera.h"
+#include "refinery/memory_stats.h"
+
+#include "ahd_kernels.h"
+#include "cielab_converter.h"
+#include "filter_pattern.h"
+
+namespace refinery {
+
+namespace {
+  /*
+   * The last few rows of one AHD stage, contiguous in memory.
+   *
+   * The kernels read the rows above and below through a fixed row length,
+   * so a plain ring buffer, which wraps around, won't do. Instead the window
+   * has room for twice the rows it must keep; when it's full, it moves the
+   * newest rows back to the start. That copies about one row per row
+   * appended.
+   */
+  template<typename T>
+  class RowWindow {
+    std::vector<T> mValues;
+    std::size_t mRowLength;
+    int mKeepRows;
+    int mFirstRow; // image row at the start of mValues
+    int mEndRow; // one past the last image row appended
+
+  public:
+    RowWindow(std::size_t rowLength, int keepRows, int firstRow)
+      : mValues(rowLength * keepRows * 2), mRowLength(rowLength),
+      mKeepRows(keepRows), mFirstRow(firstRow), mEndRow(firstRow)
+    {
+    }
+
+    std::size_t bytes() const { return mValues.size() * sizeof(T); }
+
+    /*
+     * The given image row, which must be one of the last keepRows appended.
+     */
+    T* row(int imageRow)
+    {
+      return &mValues[(imageRow - mFirstRow) * mRowLength];
+    }
+
+    /*
+     * Makes room for the next image row and returns it.
+     */
+    T* appendRow()
+    {
+      if (mEndRow - mFirstRow == 2 * mKeepRows) {
+        std::memmove(&mValues[0], row(mEndRow - mKeepRows),
+            mKeepRows * mRowLength * sizeof(T));
+        mFirstRow = mEndRow - mKeepRows;
+      }
+      return row(mEndRow++);
+    }
+  };
+} // namespace {}
+
+class StreamingInterpolator::Impl {
+  /*
+   * The border AHD leaves to a plain 3x3 average, as in Interpolator.
+   */
+  static const int Border = 5;
+
+  /*
+   * Rows between a gray row being pushed and its RGB row being ready.
+   */
+  static const int Lag = 5;
+
+  const AHDKernels& mKernels;
+  const CielabConverter mCielab;
+  const unsigned int mFilters;
+  const int mWidth;
+  const int mHeight;
+  int mRowsPushed;
+  int mRowsPopped;
+
+  /*
+   * Each stage's rows, in image coordinates. Pushing row n computes green
+   * for row n-2, directional RGB and LAB for n-3 and homogeneity for n-4;
+   * row n-5 can then be popped. Each window keeps the rows later stages
+   * still read, counting from just before the next push.
+   */
+  RowWindow<unsigned short> mGray; // n-5 to n
+  RowWindow<unsigned short> mHRgb; // n-4 to n-2
+  RowWindow<unsigned short> mVRgb;
+  RowWindow<short> mHLab; // n-3 to n-2
+  RowWindow<short> mVLab;
+  RowWindow<char> mHomogeneity; // n-4 to n-3: h, v and diff per pixel
+  MemoryStats::Counter mMemory;
+
+  typedef unsigned int Color;
+
+  Color colorAtPoint(int row, int col) const
+  {
+    return (mFilters >> (((row << 1 & 14) | (col & 1)) << 1)) & 3;
+  }
+
+  bool hasInterior() const
+  {
+    return mWidth > 2 * Border && mHeight > 2 * Border;
+  }
+
+  void createGreenRow(int row)
+  {
+    const int left = 2;
+    const int right = mWidth - 2;
+    const int col = left + (colorAtPoint(row, left) & 1); // 1st R or B
+
+    unsigned short* hRgb(mHRgb.appendRow());
+    unsigned short* vRgb(mVRgb.appendRow());
+
+    mKernels.green(&mGray.row(row)[col], mWidth,
+        &hRgb[3 * col + 1], &vRgb[3 * col + 1], everyOther(col, right));
+  }
+
+  void fillDirectionalRow(int row, unsigned short* rgb)
+  {
+    const int left = 3;
+    const int right = mWidth - 3;
+
+    const BayerRow bayer(FilterPattern(mFilters), row, left);
+    const unsigned short* gray(mGray.row(row));
+
+    mKernels.fillGreenPixels(&gray[bayer.gCol], mWidth,
+        &rgb[3 * bayer.gCol], 3 * mWidth, bayer.rowC,
+        everyOther(bayer.gCol, right));
+
+    mKernels.fillRedBluePixels(&gray[bayer.rbCol], mWidth,
+        &rgb[3 * bayer.rbCol], 3 * mWidth, bayer.rowC,
+        everyOther(bayer.rbCol, right));
+  }
+
+  void createCielabRows(int row)
+  {
+    const int left = 3;
+    const int n = mWidth - 6;
+
+    mCielab.convertRow(&mHRgb.row(row)[3 * left],
+        &mHLab.appendRow()[3 * left], n);
+    mCielab.convertRow(&mVRgb.row(row)[3 * left],
+        &mVLab.appendRow()[3 * left], n);
+  }
+
+  void createHomogeneityRow(int row)
+  {
+    const int left = 4;
+
+    mKernels.homogeneity(&mHLab.row(row)[3 * left],
+        &mVLab.row(row)[3 * left], 3 * mWidth,
+        &mHomogeneity.appendRow()[3 * left], mWidth - 8);
+  }
+
+  /*
+   * Averages each missing color over the 3x3 neighborhood, like
+   * Interpolator's interpolateBorder().
+   */
+  void interpolateBorder(int row, int left, int right, unsigned short* out)
+  {
+    const int top = row > 0 ? row - 1 : 0;
+    const int bottom = row + 1 < mHeight ? row + 1 : mHeight - 1;
+
+    for (int col = left; col < right; col++) {
+      unsigned int sum[3] = { 0, 0, 0 };
+      unsigned int count[3] = { 0, 0, 0 };
+
+      for (int y = top; y <= bottom; y++) {
+        const unsigned short* gray(mGray.row(y));
+
+        for (int x = col - 1; x <= col + 1; x++) {
+          if (x < 0 || x >= mWidth) continue;
+
+          const Color c = colorAtPoint(y, x);
+          sum[c] += gray[x];
+          count[c]++;
+        }
+      }
+
+      const Color curC = colorAtPoint(row, col);
+      for (Color c = 0; c < 3; c++) {
+        if (c == curC) {
+          out[3 * col + c] = mGray.row(row)[col];
+        } else if (count[c]) {
+          out[3 * col + c] = sum[c] / count[c];
+        } else {
+          out[3 * col + c] = 0; // a 1-pixel line can lack a color entirely
+        }
+      }
+    }
+  }
+
+public:
+  Impl(const CameraProfile& profile, unsigned int width, unsigned int height,
+      bool fixedPointLab)
+    : mKernels(AHDKernels::active()),
+    mCielab(mKernels, profile, fixedPointLab),
+    mFilters(profile.filters()), mWidth(width), mHeight(height),
+    mRowsPushed(0), mRowsPopped(0),
+    mGray(width, 6, 0),
+    mHRgb(3 * width, 3, 2), mVRgb(3 * width, 3, 2),
+    mHLab(3 * width, 2, 3), mVLab(3 * width, 2, 3),
+    mHomogeneity(3 * width, 2, 4),
+    mMemory(MemoryStats::TILES)
+  {
+    mMemory.resize(mGray.bytes() + mHRgb.bytes() + mVRgb.bytes()
+        + mHLab.bytes() + mVLab.bytes() + mHomogeneity.bytes());
+  }
+
+  unsigned int width() const { return mWidth; }
+  unsigned int height() const { return mHeight; }
+  unsigned int rowsPushed() const { return mRowsPushed; }
+  unsigned int rowsPopped() const { return mRowsPopped; }
+
+  int rowsReady() const
+  {
+    if (mRowsPushed == mHeight) return mHeight;
+    return mRowsPushed > Lag ? mRowsPushed - Lag : 0;
+  }
+
+  void pushRow(const unsigned short* grayRow)
+  {
+    if (mRowsPushed == mHeight) {
+      throw std::logic_error(
+          "StreamingInterpolator was pushed more rows than its height");
+    }
+    if (mRowsPopped < rowsReady()) {
+      throw std::logic_error(
+          "StreamingInterpolator rows must be popped before the next push");
+    }
+
+    const int n = mRowsPushed++;
+    std::memcpy(mGray.appendRow(), grayRow, mWidth * sizeof(grayRow[0]));
+
+    if (!hasInterior()) return;
+
+    const int greenRow = n - 2;
+    if (greenRow >= 2 && greenRow < mHeight - 2) {
+      createGreenRow(greenRow);
+    }
+
+    const int dirRow = n - 3;
+    if (dirRow >= 3 && dirRow < mHeight - 3) {
+      fillDirectionalRow(dirRow, mHRgb.row(dirRow));
+      fillDirectionalRow(dirRow, mVRgb.row(dirRow));
+      createCielabRows(dirRow);
+    }
+
+    const int homogeneityRow = n - 4;
+    if (homogeneityRow >= 4 && homogeneityRow < mHeight - 4) {
+      createHomogeneityRow(homogeneityRow);
+    }
+  }
+
+  bool popRow(unsigned short* out)
+  {
+    if (mRowsPopped == rowsReady()) return false;
+
+    const int row = mRowsPopped++;
+
+    if (!hasInterior() || row < Border || row >= mHeight - Border) {
+      interpolateBorder(row, 0, mWidth, out);
+      return true;
+    }
+
+    interpolateBorder(row, 0, Border, out);
+    interpolateBorder(row, mWidth - Border, mWidth, out);
+
+    const int left = Border;
+    const int n = mWidth - 2 * Border;
+    char* homogeneity(&mHomogeneity.row(row)[3 * left]);
+
+    mKernels.homogeneityDiff(homogeneity, 3 * mWidth, n);
+    mKernels.blendInterleaved(homogeneity,
+        &mHRgb.row(row)[3 * left], &mVRgb.row(row)[3 * left],
+        &out[3 * left], &out[3 * left + 1], &out[3 * left + 2], n);
+
+    return true;
+  }
+};
+
+StreamingInterpolator::StreamingInterpolator(
+    const CameraProfile& profile, unsigned int width, unsigned int height,
+    bool fixedPointLab)
+  : impl(new Impl(profile, width, height, fixedPointLab))
+{
+}
+
+StreamingInterpolator::~StreamingInterpolator()
+{
+  delete impl;
+}
+
+unsigned int StreamingInterpolator::width() const
+{
+  return impl->width();
+}
+
+unsigned int StreamingInterpolator::height() const
+{
+  return impl->height();
+}
+
+unsigned int StreamingInterpolator::rowsPushed() const
+{
+  return impl->rowsPushed();
+}
+
+unsigned int StreamingInterpolator::rowsPopped() const
+{
+  return impl->rowsPopped();
+}
+
+void StreamingInterpolator::pushRow(const unsigned short* grayRow)
+{
+  impl->pushRow(grayRow);
+}
+
+bool StreamingInterpolator::popRow(unsigned short* outRgbRow)
+{
+  return impl->popRow(outRgbRow);
+}
+
+} // namespace refinery
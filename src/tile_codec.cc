@@ -0,0 +1,202 @@
+#include "tile_codec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace refinery {
+
+namespace {
+  // PackBits-style control bytes: 0-127 mean "copy the next 1-128 bytes",
+  // 128-255 mean "repeat the next byte 3-130 times"
+  const unsigned int MaxLiteral = 128;
+  const unsigned int MinRun = 3;
+  const unsigned int MaxRun = 130;
+
+  void packBits(
+      const unsigned char* in, std::size_t n, std::vector<unsigned char>& out)
+  {
+    std::size_t i = 0;
+    std::size_t literalStart = 0;
+
+    while (i < n) {
+      std::size_t run = 1;
+      while (i + run < n && run < MaxRun && in[i + run] == in[i]) run++;
+
+      if (run >= MinRun || i - literalStart == MaxLiteral) {
+        while (literalStart < i) {
+          std::size_t nLiterals = i - literalStart;
+          if (nLiterals > MaxLiteral) nLiterals = MaxLiteral;
+          out.push_back(static_cast<unsigned char>(nLiterals - 1));
+          out.insert(
+              out.end(), in + literalStart, in + literalStart + nLiterals);
+          literalStart += nLiterals;
+        }
+      }
+
+      if (run >= MinRun) {
+        out.push_back(static_cast<unsigned char>(run - MinRun + 128));
+        out.push_back(in[i]);
+        i += run;
+        literalStart = i;
+      } else {
+        i++;
+      }
+    }
+
+    while (literalStart < n) {
+      std::size_t nLiterals = n - literalStart;
+      if (nLiterals > MaxLiteral) nLiterals = MaxLiteral;
+      out.push_back(static_cast<unsigned char>(nLiterals - 1));
+      out.insert(
+          out.end(), in + literalStart, in + literalStart + nLiterals);
+      literalStart += nLiterals;
+    }
+  }
+
+  /*
+   * Unpacks exactly n bytes and returns how many input bytes that took.
+   */
+  std::size_t unpackBits(
+      const unsigned char* in, std::size_t size, unsigned char* out,
+      std::size_t n)
+  {
+    const unsigned char* p = in;
+    const unsigned char* end = in + size;
+    std::size_t i = 0;
+
+    while (i < n) {
+      if (p >= end) throw std::runtime_error("Truncated tile data");
+
+      const unsigned int control = *p++;
+      if (control < 128) {
+        const std::size_t nLiterals = control + 1;
+        if (i + nLiterals > n || p + nLiterals > end) {
+          throw std::runtime_error("Corrupt tile data");
+        }
+        for (std::size_t j = 0; j < nLiterals; j++) out[i++] = *p++;
+      } else {
+        const std::size_t run = control - 128 + MinRun;
+        if (i + run > n || p >= end) {
+          throw std::runtime_error("Corrupt tile data");
+        }
+        const unsigned char value = *p++;
+        for (std::size_t j = 0; j < run; j++) out[i++] = value;
+      }
+    }
+
+    return p - in;
+  }
+
+  inline unsigned short zigzag(unsigned short value, unsigned short prediction)
+  {
+    const short diff = static_cast<short>(value - prediction);
+    return static_cast<unsigned short>((diff << 1) ^ (diff >> 15));
+  }
+
+  inline unsigned short unzigzag(unsigned short code, unsigned short prediction)
+  {
+    const unsigned short diff = (code >> 1) ^ (0 - (code & 1));
+    return static_cast<unsigned short>(prediction + diff);
+  }
+
+  /*
+   * Predicts a value from its same-color neighbors step pixels to the left
+   * (a), above (b) and above-left (c), with the LOCO-I "median edge
+   * detector": across an edge it picks the neighbor on the same side, and
+   * elsewhere it assumes a smooth gradient.
+   *
+   * Along the top and left edges there's only one neighbor to use, and in
+   * the top-left corner there are none.
+   */
+  inline unsigned short predict(
+      const unsigned short* value, int row, int col, int rowLength,
+      unsigned int nColors, int step)
+  {
+    const std::ptrdiff_t left = step * static_cast<std::ptrdiff_t>(nColors);
+    const std::ptrdiff_t up = step * static_cast<std::ptrdiff_t>(rowLength);
+
+    if (row < step) return col < step ? 0 : value[-left];
+    if (col < step) return value[-up];
+
+    const int a = value[-left];
+    const int b = value[-up];
+    const int c = value[-up - left];
+
+    if (c >= std::max(a, b)) return std::min(a, b);
+    if (c <= std::min(a, b)) return std::max(a, b);
+    return a + b - c;
+  }
+} // namespace {}
+
+void TileCodec::encode(
+    const unsigned short* values, int width, int height,
+    unsigned int nColors, int step, std::vector<unsigned char>& out)
+{
+  const int rowLength = width * nColors;
+  const std::size_t n = static_cast<std::size_t>(rowLength) * height;
+
+  std::vector<unsigned char> planes(2 * n);
+  unsigned char* hi = &planes[0];
+  unsigned char* lo = hi + n;
+
+  std::size_t i = 0;
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      for (unsigned int c = 0; c < nColors; c++, i++) {
+        const unsigned short prediction(
+            predict(&values[i], row, col, rowLength, nColors, step));
+        const unsigned short code = zigzag(values[i], prediction);
+        hi[i] = code >> 8;
+        lo[i] = code & 0xff;
+      }
+    }
+  }
+
+  out.clear();
+  out.resize(4);
+  packBits(hi, n, out);
+
+  // Prefix: how many bytes the high plane packed into, little-endian
+  const std::size_t hiSize = out.size() - 4;
+  for (unsigned int b = 0; b < 4; b++) {
+    out[b] = static_cast<unsigned char>(hiSize >> (8 * b));
+  }
+
+  packBits(lo, n, out);
+}
+
+void TileCodec::decode(
+    const unsigned char* data, std::size_t size, int width, int height,
+    unsigned int nColors, int step, unsigned short* values)
+{
+  const int rowLength = width * nColors;
+  const std::size_t n = static_cast<std::size_t>(rowLength) * height;
+
+  if (size < 4) throw std::runtime_error("Truncated tile data");
+  std::size_t hiSize = 0;
+  for (unsigned int b = 0; b < 4; b++) {
+    hiSize |= static_cast<std::size_t>(data[b]) << (8 * b);
+  }
+  if (hiSize > size - 4) throw std::runtime_error("Corrupt tile data");
+
+  std::vector<unsigned char> planes(2 * n);
+  unsigned char* hi = &planes[0];
+  unsigned char* lo = hi + n;
+
+  unpackBits(data + 4, hiSize, hi, n);
+  unpackBits(data + 4 + hiSize, size - 4 - hiSize, lo, n);
+
+  std::size_t i = 0;
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      for (unsigned int c = 0; c < nColors; c++, i++) {
+        const unsigned short prediction(
+            predict(&values[i], row, col, rowLength, nColors, step));
+        const unsigned short code = (hi[i] << 8) | lo[i];
+        values[i] = unzigzag(code, prediction);
+      }
+    }
+  }
+}
+
+} // namespace refinery
@@ -0,0 +1,61 @@
+#ifndef _REFINERY_TILE_CODEC_H
+#define _REFINERY_TILE_CODEC_H
+
+#include <cstddef>
+#include <vector>
+
+namespace refinery {
+
+/**
+ * Lossless compression for small grids of 16-bit sensor values.
+ *
+ * Sensor data is smooth, so each value is first replaced by its difference
+ * from a prediction based on its same-color neighbors. Small differences
+ * (zigzag-encoded, so -1 becomes 1 and 1 becomes 2) have a high byte of 0.
+ * The high and low bytes are then split into two planes, and each plane is
+ * run-length encoded: the high plane shrinks a lot, the noisy low plane
+ * stays about the same size.
+ *
+ * That's 50-65% of the bytes for typical raw data, in one cheap pass each
+ * way.
+ *
+ * Values are interleaved: a grid of RGB pixels is 3 * width * height values,
+ * red-green-blue-red-green-blue.
+ */
+class TileCodec {
+public:
+  /**
+   * Compresses a grid of values.
+   *
+   * \param[in] values First value of the grid.
+   * \param[in] width Grid width, in pixels.
+   * \param[in] height Grid height, in pixels.
+   * \param[in] nColors Number of values per pixel.
+   * \param[in] step Distance to the neighbors each value is predicted from:
+   *                 1 for full-color pixels, 2 for a Bayer mosaic (whose
+   *                 nearest same-color neighbors are two pixels away).
+   * \param[out] out Compressed bytes (replaced).
+   */
+  static void encode(
+      const unsigned short* values, int width, int height,
+      unsigned int nColors, int step, std::vector<unsigned char>& out);
+
+  /**
+   * Decompresses a grid of values compressed by encode().
+   *
+   * \param[in] data Compressed bytes.
+   * \param[in] size Number of compressed bytes.
+   * \param[in] width Grid width, in pixels, as passed to encode().
+   * \param[in] height Grid height, in pixels, as passed to encode().
+   * \param[in] nColors Number of values per pixel, as passed to encode().
+   * \param[in] step Prediction distance, as passed to encode().
+   * \param[out] values Where to write width * height * nColors values.
+   */
+  static void decode(
+      const unsigned char* data, std::size_t size, int width, int height,
+      unsigned int nColors, int step, unsigned short* values);
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_TILE_CODEC_H */
@@ -0,0 +1,145 @@
+#include "tile_size.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace refinery {
+
+namespace {
+  // Typical per-core L2 size, for when the OS won't tell us
+  const std::size_t DefaultCacheSize = 256 * 1024;
+
+  // Wide tiles stream better, but tiles much wider than tall spend more time
+  // on their top and bottom margins than they gain
+  const unsigned int Aspect = 4;
+  const unsigned int MinSize = 32;
+  const unsigned int MaxWidth = 1024;
+
+  const char FileMagic[] = "refinery-tile-size";
+
+  /*
+   * Reads a sysfs cache size, such as "2048K".
+   */
+  std::size_t readSysfsSize(const char* path)
+  {
+    FILE* f = std::fopen(path, "r");
+    if (!f) return 0;
+
+    unsigned long size = 0;
+    char unit = '\0';
+    const int n = std::fscanf(f, "%lu%c", &size, &unit);
+    std::fclose(f);
+
+    if (n < 1) return 0;
+    if (n == 2 && unit == 'K') size *= 1024;
+    if (n == 2 && unit == 'M') size *= 1024 * 1024;
+    return size;
+  }
+
+  /*
+   * Finds the level-2 data (or unified) cache in sysfs.
+   */
+  std::size_t sysfsCacheSize()
+  {
+    for (int index = 0; index < 8; index++) {
+      std::ostringstream dir;
+      dir << "/sys/devices/system/cpu/cpu0/cache/index" << index << "/";
+
+      FILE* f = std::fopen((dir.str() + "level").c_str(), "r");
+      if (!f) break;
+      int level = 0;
+      const bool readLevel = std::fscanf(f, "%d", &level) == 1;
+      std::fclose(f);
+      if (!readLevel || level != 2) continue;
+
+      f = std::fopen((dir.str() + "type").c_str(), "r");
+      char type[32] = "";
+      if (f) {
+        if (std::fscanf(f, "%31s", type) != 1) type[0] = '\0';
+        std::fclose(f);
+      }
+      if (!std::strcmp(type, "Instruction")) continue;
+
+      return readSysfsSize((dir.str() + "size").c_str());
+    }
+    return 0;
+  }
+} // namespace {}
+
+std::size_t TileSize::detectCacheSize()
+{
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  const long size = ::sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (size > 0) return size;
+#endif /* _SC_LEVEL2_CACHE_SIZE */
+
+  const std::size_t sysfsSize = sysfsCacheSize();
+  return sysfsSize ? sysfsSize : DefaultCacheSize;
+}
+
+TileSize TileSize::forCache(
+    std::size_t cacheBytes, std::size_t bytesPerPixel, unsigned int margin)
+{
+  const double pixels = static_cast<double>(cacheBytes) / 2 / bytesPerPixel;
+  const unsigned int minSize = std::max(MinSize, 4 * margin);
+
+  // Aspect times as wide as tall, unless that's too wide
+  const unsigned int width = std::max(minSize, std::min(MaxWidth,
+        static_cast<unsigned int>(std::sqrt(pixels * Aspect))));
+  const unsigned int height = std::max(minSize,
+      static_cast<unsigned int>(pixels / width));
+
+  return TileSize(height, width);
+}
+
+bool TileSize::read(
+    const char* path, std::size_t cacheBytes, TileSize& outTileSize)
+{
+  FILE* f = std::fopen(path, "r");
+  if (!f) return false;
+
+  char magic[sizeof(FileMagic)] = "";
+  unsigned long fileCacheBytes = 0;
+  unsigned int height = 0;
+  unsigned int width = 0;
+  const int n = std::fscanf(f, "%18s %lu %u %u",
+      magic, &fileCacheBytes, &height, &width);
+  std::fclose(f);
+
+  if (n != 4 || std::strcmp(magic, FileMagic)
+      || fileCacheBytes != cacheBytes || !height || !width) {
+    return false;
+  }
+
+  outTileSize = TileSize(height, width);
+  return true;
+}
+
+bool TileSize::write(const char* path, std::size_t cacheBytes) const
+{
+  std::ostringstream tmpPath;
+  tmpPath << path << ".tmp." << ::getpid();
+  const std::string tmp(tmpPath.str());
+
+  FILE* f = std::fopen(tmp.c_str(), "w");
+  if (!f) return false;
+
+  const bool written = std::fprintf(f, "%s %lu %u %u\n",
+      FileMagic, static_cast<unsigned long>(cacheBytes), height, width) > 0;
+
+  if (std::fclose(f) != 0 || !written
+      || std::rename(tmp.c_str(), path) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace refinery
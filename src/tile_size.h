@@ -0,0 +1,85 @@
+#ifndef _REFINERY_TILE_SIZE_H
+#define _REFINERY_TILE_SIZE_H
+
+#include <cstddef>
+
+namespace refinery {
+
+/**
+ * Height and width of the scratch tiles a tiled algorithm works in.
+ *
+ * Tiled algorithms are fastest when one thread's tiles fit in its L2 cache,
+ * and that size differs from host to host. forCache() picks a size for a
+ * given cache, favoring wide tiles: rows are contiguous in memory, so wide
+ * tiles stream better and waste less on the margins they share with their
+ * neighbors.
+ */
+struct TileSize {
+  unsigned int height; /**< Rows per tile, margins included. */
+  unsigned int width; /**< Columns per tile, margins included. */
+
+  /**
+   * Constructor: 0x0, meaning "not chosen yet".
+   */
+  TileSize() : height(0), width(0) {}
+
+  /**
+   * Constructor.
+   *
+   * \param[in] aHeight Rows per tile.
+   * \param[in] aWidth Columns per tile.
+   */
+  TileSize(unsigned int aHeight, unsigned int aWidth)
+    : height(aHeight), width(aWidth) {}
+
+  /**
+   * \c true unless this is 0x0.
+   */
+  bool isSet() const { return height != 0 || width != 0; }
+
+  /**
+   * Bytes of L2 cache per core, or a conservative guess if the OS won't say.
+   */
+  static std::size_t detectCacheSize();
+
+  /**
+   * The tile size whose tiles take about half of \p cacheBytes.
+   *
+   * The other half is left for the input and output rows the tiles are read
+   * from and written to.
+   *
+   * \param[in] cacheBytes Bytes of cache per thread.
+   * \param[in] bytesPerPixel Bytes of scratch per tile pixel, over all of a
+   *                          thread's tiles.
+   * \param[in] margin Pixels each tile overlaps its neighbors on each side.
+   */
+  static TileSize forCache(
+      std::size_t cacheBytes, std::size_t bytesPerPixel, unsigned int margin);
+
+  /**
+   * Reads a tile size saved by write().
+   *
+   * \param[in] path File name.
+   * \param[in] cacheBytes Cache size the tile size must have been chosen for.
+   * \param[out] outTileSize Tile size, if the file is for \p cacheBytes.
+   * \return \c true if the file exists, parses and matches \p cacheBytes.
+   */
+  static bool read(
+      const char* path, std::size_t cacheBytes, TileSize& outTileSize);
+
+  /**
+   * Saves this tile size, chosen for \p cacheBytes, to \p path.
+   *
+   * The file is replaced atomically, so concurrent processes never read a
+   * half-written one.
+   *
+   * \param[in] path File name.
+   * \param[in] cacheBytes Cache size this tile size was chosen for.
+   * \return \c true on success.
+   */
+  bool write(const char* path, std::size_t cacheBytes) const;
+};
+
+} // namespace refinery
+
+#endif /* _REFINERY_TILE_SIZE_H */
@@ -18,13 +18,15 @@ namespace unpack {
   class GrayUnpacker {
   public:
     virtual GrayImage* unpackGrayImage(
-        std::streambuf& is, const ExifData& exifData) const = 0;
+        std::streambuf& is, const ExifData& exifData,
+        ImagePool* pool) const = 0;
   };
 
   class RgbUnpacker {
   public:
     virtual RGBImage* unpackRgbImage(
-        std::streambuf& is, const ExifData& exifData) const = 0;
+        std::streambuf& is, const ExifData& exifData,
+        ImagePool* pool) const = 0;
   };
 
   class PpmUnpacker : public RgbUnpacker {
@@ -57,7 +59,7 @@ namespace unpack {
     }
 
     void copyShorts(
-        std::streambuf& is, unsigned int nValues, unsigned short* out) const
+        std::streambuf& is, std::size_t nValues, unsigned short* out) const
     {
       while (nValues--) {
         uint16_t msb = static_cast<unsigned char>(is.sbumpc());
@@ -68,7 +70,7 @@ namespace unpack {
     }
 
     void copyChars(
-        std::streambuf& is, unsigned int nValues, unsigned short* out) const
+        std::streambuf& is, std::size_t nValues, unsigned short* out) const
     {
       while (nValues--) {
         unsigned char c = static_cast<unsigned char>(is.sbumpc());
@@ -79,7 +81,7 @@ namespace unpack {
 
   public:
     virtual RGBImage* unpackRgbImage(
-        std::streambuf& is, const ExifData& exifData) const
+        std::streambuf& is, const ExifData& exifData, ImagePool* pool) const
     {
       // This will give a NullCamera
       CameraData cameraData(
@@ -90,9 +92,10 @@ namespace unpack {
       int height;
       unpackHeader(is, width, height, bpp);
 
-      std::auto_ptr<RGBImage> image(new RGBImage(cameraData, width, height));
+      std::auto_ptr<RGBImage> image(new RGBImage(
+            cameraData, width, height, ImageBuffer::ZERO_FILL, pool));
 
-      unsigned int nValues =
+      std::size_t nValues =
           image->nPixels() * bpp / sizeof(RGBImage::ValueType);
 
       unsigned short* shorts(
@@ -261,7 +264,7 @@ namespace unpack {
 
   public:
     virtual GrayImage* unpackGrayImage(
-        std::streambuf& is, const ExifData& exifData) const
+        std::streambuf& is, const ExifData& exifData, ImagePool* pool) const
     {
       CameraData cameraData(
           CameraDataFactory::instance().getCameraData(exifData));
@@ -286,7 +289,8 @@ namespace unpack {
       is.pubseekoff(getDataOffset(exifData), std::ios::beg);
 
       std::auto_ptr<GrayImage> imagePtr(
-          new GrayImage(cameraData, width, height));
+          new GrayImage(
+            cameraData, width, height, ImageBuffer::UNINITIALIZED, pool));
       GrayImage& image(*imagePtr);
 
       std::auto_ptr<HuffmanDecoder> decoder(getDecoder(is, exifData));
@@ -366,7 +370,7 @@ GrayImage* ImageReader::readGrayImage(
       unpack::UnpackerFactory::createGrayUnpacker(exifData));
 
   std::auto_ptr<GrayImage> ret(
-      unpacker->unpackGrayImage(istream, exifData));
+      unpacker->unpackGrayImage(istream, exifData, mPool));
 
   // Gotta admit, I don't know what this does :). dcraw has it.
   unsigned int filters(ret->filters());
@@ -387,7 +391,7 @@ RGBImage* ImageReader::readRgbImage(
   std::auto_ptr<unpack::RgbUnpacker> unpacker(
       unpack::UnpackerFactory::createRgbUnpacker(exifData));
 
-  return unpacker->unpackRgbImage(istream, exifData);
+  return unpacker->unpackRgbImage(istream, exifData, mPool);
 }
 
 RGBImage* ImageReader::readRgbImage(FILE* istream, const ExifData& exifData)
@@ -0,0 +1,173 @@
+#include "refinery/white_balance.h"
+
+#include <limits>
+
+#include <boost/cstdint.hpp>
+
+#include "refinery/camera.h"
+#include "refinery/image.h"
+#include "refinery/image_view.h"
+
+namespace refinery {
+
+namespace {
+  template<typename T>
+  class AutoWhiteBalanceImpl {
+  public:
+    typedef T ImageType;
+    typedef typename ImageType::ColorType ColorType;
+    typedef typename ImageType::PixelType PixelType;
+    typedef typename ImageType::ValueType ValueType;
+
+  private:
+    const ImageType& mImage;
+    AutoWhiteBalance::Method mMethod;
+
+    double mSums[4];
+    boost::uint64_t mCounts[4];
+    unsigned int mMaxima[4];
+
+    /*
+     * Adds one value to a running sum/count/max, unless it's clipped.
+     *
+     * This is branch-free so the compiler can vectorize the row loop.
+     */
+    static inline void accumulate(
+        unsigned int value, unsigned int clip, boost::uint64_t& sum,
+        unsigned int& count, unsigned int& max)
+    {
+      const unsigned int ok = value < clip;
+      const unsigned int v = value * ok;
+      sum += v;
+      count += ok;
+      max = max > v ? max : v;
+    }
+
+    /*
+     * Sums, counts and finds maxima of unclipped values, per sensor color.
+     *
+     * Each thread reduces its own rows into locals and merges them once at
+     * the end, so this is a single pass over the image.
+     */
+    void reduce(unsigned int clip)
+    {
+      for (ColorType c = 0; c < 4; c++) {
+        mSums[c] = 0.0;
+        mCounts[c] = 0;
+        mMaxima[c] = 0;
+      }
+
+      const int height = mImage.height();
+      const int width = mImage.width();
+
+#if _OPENMP
+#pragma omp parallel
+#endif /* _OPENMP */
+      {
+        double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+        boost::uint64_t counts[4] = { 0, 0, 0, 0 };
+        unsigned int maxima[4] = { 0, 0, 0, 0 };
+
+#if _OPENMP
+#pragma omp for schedule(static)
+#endif /* _OPENMP */
+        for (int row = 0; row < height; row++) {
+          const PixelType* pix(mImage.constPixelsAtRow(row));
+
+          // Colors alternate along a row: even columns, then odd columns
+          const ColorType rowColors[2] = {
+            mImage.colorAtPoint(row, 0), mImage.colorAtPoint(row, 1)
+          };
+          boost::uint64_t rowSums[2] = { 0, 0 };
+          unsigned int rowCounts[2] = { 0, 0 };
+          unsigned int rowMaxima[2] = { 0, 0 };
+
+          int col = 0;
+          for (; col + 1 < width; col += 2) {
+            accumulate(pix[col].value(), clip,
+                rowSums[0], rowCounts[0], rowMaxima[0]);
+            accumulate(pix[col + 1].value(), clip,
+                rowSums[1], rowCounts[1], rowMaxima[1]);
+          }
+          if (col < width) {
+            accumulate(pix[col].value(), clip,
+                rowSums[0], rowCounts[0], rowMaxima[0]);
+          }
+
+          for (int i = 0; i < 2; i++) {
+            const ColorType c = rowColors[i];
+            sums[c] += rowSums[i];
+            counts[c] += rowCounts[i];
+            if (maxima[c] < rowMaxima[i]) maxima[c] = rowMaxima[i];
+          }
+        }
+
+#if _OPENMP
+#pragma omp critical(AutoWhiteBalance_reduce)
+#endif /* _OPENMP */
+        {
+          for (ColorType c = 0; c < 4; c++) {
+            mSums[c] += sums[c];
+            mCounts[c] += counts[c];
+            if (mMaxima[c] < maxima[c]) mMaxima[c] = maxima[c];
+          }
+        }
+      }
+    }
+
+  public:
+    AutoWhiteBalanceImpl(const ImageType& image, AutoWhiteBalance::Method method)
+      : mImage(image), mMethod(method) {}
+
+    void computeMultipliers(double outMultipliers[4])
+    {
+      const CameraProfile& profile(mImage.profile());
+      const Camera::ColorConversionData& colorData(
+          profile.colorConversionData());
+
+      for (ColorType c = 0; c < 4; c++) {
+        outMultipliers[c] = colorData.scalingMultipliers[c];
+      }
+
+      const double whiteLevel = profile.maximum() > 0
+        ? profile.maximum()
+        : std::numeric_limits<ValueType>::max();
+
+      reduce(static_cast<unsigned int>(whiteLevel));
+
+      const ColorType nColors = profile.colors();
+      double estimates[4];
+      double brightest = 0.0;
+      for (ColorType c = 0; c < nColors; c++) {
+        if (mCounts[c] == 0) return;
+
+        estimates[c] = mMethod == AutoWhiteBalance::WHITE_PATCH
+          ? mMaxima[c]
+          : mSums[c] / mCounts[c];
+        if (estimates[c] <= 0.0) return;
+
+        if (brightest < estimates[c]) brightest = estimates[c];
+      }
+
+      for (ColorType c = 0; c < nColors; c++) {
+        outMultipliers[c] = brightest / estimates[c] * 65535.0 / whiteLevel;
+      }
+    }
+  };
+} // namespace {}
+
+template<typename T>
+void AutoWhiteBalance::computeMultipliers(
+    const T& image, double outMultipliers[4]) const
+{
+  AutoWhiteBalanceImpl<T> impl(image, mMethod);
+  impl.computeMultipliers(outMultipliers);
+}
+
+// Instantiate the ones we need... (hack-ish)
+template void AutoWhiteBalance::computeMultipliers<GrayImage>(
+    const GrayImage&, double[4]) const;
+template void AutoWhiteBalance::computeMultipliers<ConstGrayImageView>(
+    const ConstGrayImageView&, double[4]) const;
+
+} // namespace refinery
@@ -0,0 +1,300 @@
+#include <gtest/gtest.h>
+
+#include "../src/ahd_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "row_kernels_test.h"
+
+namespace {
+
+using refinery::AHDKernels;
+
+class AHDKernelsTest : public refinery_test::RowKernelsTest {
+protected:
+  std::vector<short> lab;
+  std::vector<char> homogeneity;
+  std::vector<float> cbrtTable;
+  float cameraToXyz[3][4];
+
+  AHDKernelsTest() : RowKernelsTest(4321) {}
+
+  virtual void SetUp() {
+    RowKernelsTest::SetUp();
+
+    lab.resize(Width * Height * 3);
+    for (size_t i = 0; i < lab.size(); i++) {
+      lab[i] = static_cast<short>(randomValue());
+    }
+
+    homogeneity.resize(Width * Height * 3);
+    for (size_t i = 0; i < homogeneity.size(); i++) {
+      homogeneity[i] = std::rand() % 5;
+    }
+
+    cbrtTable.resize(0x20000);
+    for (size_t i = 0; i < cbrtTable.size(); i++) {
+      cbrtTable[i] = 8.0f + (std::rand() % 56000) / 1000.0f;
+    }
+
+    const float matrix[3][4] = {
+      { 0.61f, 0.29f, 0.15f, 0.0f },
+      { 0.31f, 0.68f, 0.05f, 0.0f },
+      { -0.02f, 0.08f, 1.24f, 0.0f }
+    };
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 4; j++) cameraToXyz[i][j] = matrix[i][j];
+    }
+  }
+};
+
+TEST_F(AHDKernelsTest, ScalarIsAlwaysSupported) {
+  EXPECT_TRUE(AHDKernels::supported(AHDKernels::SCALAR));
+  EXPECT_TRUE(AHDKernels::supported(AHDKernels::best()));
+}
+
+TEST_F(AHDKernelsTest, Green) {
+  const AHDKernels& scalar(
+      AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+
+  std::vector<unsigned short> hRef(rgb), vRef(rgb);
+  scalar.green(&gray[offset(Row, Left, 1)], Width,
+      &hRef[offset(Row, Left, 3) + 1], &vRef[offset(Row, Left, 3) + 1], N);
+
+  for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+    const AHDKernels::InstructionSet s(
+        static_cast<AHDKernels::InstructionSet>(set));
+    if (!AHDKernels::supported(s)) continue;
+
+    std::vector<unsigned short> h(rgb), v(rgb);
+    AHDKernels::forInstructionSet(s).green(&gray[offset(Row, Left, 1)], Width,
+        &h[offset(Row, Left, 3) + 1], &v[offset(Row, Left, 3) + 1], N);
+    EXPECT_TRUE(h == hRef) << "instruction set " << set;
+    EXPECT_TRUE(v == vRef) << "instruction set " << set;
+  }
+}
+
+TEST_F(AHDKernelsTest, FillPixels) {
+  for (unsigned int rowC = 0; rowC <= 2; rowC += 2) {
+    const AHDKernels& scalar(
+        AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+
+    std::vector<unsigned short> gRef(rgb), rbRef(rgb);
+    scalar.fillGreenPixels(&gray[offset(Row, Left, 1)], Width,
+        &gRef[offset(Row, Left, 3)], Width * 3, rowC, N);
+    scalar.fillRedBluePixels(&gray[offset(Row, Left, 1)], Width,
+        &rbRef[offset(Row, Left, 3)], Width * 3, rowC, N);
+
+    for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+      const AHDKernels::InstructionSet s(
+          static_cast<AHDKernels::InstructionSet>(set));
+      if (!AHDKernels::supported(s)) continue;
+
+      const AHDKernels& kernels(AHDKernels::forInstructionSet(s));
+      std::vector<unsigned short> g(rgb), rb(rgb);
+      kernels.fillGreenPixels(&gray[offset(Row, Left, 1)], Width,
+          &g[offset(Row, Left, 3)], Width * 3, rowC, N);
+      kernels.fillRedBluePixels(&gray[offset(Row, Left, 1)], Width,
+          &rb[offset(Row, Left, 3)], Width * 3, rowC, N);
+      EXPECT_TRUE(g == gRef) << "instruction set " << set << ", " << rowC;
+      EXPECT_TRUE(rb == rbRef) << "instruction set " << set << ", " << rowC;
+    }
+  }
+}
+
+TEST_F(AHDKernelsTest, Lab) {
+  // Rounding differences are rare, so convert plenty of pixels
+  const int NPixels = 0x10000;
+  std::vector<unsigned short> manyRgb(NPixels * 3);
+  for (size_t i = 0; i < manyRgb.size(); i++) {
+    manyRgb[i] = std::rand() & 0xffff;
+  }
+
+  const AHDKernels& scalar(
+      AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+
+  std::vector<short> ref(manyRgb.size());
+  scalar.lab(&manyRgb[0], &ref[0], cameraToXyz, &cbrtTable[0], NPixels);
+
+  for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+    const AHDKernels::InstructionSet s(
+        static_cast<AHDKernels::InstructionSet>(set));
+    if (!AHDKernels::supported(s)) continue;
+
+    std::vector<short> out(manyRgb.size());
+    AHDKernels::forInstructionSet(s).lab(&manyRgb[0], &out[0], cameraToXyz,
+        &cbrtTable[0], NPixels);
+    EXPECT_TRUE(out == ref) << "instruction set " << set;
+  }
+}
+
+TEST_F(AHDKernelsTest, LabFixed) {
+  std::vector<unsigned short> cbrtTableFixed(0x10000);
+  for (size_t i = 0; i < cbrtTableFixed.size(); i++) {
+    cbrtTableFixed[i] = randomValue();
+  }
+
+  // Extremes in the matrix too, so every sum is as big as it can be
+  const int matrix[3][3] = {
+    { 0x7fff, 0, 0 },
+    { -0x4000, 0x2000, -0x1fff },
+    { 1000, -2000, 4000 }
+  };
+
+  const int NPixels = 0x1000 + 3; // so the last block is partial
+  std::vector<unsigned short> manyRgb(NPixels * 3);
+  for (size_t i = 0; i < manyRgb.size(); i++) manyRgb[i] = randomValue();
+
+  const AHDKernels& scalar(
+      AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+
+  std::vector<short> ref(manyRgb.size());
+  scalar.labFixed(&manyRgb[0], &ref[0], matrix, &cbrtTableFixed[0], NPixels);
+
+  for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+    const AHDKernels::InstructionSet s(
+        static_cast<AHDKernels::InstructionSet>(set));
+    if (!AHDKernels::supported(s)) continue;
+
+    std::vector<short> out(manyRgb.size());
+    AHDKernels::forInstructionSet(s).labFixed(&manyRgb[0], &out[0], matrix,
+        &cbrtTableFixed[0], NPixels);
+    EXPECT_TRUE(out == ref) << "instruction set " << set;
+  }
+}
+
+TEST_F(AHDKernelsTest, LabFixedIsCloseToLab) {
+  // Real tables, as AHDInterpolator builds them
+  std::vector<float> table(0x20000);
+  std::vector<unsigned short> tableFixed(0x10000);
+  for (int i = 0; i < 0x10000; i++) {
+    double r = i / 65535.0;
+    table[i] = 64.0f * (r > 0.008856 ? std::pow(r, 1.0/3) : 7.787*r + 16.0/116);
+    tableFixed[i] = static_cast<unsigned short>(std::min(65535.0f,
+          table[i] * (1 << AHDKernels::CbrtFixedBits) + 0.5f));
+  }
+  std::fill(&table[0x10000], &table[0x18000], table[0xffff]);
+  std::fill(&table[0x18000], &table[0x20000], table[0]);
+
+  // A real camera's (NIKON D5000's)
+  const float matrix[3][4] = {
+    { 0.8021f, 0.1409f, 0.0570f, 0.0f },
+    { 0.3882f, 0.7845f, -0.1727f, 0.0f },
+    { 0.0863f, -0.2154f, 1.1291f, 0.0f }
+  };
+  int matrixFixed[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      matrixFixed[i][j] = static_cast<int>(std::floor(
+            matrix[i][j] * (1 << AHDKernels::XyzFixedBits) + 0.5f));
+    }
+  }
+
+  const int NPixels = 0x10000;
+  std::vector<unsigned short> manyRgb(NPixels * 3);
+  for (size_t i = 0; i < manyRgb.size(); i++) {
+    manyRgb[i] = std::rand() & 0xffff;
+  }
+
+  const AHDKernels& scalar(
+      AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+  std::vector<short> expected(manyRgb.size());
+  scalar.lab(&manyRgb[0], &expected[0], matrix, &table[0], NPixels);
+  std::vector<short> actual(manyRgb.size());
+  scalar.labFixed(&manyRgb[0], &actual[0], matrixFixed, &tableFixed[0],
+      NPixels);
+
+  // The quality delta, per channel
+  int maxDiff[3] = { 0, 0, 0 };
+  double sumDiff[3] = { 0, 0, 0 };
+  for (int i = 0; i < NPixels; i++) {
+    for (int c = 0; c < 3; c++) {
+      const int diff = std::abs(expected[3 * i + c] - actual[3 * i + c]);
+      maxDiff[c] = std::max(maxDiff[c], diff);
+      sumDiff[c] += diff;
+    }
+  }
+  RecordProperty("MaxDiffL", maxDiff[0]);
+  RecordProperty("MaxDiffA", maxDiff[1]);
+  RecordProperty("MaxDiffB", maxDiff[2]);
+
+  // L runs to 6400 and A and B to about +/-20000
+  EXPECT_LE(maxDiff[0], 4);
+  EXPECT_LE(maxDiff[1], 16);
+  EXPECT_LE(maxDiff[2], 8);
+  for (int c = 0; c < 3; c++) {
+    EXPECT_LT(sumDiff[c] / NPixels, 1.0) << "channel " << c;
+  }
+}
+
+TEST_F(AHDKernelsTest, Homogeneity) {
+  const AHDKernels& scalar(
+      AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+
+  std::vector<short> vLab(lab.rbegin(), lab.rend());
+
+  std::vector<char> ref(homogeneity);
+  scalar.homogeneity(&lab[offset(Row, 1, 3)], &vLab[offset(Row, 1, 3)],
+      Width * 3, &ref[offset(Row, 1, 3)], Width - 2);
+
+  for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+    const AHDKernels::InstructionSet s(
+        static_cast<AHDKernels::InstructionSet>(set));
+    if (!AHDKernels::supported(s)) continue;
+
+    std::vector<char> out(homogeneity);
+    AHDKernels::forInstructionSet(s).homogeneity(&lab[offset(Row, 1, 3)],
+        &vLab[offset(Row, 1, 3)], Width * 3, &out[offset(Row, 1, 3)],
+        Width - 2);
+    EXPECT_TRUE(out == ref) << "instruction set " << set;
+  }
+}
+
+TEST_F(AHDKernelsTest, HomogeneityDiffAndBlend) {
+  const AHDKernels& scalar(
+      AHDKernels::forInstructionSet(AHDKernels::SCALAR));
+
+  const std::vector<unsigned short> vRgb(rgb.rbegin(), rgb.rend());
+
+  std::vector<char> homoRef(homogeneity);
+  scalar.homogeneityDiff(&homoRef[offset(Row, 1, 3)], Width * 3, Width - 2);
+
+  std::vector<unsigned short> interleavedRef(rgb.size());
+  scalar.blendInterleaved(&homoRef[offset(Row, 1, 3)],
+      &rgb[offset(Row, 1, 3)], &vRgb[offset(Row, 1, 3)],
+      &interleavedRef[0], &interleavedRef[1], &interleavedRef[2], Width - 2);
+
+  std::vector<unsigned short> planarRef(rgb.size());
+  scalar.blendPlanar(&homoRef[offset(Row, 1, 3)],
+      &rgb[offset(Row, 1, 3)], &vRgb[offset(Row, 1, 3)],
+      &planarRef[0], &planarRef[Width], &planarRef[2 * Width], Width - 2);
+
+  for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+    const AHDKernels::InstructionSet s(
+        static_cast<AHDKernels::InstructionSet>(set));
+    if (!AHDKernels::supported(s)) continue;
+
+    const AHDKernels& kernels(AHDKernels::forInstructionSet(s));
+
+    std::vector<char> homo(homogeneity);
+    kernels.homogeneityDiff(&homo[offset(Row, 1, 3)], Width * 3, Width - 2);
+    EXPECT_TRUE(homo == homoRef) << "instruction set " << set;
+
+    std::vector<unsigned short> interleaved(rgb.size());
+    kernels.blendInterleaved(&homoRef[offset(Row, 1, 3)],
+        &rgb[offset(Row, 1, 3)], &vRgb[offset(Row, 1, 3)],
+        &interleaved[0], &interleaved[1], &interleaved[2], Width - 2);
+    EXPECT_TRUE(interleaved == interleavedRef) << "instruction set " << set;
+
+    std::vector<unsigned short> planar(rgb.size());
+    kernels.blendPlanar(&homoRef[offset(Row, 1, 3)],
+        &rgb[offset(Row, 1, 3)], &vRgb[offset(Row, 1, 3)],
+        &planar[0], &planar[Width], &planar[2 * Width], Width - 2);
+    EXPECT_TRUE(planar == planarRef) << "instruction set " << set;
+  }
+}
+
+} // namespace
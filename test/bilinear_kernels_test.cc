@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include "../src/bilinear_kernels.h"
+
+#include <vector>
+
+#include "row_kernels_test.h"
+
+namespace {
+
+using refinery::BilinearKernels;
+
+class BilinearKernelsTest : public refinery_test::RowKernelsTest {
+protected:
+  std::vector<float> floatGray;
+  std::vector<float> floatRgb;
+
+  BilinearKernelsTest() : RowKernelsTest(3456) {}
+
+  virtual void SetUp() {
+    RowKernelsTest::SetUp();
+
+    // Values that round differently depending on the order they're added
+    floatGray.resize(gray.size());
+    for (size_t i = 0; i < gray.size(); i++) {
+      floatGray[i] = gray[i] * 1.37f + 0.1f;
+    }
+    floatRgb.resize(rgb.size(), -1.0f);
+  }
+
+public:
+  /*
+   * Runs one kernel, picked by which, for the given instruction set.
+   */
+  std::vector<unsigned short> run(
+      const BilinearKernels& kernels, int which, unsigned int c) const {
+    std::vector<unsigned short> out(rgb);
+    if (which == 0) {
+      kernels.redBluePixels(&gray[offset(Row, Left, 1)], Width,
+          &out[offset(Row, Left, 3)], c, N);
+    } else {
+      kernels.greenPixels(&gray[offset(Row, Left, 1)], Width,
+          &out[offset(Row, Left, 3)], c, N);
+    }
+    return out;
+  }
+
+  std::vector<float> runFloat(
+      const BilinearKernels& kernels, int which, unsigned int c) const {
+    std::vector<float> out(floatRgb);
+    if (which == 0) {
+      kernels.redBluePixelsFloat(&floatGray[offset(Row, Left, 1)], Width,
+          &out[offset(Row, Left, 3)], c, N);
+    } else {
+      kernels.greenPixelsFloat(&floatGray[offset(Row, Left, 1)], Width,
+          &out[offset(Row, Left, 3)], c, N);
+    }
+    return out;
+  }
+};
+
+TEST_F(BilinearKernelsTest, RedBluePixels) {
+  expectAllSetsSameAsScalar(&BilinearKernelsTest::run, 0);
+  expectAllSetsSameAsScalar(&BilinearKernelsTest::runFloat, 0);
+}
+
+TEST_F(BilinearKernelsTest, GreenPixels) {
+  expectAllSetsSameAsScalar(&BilinearKernelsTest::run, 1);
+  expectAllSetsSameAsScalar(&BilinearKernelsTest::runFloat, 1);
+}
+
+TEST_F(BilinearKernelsTest, ActiveFollowsAHDKernels) {
+  expectActiveFollowsAHDKernels<BilinearKernels>();
+}
+
+} // namespace
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "refinery/camera.h"
+
+#include "refinery/exif.h"
+#include "refinery/image.h"
+
+namespace {
+
+class CameraFactoryTest : public ::testing::Test {
+};
+
+TEST(CameraFactoryTest, DetectByModel) {
+  refinery::InMemoryExifData exifData;
+  exifData.setString("Exif.Image.Model", "NIKON D5000");
+
+  const refinery::Camera& camera(
+      refinery::CameraFactory::instance().detectCamera(exifData));
+  EXPECT_EQ(std::string("NIKON D5000"), camera.name());
+}
+
+TEST(CameraFactoryTest, DetectByNormalizedModel) {
+  refinery::InMemoryExifData exifData;
+  exifData.setString("Exif.Image.Model", " Nikon   d5000 ");
+
+  const refinery::Camera& camera(
+      refinery::CameraFactory::instance().detectCamera(exifData));
+  EXPECT_EQ(std::string("NIKON D5000"), camera.name());
+}
+
+TEST(CameraFactoryTest, FallBackToNullCamera) {
+  refinery::InMemoryExifData exifData;
+  exifData.setString("Exif.Image.Model", "NIKON D5001");
+
+  const refinery::Camera& camera(
+      refinery::CameraFactory::instance().detectCamera(exifData));
+  EXPECT_EQ(std::string("(null)"), camera.name());
+}
+
+TEST(CameraFactoryTest, NoModel) {
+  refinery::InMemoryExifData exifData;
+
+  const refinery::Camera& camera(
+      refinery::CameraFactory::instance().detectCamera(exifData));
+  EXPECT_EQ(std::string("(null)"), camera.name());
+}
+
+TEST(CameraTest, ColorConversionDataIsComputedOnce) {
+  refinery::InMemoryExifData exifData;
+  exifData.setString("Exif.Image.Model", "NIKON D5000");
+
+  const refinery::Camera& camera(
+      refinery::CameraFactory::instance().detectCamera(exifData));
+  const refinery::Camera::ColorConversionData& colorData(
+      camera.colorConversionData());
+
+  EXPECT_EQ(&colorData, &camera.colorConversionData());
+  EXPECT_EQ(0xf00, colorData.maximum);
+  EXPECT_NEAR(0.7309, colorData.xyzToCamera[0][0], 0.00001);
+}
+
+TEST(CameraProfileTest, OutlivesExifData) {
+  std::auto_ptr<refinery::CameraProfile> profile;
+
+  {
+    refinery::InMemoryExifData exifData;
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+    profile.reset(new refinery::CameraProfile(cameraData, 225, 75));
+  }
+
+  EXPECT_EQ(0x55555555u, profile->filters());
+  EXPECT_EQ(3u, profile->colors());
+  EXPECT_EQ(1u, profile->orientation());
+  EXPECT_EQ(225u, profile->rawWidth());
+  EXPECT_EQ(75u, profile->rawHeight());
+  EXPECT_EQ(0xf00, profile->maximum());
+
+  const refinery::CameraProfile changed(profile->withFilters(0x61616161));
+  EXPECT_EQ(0x61616161u, changed.filters());
+  EXPECT_EQ(0x55555555u, profile->filters());
+}
+
+/*
+ * A known camera with no color data, like an Adobe-table camera missing
+ * its coefficients.
+ */
+class NoColorDataCamera : public refinery::Camera {
+public:
+  virtual const char* name() const { return "NO COLOR DATA"; }
+  virtual const char* make() const { return "NO"; }
+  virtual const char* model() const { return "COLOR DATA"; }
+  virtual unsigned int orientation(const refinery::ExifData&) const {
+    return 1;
+  }
+  virtual unsigned int filters(const refinery::ExifData&) const {
+    return 0x61616161;
+  }
+  virtual unsigned int rawWidth(const refinery::ExifData&) const {
+    return 16;
+  }
+  virtual unsigned int rawHeight(const refinery::ExifData&) const {
+    return 8;
+  }
+  virtual unsigned int colors() const { return 3; }
+  virtual const ColorConversionData& colorConversionData() const {
+    throw std::logic_error("Missing Adobe coefficients for camera: NO");
+  }
+  virtual bool canHandle(const refinery::ExifData&) const { return false; }
+};
+
+/*
+ * A camera that isn't static: its profiles must not point back to it.
+ */
+class ColorDataCamera : public NoColorDataCamera {
+  ColorConversionData mColorConversionData;
+
+public:
+  ColorDataCamera() {
+    std::memset(&mColorConversionData, 0, sizeof(mColorConversionData));
+    mColorConversionData.black = 0x10;
+    mColorConversionData.maximum = 0xfff;
+  }
+
+  virtual const ColorConversionData& colorConversionData() const {
+    return mColorConversionData;
+  }
+};
+
+TEST(CameraProfileTest, OutlivesCamera) {
+  std::auto_ptr<refinery::CameraProfile> profile;
+
+  {
+    const ColorDataCamera camera;
+    refinery::InMemoryExifData exifData;
+    refinery::CameraData cameraData(camera, exifData);
+    profile.reset(new refinery::CameraProfile(cameraData, 16, 8));
+  }
+
+  EXPECT_EQ(0x10, profile->black());
+  EXPECT_EQ(0xfff, profile->maximum());
+  EXPECT_EQ(0xfff, profile->colorConversionData().maximum);
+}
+
+TEST(CameraProfileTest, ImageWithoutColorData) {
+  const NoColorDataCamera camera;
+  refinery::InMemoryExifData exifData;
+  refinery::CameraData cameraData(camera, exifData);
+
+  // Reading the raw image must work; only the color stages need the data
+  refinery::GrayImage image(cameraData, 16, 8);
+  EXPECT_EQ(0x61616161u, image.filters());
+  EXPECT_THROW(image.profile().colorConversionData(), std::logic_error);
+  EXPECT_THROW(image.profile().maximum(), std::logic_error);
+  EXPECT_THROW(image.profile().black(), std::logic_error);
+}
+
+} // namespace
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include "refinery/compressed_image.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/image.h"
+#include "refinery/image_view.h"
+
+namespace {
+
+#include "files/nikon_d5000_225x75_sample.h"
+
+class CompressedImageTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+  std::auto_ptr<refinery::GrayImage> grayImage;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+    grayImage.reset(new refinery::GrayImage(cameraData, 225, 75));
+    std::copy(
+        &nikon_d5000_225x75_sample[0], &nikon_d5000_225x75_sample[225*75],
+        reinterpret_cast<unsigned short*>(grayImage->pixels()));
+  }
+
+  void expectSame(
+      const refinery::GrayImage& expected, const refinery::GrayImage& actual)
+  {
+    EXPECT_TRUE(std::equal(
+          reinterpret_cast<const unsigned short*>(expected.constPixels()),
+          reinterpret_cast<const unsigned short*>(expected.constPixelsEnd()),
+          reinterpret_cast<const unsigned short*>(actual.constPixels())));
+  }
+};
+
+TEST_F(CompressedImageTest, StartsZeroed) {
+  refinery::CompressedGrayImage store(grayImage->profile(), 225, 75);
+  EXPECT_EQ(225u * 75u, store.nPixels());
+  EXPECT_EQ(0u, store.compressedBytes());
+
+  refinery::GrayImage out(grayImage->profile(), 10, 10);
+  out.pixelAtPoint(3, 3).value() = 9;
+  store.read(refinery::Point(60, 70), refinery::GrayImageView(out));
+  EXPECT_EQ(0, out.constPixelAtPoint(3, 3).value());
+}
+
+TEST_F(CompressedImageTest, RoundTrip) {
+  // Tiles of 16x16 pixels, of which only 3 are decoded at any time
+  refinery::CompressedGrayImage store(grayImage->profile(), 225, 75, 16, 3);
+  store.write(refinery::Point(0, 0), refinery::ConstGrayImageView(*grayImage));
+  EXPECT_GE(3u * 16 * 16 * 2, store.decodedBytes());
+
+  store.flush();
+  EXPECT_GT(225u * 75u * 2u * 65 / 100, store.compressedBytes());
+
+  refinery::GrayImage out(grayImage->profile(), 225, 75);
+  store.read(refinery::Point(0, 0), refinery::GrayImageView(out));
+  expectSame(*grayImage, out);
+}
+
+TEST_F(CompressedImageTest, Regions) {
+  refinery::CompressedGrayImage store(grayImage->profile(), 225, 75, 32, 2);
+  store.write(refinery::Point(0, 0), refinery::ConstGrayImageView(*grayImage));
+
+  // A region straddling several tiles
+  refinery::GrayImage region(grayImage->profile(), 50, 40);
+  store.read(refinery::Point(20, 100), refinery::GrayImageView(region));
+  for (unsigned int row = 0; row < 40; row++) {
+    for (unsigned int col = 0; col < 50; col++) {
+      ASSERT_EQ(grayImage->constPixelAtPoint(row + 20, col + 100).value(),
+          region.constPixelAtPoint(row, col).value());
+    }
+  }
+
+  // Overwrite part of it, then read back the whole image
+  std::fill(
+      reinterpret_cast<unsigned short*>(region.pixels()),
+      reinterpret_cast<unsigned short*>(region.pixelsEnd()), 12345);
+  store.write(refinery::Point(30, 90), refinery::ConstGrayImageView(
+        region, refinery::Point(0, 0), refinery::Point(35, 45)));
+
+  refinery::GrayImage out(grayImage->profile(), 225, 75);
+  store.read(refinery::Point(0, 0), refinery::GrayImageView(out));
+  for (unsigned int row = 0; row < 75; row++) {
+    for (unsigned int col = 0; col < 225; col++) {
+      const bool overwritten =
+        row >= 30 && row < 65 && col >= 90 && col < 135;
+      ASSERT_EQ(
+          overwritten ? 12345 : grayImage->constPixelAtPoint(row, col).value(),
+          out.constPixelAtPoint(row, col).value())
+        << "(" << row << ", " << col << ")";
+    }
+  }
+}
+
+TEST_F(CompressedImageTest, RegionOutsideImageThrows) {
+  refinery::CompressedGrayImage store(grayImage->profile(), 225, 75, 32, 2);
+  refinery::GrayImage region(grayImage->profile(), 10, 10);
+
+  const refinery::Point outside[] = {
+    refinery::Point(66, 0), // past the bottom
+    refinery::Point(0, 216), // past the right
+    refinery::Point(-1, 0),
+    refinery::Point(0, -1)
+  };
+  for (size_t i = 0; i < sizeof(outside) / sizeof(outside[0]); i++) {
+    EXPECT_THROW(
+        store.read(outside[i], refinery::GrayImageView(region)),
+        std::out_of_range) << i;
+    EXPECT_THROW(
+        store.write(outside[i], refinery::ConstGrayImageView(region)),
+        std::out_of_range) << i;
+  }
+
+  // Touching the bottom-right corner is fine
+  store.write(refinery::Point(65, 215), refinery::ConstGrayImageView(region));
+  store.read(refinery::Point(65, 215), refinery::GrayImageView(region));
+}
+
+TEST_F(CompressedImageTest, InvalidSizesThrow) {
+  EXPECT_THROW(
+      refinery::CompressedGrayImage(grayImage->profile(), 225, 75, 0),
+      std::invalid_argument);
+  EXPECT_THROW(
+      refinery::CompressedGrayImage(grayImage->profile(), -1, 75),
+      std::invalid_argument);
+  EXPECT_THROW(
+      refinery::CompressedGrayImage(grayImage->profile(), 225, -1),
+      std::invalid_argument);
+}
+
+TEST_F(CompressedImageTest, RGB) {
+  refinery::RGBImage rgbImage(grayImage->profile(), 70, 20);
+  for (unsigned int row = 0; row < 20; row++) {
+    for (unsigned int col = 0; col < 70; col++) {
+      for (unsigned int c = 0; c < 3; c++) {
+        rgbImage.pixelAtPoint(row, col)[c] =
+          grayImage->constPixelAtPoint(row, col * 3 + c).value();
+      }
+    }
+  }
+
+  refinery::CompressedRGBImage store(grayImage->profile(), 70, 20, 8, 1);
+  store.write(refinery::Point(0, 0), refinery::ConstRGBImageView(rgbImage));
+
+  refinery::RGBImage out(grayImage->profile(), 70, 20);
+  store.read(refinery::Point(0, 0), refinery::RGBImageView(out));
+  EXPECT_TRUE(std::equal(
+        reinterpret_cast<const unsigned short*>(rgbImage.constPixels()),
+        reinterpret_cast<const unsigned short*>(rgbImage.constPixelsEnd()),
+        reinterpret_cast<const unsigned short*>(out.constPixels())));
+}
+
+} // namespace
@@ -0,0 +1,286 @@
+#include <gtest/gtest.h>
+
+#include "refinery/exif_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "refinery/exif.h"
+#include "../src/exif_cache_format.h"
+
+namespace {
+
+void put16(std::string& s, unsigned int v)
+{
+  s += static_cast<char>(v & 0xff);
+  s += static_cast<char>(v >> 8 & 0xff);
+}
+
+void put32(std::string& s, unsigned int v)
+{
+  put16(s, v & 0xffff);
+  put16(s, v >> 16);
+}
+
+void putTiffEntry(std::string& s, unsigned int tag, unsigned int type,
+    unsigned int count, unsigned int value)
+{
+  put16(s, tag);
+  put16(s, type);
+  put32(s, count);
+  put32(s, value);
+}
+
+/*
+ * Writes a little-endian TIFF that dcraw identifies as a 16-bit NIKON D5000
+ * raw file, width x height.
+ */
+void writeRawFile(const std::string& path, int width, int height)
+{
+  const unsigned int NEntries = 8;
+  const unsigned int StringsOffset = 8 + 2 + NEntries * 12 + 4;
+  const unsigned int SHORT = 3, LONG = 4, ASCII = 2;
+
+  std::string tiff("II*\0", 4);
+  put32(tiff, 8); // first IFD
+  put16(tiff, NEntries);
+  putTiffEntry(tiff, 0x100, LONG, 1, width); // ImageWidth
+  putTiffEntry(tiff, 0x101, LONG, 1, height); // ImageLength
+  putTiffEntry(tiff, 0x102, SHORT, 1, 16); // BitsPerSample
+  putTiffEntry(tiff, 0x103, SHORT, 1, 1); // Compression: none
+  putTiffEntry(tiff, 0x10f, ASCII, 6, StringsOffset); // Make
+  putTiffEntry(tiff, 0x110, ASCII, 6, StringsOffset + 6); // Model
+  putTiffEntry(tiff, 0x111, LONG, 1, StringsOffset + 12); // StripOffsets
+  putTiffEntry(tiff, 0x115, SHORT, 1, 1); // SamplesPerPixel
+  put32(tiff, 0); // no next IFD
+  tiff.append("NIKON\0D5000\0", 12);
+  tiff.append(width * height * 2, '\0');
+
+  FILE* f = std::fopen(path.c_str(), "wb");
+  ASSERT_TRUE(f != 0);
+  std::fwrite(tiff.data(), 1, tiff.size(), f);
+  std::fclose(f);
+}
+
+class ExifCacheTest : public ::testing::Test {
+protected:
+  std::string directory;
+  std::vector<std::string> removeAtTearDown;
+
+  virtual void SetUp() {
+    char tmpl[] = "/tmp/refinery-exif-cache-test-XXXXXX";
+    directory = ::mkdtemp(tmpl);
+  }
+
+  virtual void TearDown() {
+    refinery::ExifCache cache(directory.c_str());
+    std::remove(cache.cachePath("./test/files/input-test.txt").c_str());
+    for (size_t i = 0; i < removeAtTearDown.size(); i++) {
+      std::remove(removeAtTearDown[i].c_str());
+    }
+    ::rmdir(directory.c_str());
+  }
+
+  // Writes a raw file under directory; TearDown() removes it
+  std::string rawFile(int width, int height) {
+    const std::string path(directory + "/image.nef");
+    writeRawFile(path, width, height);
+    removeAtTearDown.push_back(path);
+    return path;
+  }
+
+  // Calls cache.getExifData(); TearDown() removes the cache file it writes
+  refinery::ExifData* getExifData(
+      const refinery::ExifCache& cache, const std::string& path) {
+    removeAtTearDown.push_back(cache.cachePath(path.c_str()));
+    return cache.getExifData(path.c_str());
+  }
+};
+
+TEST_F(ExifCacheTest, MissBeforeStore) {
+  refinery::ExifCache cache(directory.c_str());
+  std::auto_ptr<refinery::ExifData> exifData(
+      cache.find("./test/files/input-test.txt"));
+  EXPECT_EQ(0, exifData.get());
+}
+
+TEST_F(ExifCacheTest, MissOnNonexistentFile) {
+  refinery::ExifCache cache(directory.c_str());
+  EXPECT_EQ("", cache.cachePath("./test/files/does-not-exist"));
+  std::auto_ptr<refinery::ExifData> exifData(
+      cache.find("./test/files/does-not-exist"));
+  EXPECT_EQ(0, exifData.get());
+}
+
+TEST_F(ExifCacheTest, StoreAndFind) {
+  refinery::InMemoryExifData original;
+  original.setString("Exif.Image.Model", "NIKON D5000");
+  original.setInt("Exif.SubImage2.ImageWidth", 4352);
+  original.setFloat("Exif.Image.XResolution", 300.5f);
+  std::vector<unsigned char> cfaPattern;
+  cfaPattern.push_back(1);
+  cfaPattern.push_back(2);
+  cfaPattern.push_back(0);
+  cfaPattern.push_back(1);
+  original.setBytes("Exif.SubImage2.CFAPattern", cfaPattern);
+
+  std::string serialized;
+  original.serialize(serialized);
+
+  refinery::ExifCache cache(directory.c_str());
+  ASSERT_TRUE(cache.store("./test/files/input-test.txt", serialized));
+
+  std::auto_ptr<refinery::ExifData> exifData(
+      cache.find("./test/files/input-test.txt"));
+  ASSERT_TRUE(exifData.get() != 0);
+
+  EXPECT_TRUE(exifData->hasKey("Exif.Image.Model"));
+  EXPECT_FALSE(exifData->hasKey("Exif.Image.Orientation"));
+  EXPECT_EQ("NIKON D5000", exifData->getString("Exif.Image.Model"));
+  EXPECT_EQ(4352, exifData->getInt("Exif.SubImage2.ImageWidth"));
+  EXPECT_EQ(300.5f, exifData->getFloat("Exif.Image.XResolution"));
+
+  std::vector<unsigned char> bytes;
+  exifData->getBytes("Exif.SubImage2.CFAPattern", bytes);
+  EXPECT_EQ(cfaPattern, bytes);
+
+  EXPECT_THROW(exifData->getInt("Exif.Image.Model"), std::logic_error);
+  EXPECT_THROW(exifData->getInt("Exif.Image.Orientation"), std::out_of_range);
+}
+
+TEST_F(ExifCacheTest, ShortScalarIsMiss) {
+  namespace Format = refinery::ExifCacheFormat;
+
+  refinery::InMemoryExifData original;
+  original.setInt("Exif.SubImage2.ImageWidth", 4352);
+  std::string serialized;
+  original.serialize(serialized);
+
+  // Claim the int is 2 bytes long, as if it were the last thing in the file
+  Format::Entry entry;
+  const std::size_t entryOffset = sizeof(Format::BodyHeader);
+  std::memcpy(&entry, serialized.data() + entryOffset, sizeof(entry));
+  ASSERT_EQ(Format::ScalarLength, entry.valueLength);
+  entry.valueLength = 2;
+  serialized.replace(entryOffset, sizeof(entry),
+      reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+  refinery::ExifCache cache(directory.c_str());
+  ASSERT_TRUE(cache.store("./test/files/input-test.txt", serialized));
+
+  std::auto_ptr<refinery::ExifData> exifData(
+      cache.find("./test/files/input-test.txt"));
+  EXPECT_EQ(0, exifData.get());
+}
+
+TEST_F(ExifCacheTest, GetExifDataParsesThenMaps) {
+  const std::string path(rawFile(64, 48));
+  refinery::ExifCache cache(directory.c_str());
+
+  std::auto_ptr<refinery::ExifData> parsed(getExifData(cache, path));
+  EXPECT_TRUE(dynamic_cast<refinery::DcrawExifData*>(parsed.get()) != 0);
+
+  std::auto_ptr<refinery::ExifData> mapped(getExifData(cache, path));
+  EXPECT_TRUE(dynamic_cast<refinery::MappedExifData*>(mapped.get()) != 0);
+
+  for (int i = 0; i < 2; i++) {
+    const refinery::ExifData& exifData(i == 0 ? *parsed : *mapped);
+    EXPECT_EQ("NIKON D5000", exifData.getString("Exif.Image.Model"));
+    EXPECT_EQ(64, exifData.getInt("Exif.SubImage2.ImageWidth"));
+    EXPECT_EQ(48, exifData.getInt("Exif.SubImage2.ImageLength"));
+    EXPECT_EQ(16, exifData.getInt("Exif.SubImage2.BitsPerSample"));
+    EXPECT_EQ(122, exifData.getInt("Exif.SubImage2.StripOffsets"));
+  }
+
+  std::vector<unsigned char> parsedCfa, mappedCfa;
+  parsed->getBytes("Exif.SubImage2.CFAPattern", parsedCfa);
+  mapped->getBytes("Exif.SubImage2.CFAPattern", mappedCfa);
+  EXPECT_EQ(parsedCfa, mappedCfa);
+}
+
+TEST_F(ExifCacheTest, GetExifDataMissesWhenSizeChanges) {
+  const std::string path(rawFile(64, 48));
+  refinery::ExifCache cache(directory.c_str());
+  delete getExifData(cache, path);
+
+  rawFile(64, 32);
+
+  std::auto_ptr<refinery::ExifData> exifData(getExifData(cache, path));
+  EXPECT_TRUE(dynamic_cast<refinery::DcrawExifData*>(exifData.get()) != 0);
+  EXPECT_EQ(32, exifData->getInt("Exif.SubImage2.ImageLength"));
+}
+
+TEST_F(ExifCacheTest, GetExifDataMissesWhenMtimeChanges) {
+  const std::string path(rawFile(64, 48));
+  refinery::ExifCache cache(directory.c_str());
+  delete getExifData(cache, path);
+
+  struct utimbuf times;
+  times.actime = times.modtime = 1000000000;
+  ASSERT_EQ(0, ::utime(path.c_str(), &times));
+
+  std::auto_ptr<refinery::ExifData> exifData(getExifData(cache, path));
+  EXPECT_TRUE(dynamic_cast<refinery::DcrawExifData*>(exifData.get()) != 0);
+  EXPECT_EQ(48, exifData->getInt("Exif.SubImage2.ImageLength"));
+}
+
+TEST_F(ExifCacheTest, GetExifDataMissesWhenMtimeChangesWithinASecond) {
+  const std::string path(rawFile(64, 48));
+
+  struct timespec times[2];
+  times[0].tv_sec = times[1].tv_sec = 1000000000;
+  times[0].tv_nsec = times[1].tv_nsec = 1000;
+  ASSERT_EQ(0, ::utimensat(AT_FDCWD, path.c_str(), times, 0));
+
+  struct stat st;
+  ASSERT_EQ(0, ::stat(path.c_str(), &st));
+  if (st.st_mtim.tv_nsec != 1000) return; // no sub-second mtimes here
+
+  refinery::ExifCache cache(directory.c_str());
+  delete getExifData(cache, path);
+
+  times[0].tv_nsec = times[1].tv_nsec = 2000;
+  ASSERT_EQ(0, ::utimensat(AT_FDCWD, path.c_str(), times, 0));
+
+  std::auto_ptr<refinery::ExifData> exifData(getExifData(cache, path));
+  EXPECT_TRUE(dynamic_cast<refinery::DcrawExifData*>(exifData.get()) != 0);
+}
+
+TEST_F(ExifCacheTest, ConcurrentStores) {
+  refinery::InMemoryExifData original;
+  original.setString("Exif.Image.Model", "NIKON D5000");
+  original.setInt("Exif.SubImage2.ImageWidth", 4352);
+  std::string serialized;
+  original.serialize(serialized);
+
+  refinery::ExifCache cache(directory.c_str());
+
+  int nWrong = 0;
+#if _OPENMP
+#pragma omp parallel for reduction(+:nWrong)
+#endif /* _OPENMP */
+  for (int i = 0; i < 200; i++) {
+    if (!cache.store("./test/files/input-test.txt", serialized)) nWrong++;
+
+    std::auto_ptr<refinery::ExifData> exifData(
+        cache.find("./test/files/input-test.txt"));
+    if (!exifData.get()
+        || exifData->getInt("Exif.SubImage2.ImageWidth") != 4352) {
+      nWrong++;
+    }
+  }
+
+  EXPECT_EQ(0, nWrong);
+}
+
+} // namespace
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include "../src/filter_pattern.h"
+
+namespace {
+
+using refinery::FilterPattern;
+using refinery::FixedFilterPattern;
+
+/*
+ * Records the colors the pattern it's called with reports, and whether it
+ * was a FixedFilterPattern.
+ */
+struct RecordPattern {
+  unsigned int colors[16][2];
+  unsigned int filters;
+  bool fixed;
+
+  template<typename Pattern> void operator()(const Pattern& pattern) {
+    record(pattern);
+    fixed = false;
+  }
+
+  template<unsigned int Filters>
+  void operator()(const FixedFilterPattern<Filters>& pattern) {
+    record(pattern);
+    fixed = true;
+  }
+
+  template<typename Pattern> void record(const Pattern& pattern) {
+    filters = pattern.filters();
+    for (unsigned int row = 0; row < 16; row++) {
+      for (unsigned int col = 0; col < 2; col++) {
+        colors[row][col] = pattern.colorAtPoint(row, col);
+      }
+    }
+  }
+};
+
+void expectPattern(unsigned int filters, bool expectFixed)
+{
+  RecordPattern record;
+  refinery::withFilterPattern(filters, record);
+
+  EXPECT_EQ(filters, record.filters);
+  EXPECT_EQ(expectFixed, record.fixed) << std::hex << filters;
+
+  FilterPattern pattern(filters);
+  for (unsigned int row = 0; row < 16; row++) {
+    for (unsigned int col = 0; col < 2; col++) {
+      EXPECT_EQ(pattern.colorAtPoint(row, col), record.colors[row][col])
+        << std::hex << filters << std::dec << " " << row << "," << col;
+    }
+  }
+}
+
+TEST(FilterPatternTest, ColorAtPoint) {
+  FilterPattern pattern(0x61616161);
+  EXPECT_EQ(0u, pattern.colorAtPoint(0, 1)); // R
+  EXPECT_EQ(1u, pattern.colorAtPoint(0, 0)); // G
+  EXPECT_EQ(1u, pattern.colorAtPoint(1, 1)); // G
+  EXPECT_EQ(2u, pattern.colorAtPoint(1, 0)); // B
+  EXPECT_EQ(2u, pattern.colorAtPoint(3, 2)); // repeats
+}
+
+TEST(FilterPatternTest, BayerPatternsAreFixed) {
+  expectPattern(0x16161616, true);
+  expectPattern(0x61616161, true);
+  expectPattern(0x49494949, true);
+  expectPattern(0x94949494, true);
+}
+
+TEST(FilterPatternTest, OtherPatternsFallBack) {
+  expectPattern(0x16611661, false);
+  expectPattern(0x12121212, false);
+}
+
+} // namespace
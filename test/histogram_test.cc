@@ -50,7 +50,7 @@ TEST(HistogramTest, NPixels) {
   std::auto_ptr<refinery::RGBImage> rgbImage(createRgbImage());
 
   refinery::Histogram<refinery::RGBImage, 3> histogram(*rgbImage);
-  ASSERT_EQ(12, histogram.nPixels());
+  ASSERT_EQ(12u, histogram.nPixels());
 }
 
 TEST(HistogramTest, Coarseness15) {
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include "refinery/image_buffer.h"
+
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/image.h"
+
+namespace {
+
+bool isAligned(const void* p, std::size_t alignment)
+{
+  return reinterpret_cast<boost::uintptr_t>(p) % alignment == 0;
+}
+
+TEST(ImageBufferTest, Aligned) {
+  for (std::size_t size = 1; size < 1000; size += 37) {
+    refinery::ImageBuffer buffer(size, refinery::ImageBuffer::UNINITIALIZED);
+    EXPECT_EQ(size, buffer.size());
+    EXPECT_TRUE(isAligned(buffer.data(), refinery::ImageBuffer::Alignment));
+  }
+}
+
+TEST(ImageBufferTest, ZeroFill) {
+  // Big enough to be split among threads and use huge pages
+  const std::size_t size = 5 * 1024 * 1024 + 3;
+  refinery::ImageBuffer buffer(size);
+
+  const unsigned char* data = buffer.data();
+  std::size_t nonZero = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    if (data[i]) nonZero++;
+  }
+  EXPECT_EQ(0u, nonZero);
+}
+
+TEST(ImageBufferTest, Empty) {
+  refinery::ImageBuffer buffer;
+  EXPECT_EQ(0u, buffer.size());
+}
+
+TEST(ImageBufferTest, CopyIsDeep) {
+  refinery::ImageBuffer buffer(16);
+  std::memset(buffer.data(), 7, 16);
+
+  refinery::ImageBuffer copy(buffer);
+  EXPECT_NE(buffer.data(), copy.data());
+  EXPECT_EQ(0, std::memcmp(buffer.data(), copy.data(), 16));
+
+  refinery::ImageBuffer assigned(4);
+  assigned = buffer;
+  EXPECT_EQ(16u, assigned.size());
+  EXPECT_EQ(0, std::memcmp(buffer.data(), assigned.data(), 16));
+}
+
+TEST(ImageBufferTest, ImagePixelsAreAligned) {
+  refinery::InMemoryExifData exifData;
+  refinery::CameraData cameraData(
+      refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+  refinery::RGBImage image(
+      cameraData, 7, 5, refinery::ImageBuffer::UNINITIALIZED);
+  EXPECT_TRUE(isAligned(image.pixels(), refinery::ImageBuffer::Alignment));
+  EXPECT_EQ(image.pixels() + 35, image.pixelsEnd());
+
+  image.pixelAtPoint(4, 6)[2] = 12345;
+  refinery::RGBImage copy(image);
+  EXPECT_EQ(12345, copy.constPixelAtPoint(4, 6).at(2));
+}
+
+TEST(ImageBufferTest, FileBacked) {
+  refinery::ImageBuffer::setFileBackingThreshold(1024 * 1024);
+
+  refinery::ImageBuffer small(1024);
+  refinery::ImageBuffer big(3 * 1024 * 1024 + 5);
+  refinery::ImageBuffer uninitialized(
+      2 * 1024 * 1024, refinery::ImageBuffer::UNINITIALIZED);
+
+  refinery::ImageBuffer::setFileBackingThreshold(0);
+
+  EXPECT_FALSE(small.fileBacked());
+  ASSERT_TRUE(big.fileBacked());
+  EXPECT_TRUE(uninitialized.fileBacked());
+  EXPECT_TRUE(isAligned(big.data(), refinery::ImageBuffer::Alignment));
+
+  std::size_t nonZero = 0;
+  for (std::size_t i = 0; i < big.size(); i++) {
+    if (big.data()[i]) nonZero++;
+  }
+  EXPECT_EQ(0u, nonZero);
+
+  big.data()[big.size() - 1] = 42;
+  refinery::ImageBuffer copy(big); // threshold is off now
+  EXPECT_FALSE(copy.fileBacked());
+  EXPECT_EQ(42, copy.data()[big.size() - 1]);
+}
+
+TEST(ImageBufferTest, FileBackedImageNPixels) {
+  refinery::InMemoryExifData exifData;
+  refinery::CameraData cameraData(
+      refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+  refinery::ImageBuffer::setFileBackingThreshold(1);
+  refinery::GrayImage image(cameraData, 1000, 600);
+  refinery::ImageBuffer::setFileBackingThreshold(0);
+
+  EXPECT_EQ(600000u, image.nPixels());
+  image.pixelAtPoint(599, 999).value() = 7;
+  EXPECT_EQ(7, image.constPixelsEnd()[-1].value());
+}
+
+} // namespace
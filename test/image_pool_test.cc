@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "refinery/image_pool.h"
+
+#include <memory>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/image.h"
+#include "refinery/image_buffer.h"
+
+namespace {
+
+TEST(ImagePoolTest, SizeClass) {
+  EXPECT_EQ(64u, refinery::ImagePool::sizeClass(1));
+  EXPECT_EQ(64u, refinery::ImagePool::sizeClass(64));
+  EXPECT_EQ(72u, refinery::ImagePool::sizeClass(65));
+  EXPECT_EQ(1024u, refinery::ImagePool::sizeClass(1024));
+  EXPECT_EQ(1152u, refinery::ImagePool::sizeClass(1025));
+
+  for (std::size_t size = 1; size < 100000; size += 997) {
+    const std::size_t sizeClass = refinery::ImagePool::sizeClass(size);
+    EXPECT_LE(size, sizeClass);
+    EXPECT_LE(sizeClass - size, size / 8 + 64);
+  }
+}
+
+TEST(ImagePoolTest, RecycleBuffer) {
+  refinery::ImagePool pool(1024 * 1024);
+
+  unsigned char* data;
+  {
+    refinery::ImageBuffer buffer(
+        1000, refinery::ImageBuffer::UNINITIALIZED, &pool);
+    data = buffer.data();
+    EXPECT_EQ(0u, pool.idleBytes());
+  }
+  EXPECT_EQ(refinery::ImagePool::sizeClass(1000), pool.idleBytes());
+
+  // A slightly different size in the same class gets the same memory
+  refinery::ImageBuffer buffer(990, refinery::ImageBuffer::ZERO_FILL, &pool);
+  EXPECT_EQ(data, buffer.data());
+  EXPECT_EQ(990u, buffer.size());
+  EXPECT_EQ(0u, pool.idleBytes());
+  EXPECT_EQ(0, buffer.data()[989]);
+}
+
+TEST(ImagePoolTest, MaxBytes) {
+  refinery::ImagePool pool(1024);
+
+  {
+    refinery::ImageBuffer small(1000, refinery::ImageBuffer::ZERO_FILL, &pool);
+    refinery::ImageBuffer big(2000, refinery::ImageBuffer::ZERO_FILL, &pool);
+  }
+  EXPECT_EQ(1024u, pool.idleBytes()); // big was freed, not kept
+
+  pool.setMaxBytes(0);
+  EXPECT_EQ(0u, pool.idleBytes());
+}
+
+TEST(ImagePoolTest, ImagesShareBuffers) {
+  refinery::InMemoryExifData exifData;
+  refinery::CameraData cameraData(
+      refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+  refinery::ImagePool pool(1024 * 1024);
+
+  std::auto_ptr<refinery::GrayImage> image(new refinery::GrayImage(
+        cameraData, 100, 100, refinery::ImageBuffer::ZERO_FILL, &pool));
+  EXPECT_EQ(&pool, image->pool());
+  const refinery::GrayImage::PixelType* pixels = image->constPixels();
+  image.reset();
+
+  refinery::GrayImage image2(
+      cameraData, 100, 100, refinery::ImageBuffer::ZERO_FILL, &pool);
+  EXPECT_EQ(pixels, image2.constPixels());
+}
+
+} // namespace
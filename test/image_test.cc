@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "refinery/image.h"
+
+#include <stdexcept>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+
+namespace {
+
+class ImageTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+  }
+
+  refinery::CameraData cameraData() {
+    return refinery::CameraDataFactory::instance().getCameraData(exifData);
+  }
+
+  refinery::GrayImage grayImage(unsigned int filters) {
+    refinery::GrayImage image(cameraData(), 6, 5);
+    image.setFilters(filters);
+    for (unsigned int row = 0; row < 5; row++) {
+      for (unsigned int col = 0; col < 6; col++) {
+        image.pixelAtPoint(row, col)[0] = row * 10 + col;
+      }
+    }
+    return image;
+  }
+};
+
+TEST_F(ImageTest, MirrorPadMirrorsWithoutRepeatingTheEdge) {
+  const refinery::GrayImage image(grayImage(0x61616161));
+  refinery::GrayImage padded(image.profile(), 10, 9);
+  refinery::mirrorPad(image, 2, padded);
+
+  // Original (row, col) = row * 10 + col
+  const unsigned short expected[9][10] = {
+    { 22, 21, 20, 21, 22, 23, 24, 25, 24, 23 },
+    { 12, 11, 10, 11, 12, 13, 14, 15, 14, 13 },
+    { 2, 1, 0, 1, 2, 3, 4, 5, 4, 3 },
+    { 12, 11, 10, 11, 12, 13, 14, 15, 14, 13 },
+    { 22, 21, 20, 21, 22, 23, 24, 25, 24, 23 },
+    { 32, 31, 30, 31, 32, 33, 34, 35, 34, 33 },
+    { 42, 41, 40, 41, 42, 43, 44, 45, 44, 43 },
+    { 32, 31, 30, 31, 32, 33, 34, 35, 34, 33 },
+    { 22, 21, 20, 21, 22, 23, 24, 25, 24, 23 }
+  };
+  for (unsigned int row = 0; row < 9; row++) {
+    for (unsigned int col = 0; col < 10; col++) {
+      EXPECT_EQ(expected[row][col], padded.constPixelAtPoint(row, col).value())
+        << "(" << row << ", " << col << ")";
+    }
+  }
+}
+
+TEST_F(ImageTest, MirrorPadKeepsSensorColors) {
+  const unsigned int filters[] = {
+    0x16161616, 0x61616161, 0x49494949, 0x94949494, 0xb4b4b4b4
+  };
+  for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+    for (unsigned int border = 0; border < 5; border++) {
+      const refinery::GrayImage image(grayImage(filters[i]));
+      refinery::GrayImage padded(
+          image.profile(), 6 + 2 * border, 5 + 2 * border);
+      refinery::mirrorPad(image, border, padded);
+
+      for (unsigned int row = 0; row < padded.height(); row++) {
+        for (unsigned int col = 0; col < padded.width(); col++) {
+          const unsigned short value(
+              padded.constPixelAtPoint(row, col).value());
+          EXPECT_EQ(image.colorAtPoint(value / 10, value % 10),
+              padded.colorAtPoint(row, col))
+            << "filters " << filters[i] << ", border " << border
+            << ", (" << row << ", " << col << ")";
+        }
+      }
+    }
+  }
+}
+
+TEST_F(ImageTest, MirrorPadNeedsRoom) {
+  const refinery::GrayImage image(grayImage(0x61616161));
+
+  refinery::GrayImage tooSmall(image.profile(), 9, 9);
+  EXPECT_THROW(refinery::mirrorPad(image, 2, tooSmall),
+      std::invalid_argument);
+
+  // The border can't be mirrored from further than the opposite edge
+  refinery::GrayImage tooBig(image.profile(), 16, 15);
+  EXPECT_THROW(refinery::mirrorPad(image, 5, tooBig), std::invalid_argument);
+}
+
+} // namespace
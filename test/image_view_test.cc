@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "refinery/image_view.h"
+
+#include <sstream>
+#include <string>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/filters.h"
+#include "refinery/image.h"
+#include "refinery/output.h"
+
+namespace {
+
+class ImageViewTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+  }
+
+  refinery::CameraData cameraData() {
+    return refinery::CameraDataFactory::instance().getCameraData(exifData);
+  }
+};
+
+TEST_F(ImageViewTest, Crop) {
+  refinery::RGBImage image(cameraData(), 6, 4);
+  for (unsigned int row = 0; row < 4; row++) {
+    for (unsigned int col = 0; col < 6; col++) {
+      image.pixelAtPoint(row, col)[0] = row * 10 + col;
+    }
+  }
+
+  refinery::RGBImageView view(
+      image, refinery::Point(1, 2), refinery::Point(2, 3));
+  EXPECT_EQ(3u, view.width());
+  EXPECT_EQ(2u, view.height());
+  EXPECT_EQ(6, view.stride());
+  EXPECT_EQ(12, view.constPixelAtPoint(0, 0).at(0));
+  EXPECT_EQ(24, view.constPixelAtPoint(1, 2).at(0));
+
+  view.pixelAtPoint(1, 1)[0] = 999;
+  EXPECT_EQ(999, image.constPixelAtPoint(2, 3).at(0));
+
+  refinery::RGBImageView nested(
+      view, refinery::Point(1, 1), refinery::Point(1, 2));
+  EXPECT_EQ(refinery::Point(2, 3), nested.origin());
+  EXPECT_EQ(999, nested.constPixelAtPoint(0, 0).at(0));
+}
+
+TEST_F(ImageViewTest, ColorAtPointUsesImageCoordinates) {
+  refinery::GrayImage image(cameraData(), 6, 4);
+  image.setFilters(0x61616161);
+
+  refinery::ConstGrayImageView view(
+      image, refinery::Point(1, 1), refinery::Point(3, 5));
+  for (unsigned int row = 0; row < 3; row++) {
+    for (unsigned int col = 0; col < 5; col++) {
+      EXPECT_EQ(image.colorAtPoint(row + 1, col + 1),
+          view.colorAtPoint(row, col));
+    }
+  }
+}
+
+TEST_F(ImageViewTest, FilterOnlyTouchesView) {
+  refinery::GrayImage image(cameraData(), 6, 4);
+  image.setFilters(0x61616161);
+  for (unsigned int row = 0; row < 4; row++) {
+    for (unsigned int col = 0; col < 6; col++) {
+      image.pixelAtPoint(row, col).value() = 100;
+    }
+  }
+
+  refinery::GrayImageView view(
+      image, refinery::Point(1, 1), refinery::Point(2, 3));
+  const double multipliers[4] = { 2.0, 3.0, 4.0, 1.0 };
+  refinery::ScaleColorsFilter filter;
+  filter.filter(view, multipliers);
+
+  for (unsigned int row = 0; row < 4; row++) {
+    for (unsigned int col = 0; col < 6; col++) {
+      const bool inView = row >= 1 && row < 3 && col >= 1 && col < 4;
+      const unsigned short expected = inView
+        ? 100 * multipliers[image.colorAtPoint(row, col)]
+        : 100;
+      EXPECT_EQ(expected, image.constPixelAtPoint(row, col).value())
+        << "at row " << row << ", col " << col;
+    }
+  }
+}
+
+TEST_F(ImageViewTest, WriteCrop) {
+  refinery::RGBImage image(cameraData(), 6, 4);
+  image.pixelAtPoint(1, 2)[0] = 0x1234;
+  image.pixelAtPoint(2, 4)[2] = 0x5678;
+
+  refinery::ConstRGBImageView view(
+      image, refinery::Point(1, 2), refinery::Point(2, 3));
+
+  std::ostringstream out(std::ios::binary | std::ios::out);
+  refinery::ImageWriter writer;
+  writer.writeImage(view, out, 16);
+
+  std::string s(out.str());
+  ASSERT_EQ(std::string("P6\n3 2\n65535\n"), s.substr(0, 13));
+  ASSERT_EQ(13u + 3 * 2 * 6, s.size());
+  EXPECT_EQ(0x12, static_cast<unsigned char>(s.at(13)));
+  EXPECT_EQ(0x34, static_cast<unsigned char>(s.at(14)));
+  EXPECT_EQ(0x56, static_cast<unsigned char>(s.at(s.size() - 2)));
+  EXPECT_EQ(0x78, static_cast<unsigned char>(s.at(s.size() - 1)));
+}
+
+TEST_F(ImageViewTest, NPixelsDoesNotOverflow) {
+  refinery::RGBImage image(cameraData(), 1, 1);
+  refinery::RGBImageView view(
+      image.profile(), image.pixels(), 70000, 70000, 70000);
+  EXPECT_EQ(static_cast<std::size_t>(70000) * 70000, view.nPixels());
+}
+
+} // namespace
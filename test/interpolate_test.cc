@@ -1,14 +1,21 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <vector>
 
 #include "refinery/interpolate.h"
 
 #include "refinery/camera.h"
 #include "refinery/exif.h"
 #include "refinery/image.h"
+#include "refinery/image_view.h"
+#include "refinery/planar_image.h"
 
 namespace {
 
@@ -87,4 +94,676 @@ TEST(InterpolatorTest, AHDInterpolate) {
   }
 }
 
+class InterpolateIntoTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+  std::auto_ptr<refinery::GrayImage> grayImage;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+    grayImage.reset(new refinery::GrayImage(cameraData, 225, 75));
+    grayImage->setFilters(0x61616161);
+    std::copy(
+        &nikon_d5000_225x75_sample[0], &nikon_d5000_225x75_sample[225*75],
+        reinterpret_cast<unsigned short*>(grayImage->pixels()));
+  }
+
+  void expectSame(
+      const refinery::RGBImage& expected, const refinery::RGBImageView& actual)
+  {
+    ASSERT_EQ(expected.width(), actual.width());
+    ASSERT_EQ(expected.height(), actual.height());
+    for (unsigned int row = 0; row < expected.height(); row++) {
+      for (unsigned int col = 0; col < expected.width(); col++) {
+        const refinery::RGBImage::PixelType& e(
+            expected.constPixelAtPoint(row, col));
+        const refinery::RGBImage::PixelType& a(
+            actual.constPixelAtPoint(row, col));
+        ASSERT_EQ(e.r(), a.r()) << "(" << row << ", " << col << ")";
+        ASSERT_EQ(e.g(), a.g()) << "(" << row << ", " << col << ")";
+        ASSERT_EQ(e.b(), a.b()) << "(" << row << ", " << col << ")";
+      }
+    }
+  }
+
+  /*
+   * A padded border changes the border and leaves the rest alone. Border
+   * pixels then get their own sensor color the way interior pixels do:
+   * AHD copies it, and bilinear leaves it 0.
+   */
+  void testPaddedBorder(
+      refinery::Interpolator::Type type, unsigned int border,
+      bool copiesOwnColor)
+  {
+    refinery::Interpolator interpolator(type);
+    std::auto_ptr<refinery::RGBImage> averaged(
+        interpolator.interpolate(*grayImage));
+
+    interpolator.setPadsBorder(true);
+    EXPECT_TRUE(interpolator.padsBorder());
+    std::auto_ptr<refinery::RGBImage> padded(
+        interpolator.interpolate(*grayImage));
+
+    int nBorderDifferent = 0;
+    for (unsigned int row = 0; row < 75; row++) {
+      for (unsigned int col = 0; col < 225; col++) {
+        const refinery::RGBImage::PixelType& a(
+            averaged->constPixelAtPoint(row, col));
+        const refinery::RGBImage::PixelType& p(
+            padded->constPixelAtPoint(row, col));
+
+        const bool same =
+          a.r() == p.r() && a.g() == p.g() && a.b() == p.b();
+        const bool inBorder = row < border || row >= 75 - border
+          || col < border || col >= 225 - border;
+        if (!inBorder) {
+          ASSERT_TRUE(same) << "(" << row << ", " << col << ")";
+        } else {
+          if (!same) nBorderDifferent++;
+          ASSERT_EQ(copiesOwnColor
+              ? grayImage->constPixelAtPoint(row, col).value() : 0,
+              p.at(grayImage->colorAtPoint(row, col)))
+            << "(" << row << ", " << col << ")";
+        }
+      }
+    }
+    EXPECT_LT(0, nBorderDifferent);
+
+    refinery::Interpolator copy(interpolator);
+    EXPECT_TRUE(copy.padsBorder());
+  }
+
+  void testIntoImage(refinery::Interpolator::Type type)
+  {
+    refinery::Interpolator interpolator(type);
+    std::auto_ptr<refinery::RGBImage> expected(
+        interpolator.interpolate(*grayImage));
+
+    // Garbage in the destination must not matter
+    refinery::RGBImage rgbImage(grayImage->profile(), 225, 75);
+    std::fill(
+        reinterpret_cast<unsigned short*>(rgbImage.pixels()),
+        reinterpret_cast<unsigned short*>(rgbImage.pixels()) + 225 * 75 * 3,
+        0x1234);
+    interpolator.interpolate(*grayImage, rgbImage);
+
+    expectSame(*expected, refinery::RGBImageView(rgbImage));
+  }
+
+  /*
+   * Images too narrow or short for an algorithm's interior must still be
+   * interpolated: every value written, whatever garbage the destination
+   * held, with or without padding. One pixel wide or high, a pixel's own
+   * color must come through unchanged.
+   */
+  void testNarrowImages(refinery::Interpolator::Type type)
+  {
+    const unsigned int widths[] = { 1, 2, 3, 4, 5, 40 };
+    const unsigned int heights[] = { 1, 2, 3, 4, 5, 11, 40 };
+    refinery::Interpolator interpolator(type);
+
+    for (int pad = 0; pad < 2; pad++) {
+      interpolator.setPadsBorder(pad);
+      for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+          testNarrowImage(interpolator, widths[w], heights[h]);
+        }
+      }
+    }
+  }
+
+  void testNarrowImage(refinery::Interpolator& interpolator,
+      unsigned int width, unsigned int height)
+  {
+    refinery::GrayImage gray(grayImage->profile(), width, height);
+    gray.setFilters(grayImage->filters());
+    for (unsigned int row = 0; row < height; row++) {
+      for (unsigned int col = 0; col < width; col++) {
+        gray.pixelAtPoint(row, col)[0] =
+          grayImage->constPixelAtPoint(row, col).value();
+      }
+    }
+
+    refinery::RGBImage a(gray.profile(), width, height);
+    refinery::RGBImage b(gray.profile(), width, height);
+    std::fill(reinterpret_cast<unsigned short*>(a.pixels()),
+        reinterpret_cast<unsigned short*>(a.pixels()) + a.nPixels() * 3,
+        0x1234);
+    std::fill(reinterpret_cast<unsigned short*>(b.pixels()),
+        reinterpret_cast<unsigned short*>(b.pixels()) + b.nPixels() * 3,
+        0x4321);
+    interpolator.interpolate(gray, a);
+    interpolator.interpolate(gray, b);
+
+    const bool line = width == 1 || height == 1;
+    for (unsigned int row = 0; row < height; row++) {
+      for (unsigned int col = 0; col < width; col++) {
+        const refinery::RGBImage::PixelType& pa(a.constPixelAtPoint(row, col));
+        const refinery::RGBImage::PixelType& pb(b.constPixelAtPoint(row, col));
+
+        for (unsigned int c = 0; c < 3; c++) {
+          ASSERT_EQ(pa.at(c), pb.at(c)) << width << "x" << height
+            << (interpolator.padsBorder() ? " padded" : "")
+            << " (" << row << ", " << col << ")[" << c << "]";
+        }
+        if (line) {
+          ASSERT_EQ(gray.constPixelAtPoint(row, col).value(),
+              pa.at(gray.colorAtPoint(row, col))) << width << "x" << height
+            << " (" << row << ", " << col << ")";
+        }
+      }
+    }
+  }
+};
+
+TEST_F(InterpolateIntoTest, AHDIntoImage) {
+  testIntoImage(refinery::Interpolator::INTERPOLATE_AHD);
+}
+
+TEST_F(InterpolateIntoTest, BilinearIntoImage) {
+  testIntoImage(refinery::Interpolator::INTERPOLATE_BILINEAR);
+}
+
+TEST_F(InterpolateIntoTest, AHDNarrowImages) {
+  testNarrowImages(refinery::Interpolator::INTERPOLATE_AHD);
+}
+
+TEST_F(InterpolateIntoTest, BilinearNarrowImages) {
+  testNarrowImages(refinery::Interpolator::INTERPOLATE_BILINEAR);
+}
+
+TEST_F(InterpolateIntoTest, PPGNarrowImages) {
+  testNarrowImages(refinery::Interpolator::INTERPOLATE_PPG);
+}
+
+TEST_F(InterpolateIntoTest, MHCNarrowImages) {
+  testNarrowImages(refinery::Interpolator::INTERPOLATE_MHC);
+}
+
+TEST_F(InterpolateIntoTest, IntoView) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  std::auto_ptr<refinery::RGBImage> expected(
+      interpolator.interpolate(*grayImage));
+
+  refinery::RGBImage canvas(grayImage->profile(), 245, 85);
+  refinery::RGBImageView view(
+      canvas, refinery::Point(4, 10), refinery::Point(75, 225));
+  interpolator.interpolate(*grayImage, view);
+
+  expectSame(*expected, view);
+  EXPECT_EQ(0, canvas.constPixelAtPoint(3, 10).g());
+  EXPECT_EQ(0, canvas.constPixelAtPoint(4, 9).g());
+  EXPECT_EQ(0, canvas.constPixelAtPoint(4, 235).g());
+  EXPECT_EQ(0, canvas.constPixelAtPoint(79, 10).g());
+}
+
+TEST_F(InterpolateIntoTest, IntoRawBuffer) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  std::auto_ptr<refinery::RGBImage> expected(
+      interpolator.interpolate(*grayImage));
+
+  std::vector<unsigned short> values(225 * 75 * 3);
+  interpolator.interpolate(*grayImage, &values[0]);
+
+  EXPECT_TRUE(std::equal(values.begin(), values.end(),
+        reinterpret_cast<const unsigned short*>(expected->constPixels())));
+}
+
+TEST_F(InterpolateIntoTest, WrongSizeThrows) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  refinery::RGBImage rgbImage(grayImage->profile(), 224, 75);
+  EXPECT_THROW(interpolator.interpolate(*grayImage, rgbImage),
+      std::invalid_argument);
+}
+
+TEST_F(InterpolateIntoTest, ReusedScratchGivesSameResult) {
+  refinery::Interpolator fresh(refinery::Interpolator::INTERPOLATE_AHD);
+  refinery::Interpolator reusing(refinery::Interpolator::INTERPOLATE_AHD);
+  reusing.setReusesScratch(true);
+  EXPECT_TRUE(reusing.reusesScratch());
+
+  std::auto_ptr<refinery::RGBImage> expected(fresh.interpolate(*grayImage));
+
+  // A smaller image first, so the scratch tiles have stale contents
+  refinery::GrayImage smaller(grayImage->profile(), 100, 40);
+  std::auto_ptr<refinery::RGBImage> ignored(reusing.interpolate(smaller));
+
+  refinery::RGBImage rgbImage(
+      grayImage->profile(), 225, 75, refinery::ImageBuffer::UNINITIALIZED);
+  for (int i = 0; i < 2; i++) {
+    reusing.interpolate(*grayImage, rgbImage);
+    expectSame(*expected, refinery::RGBImageView(rgbImage));
+  }
+
+  refinery::Interpolator copy(reusing);
+  EXPECT_TRUE(copy.reusesScratch());
+  reusing.setReusesScratch(false);
+  EXPECT_FALSE(reusing.reusesScratch());
+}
+
+TEST_F(InterpolateIntoTest, AHDTileSizesGiveSameResult) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  EXPECT_EQ(0u, interpolator.tileHeight());
+  EXPECT_EQ(0u, interpolator.tileWidth());
+  std::auto_ptr<refinery::RGBImage> expected(
+      interpolator.interpolate(*grayImage));
+
+  // Scratch is reused, so it must be reallocated when the size changes
+  interpolator.setReusesScratch(true);
+
+  const unsigned int sizes[][2] = {
+    { 8, 8 }, { 13, 200 }, { 40, 17 }, { 16, 1024 }, { 256, 256 }
+  };
+  refinery::RGBImage rgbImage(
+      grayImage->profile(), 225, 75, refinery::ImageBuffer::UNINITIALIZED);
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    interpolator.setTileSize(sizes[i][0], sizes[i][1]);
+    interpolator.interpolate(*grayImage, rgbImage);
+    expectSame(*expected, refinery::RGBImageView(rgbImage));
+  }
+
+  refinery::Interpolator copy(interpolator);
+  EXPECT_EQ(256u, copy.tileHeight());
+  EXPECT_EQ(256u, copy.tileWidth());
+}
+
+TEST_F(InterpolateIntoTest, AHDFixedPointLabIsCloseToFloat) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  std::auto_ptr<refinery::RGBImage> expected(
+      interpolator.interpolate(*grayImage));
+
+  interpolator.setUsesFixedPointLab(true);
+  EXPECT_TRUE(interpolator.usesFixedPointLab());
+  std::auto_ptr<refinery::RGBImage> actual(
+      interpolator.interpolate(*grayImage));
+
+  // The quality delta: how many values changed, and by how much
+  const unsigned short* e(
+      reinterpret_cast<const unsigned short*>(expected->constPixels()));
+  const unsigned short* a(
+      reinterpret_cast<const unsigned short*>(actual->constPixels()));
+  const int nValues = 225 * 75 * 3;
+  int nDifferent = 0;
+  int maxDiff = 0;
+  double sumDiff = 0;
+  for (int i = 0; i < nValues; i++) {
+    const int diff = std::abs(e[i] - a[i]);
+    if (diff) nDifferent++;
+    maxDiff = std::max(maxDiff, diff);
+    sumDiff += diff;
+  }
+  RecordProperty("DifferentValues", nDifferent);
+  RecordProperty("MaxDiff", maxDiff);
+  RecordProperty("MeanDiffTimes1000",
+      static_cast<int>(1000 * sumDiff / nValues));
+
+  // Rare near-ties flip, and never by a visible amount
+  EXPECT_LT(0, nDifferent);
+  EXPECT_LT(nDifferent, nValues / 50);
+  EXPECT_LT(maxDiff, 256);
+  EXPECT_LT(sumDiff / nValues, 1.0);
+
+  refinery::Interpolator copy(interpolator);
+  EXPECT_TRUE(copy.usesFixedPointLab());
+}
+
+TEST_F(InterpolateIntoTest, AHDTileSizeMustFitItsMargins) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  EXPECT_THROW(interpolator.setTileSize(7, 256), std::invalid_argument);
+  EXPECT_THROW(interpolator.setTileSize(256, 0), std::invalid_argument);
+  interpolator.setTileSize(0, 0);
+  EXPECT_EQ(0u, interpolator.tileHeight());
+}
+
+TEST_F(InterpolateIntoTest, AHDPaddedBorder) {
+  testPaddedBorder(refinery::Interpolator::INTERPOLATE_AHD, 5, true);
+}
+
+TEST_F(InterpolateIntoTest, BilinearPaddedBorder) {
+  testPaddedBorder(refinery::Interpolator::INTERPOLATE_BILINEAR, 1, false);
+}
+
+TEST_F(InterpolateIntoTest, AHDPaddedBorderToPlanar) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  interpolator.setPadsBorder(true);
+  std::auto_ptr<refinery::RGBImage> expected(
+      interpolator.interpolate(*grayImage));
+  std::auto_ptr<refinery::PlanarRGBImage> planar(
+      interpolator.interpolateToPlanar(*grayImage));
+
+  refinery::RGBImage actual(grayImage->profile(), 225, 75);
+  refinery::interleave(*planar, actual);
+  expectSame(*expected, refinery::RGBImageView(actual));
+}
+
+
+/*
+ * dcraw's ppg_interpolate(), as dcraw writes it, after averaging the 3-pixel
+ * border as Interpolator does.
+ */
+std::vector<unsigned short> dcrawPpg(const refinery::GrayImage& gray)
+{
+  const int width = gray.width(), height = gray.height();
+  std::vector<unsigned short> rgb(width * height * 3);
+  unsigned short (*image)[3] = reinterpret_cast<unsigned short(*)[3]>(&rgb[0]);
+
+#define FC(row, col) gray.colorAtPoint(row, col)
+#define ABS(x) std::abs(x)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define LIM(x, min, max) MAX(min, MIN(x, max))
+#define ULIM(x, y, z) ((y) < (z) ? LIM(x, y, z) : LIM(x, z, y))
+#define CLIP(x) LIM(x, 0, 65535)
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      image[row * width + col][FC(row, col)] =
+        gray.constPixelAtPoint(row, col).value();
+      if (row >= 3 && row < height - 3 && col >= 3 && col < width - 3) {
+        continue;
+      }
+      unsigned int sum[3] = { 0, 0, 0 }, count[3] = { 0, 0, 0 };
+      for (int y = row - 1; y <= row + 1; y++) {
+        for (int x = col - 1; x <= col + 1; x++) {
+          if (y < 0 || y >= height || x < 0 || x >= width) continue;
+          sum[FC(y, x)] += gray.constPixelAtPoint(y, x).value();
+          count[FC(y, x)]++;
+        }
+      }
+      for (unsigned int c = 0; c < 3; c++) {
+        if (c != FC(row, col) && count[c]) {
+          image[row * width + col][c] = sum[c] / count[c];
+        }
+      }
+    }
+  }
+
+  const int dir[5] = { 1, width, -1, -width, 1 };
+  int row, col, diff[2] = { 0, 0 }, guess[2] = { 0, 0 }, c, d, i;
+  unsigned short (*pix)[3];
+
+  for (row = 3; row < height - 3; row++)
+    for (col = 3 + (FC(row, 3) & 1), c = FC(row, col); col < width - 3;
+        col += 2) {
+      pix = image + row * width + col;
+      for (i = 0; (d = dir[i]) > 0; i++) {
+        guess[i] = (pix[-d][1] + pix[0][c] + pix[d][1]) * 2
+          - pix[-2 * d][c] - pix[2 * d][c];
+        diff[i] = (ABS(pix[-2 * d][c] - pix[0][c]) +
+            ABS(pix[2 * d][c] - pix[0][c]) +
+            ABS(pix[-d][1] - pix[d][1])) * 3 +
+          (ABS(pix[3 * d][1] - pix[d][1]) +
+           ABS(pix[-3 * d][1] - pix[-d][1])) * 2;
+      }
+      d = dir[i = diff[0] > diff[1]];
+      pix[0][1] = ULIM(guess[i] >> 2, pix[d][1], pix[-d][1]);
+    }
+
+  for (row = 1; row < height - 1; row++)
+    for (col = 1 + (FC(row, 2) & 1), c = FC(row, col + 1); col < width - 1;
+        col += 2) {
+      pix = image + row * width + col;
+      for (i = 0; (d = dir[i]) > 0; c = 2 - c, i++)
+        pix[0][c] = CLIP((pix[-d][c] + pix[d][c] + 2 * pix[0][1]
+              - pix[-d][1] - pix[d][1]) >> 1);
+    }
+
+  for (row = 1; row < height - 1; row++)
+    for (col = 1 + (FC(row, 1) & 1), c = 2 - FC(row, col); col < width - 1;
+        col += 2) {
+      pix = image + row * width + col;
+      for (i = 0; (d = dir[i] + dir[i + 1]) > 0; i++) {
+        diff[i] = ABS(pix[-d][c] - pix[d][c]) +
+          ABS(pix[-d][1] - pix[0][1]) +
+          ABS(pix[d][1] - pix[0][1]);
+        guess[i] = pix[-d][c] + pix[d][c] + 2 * pix[0][1]
+          - pix[-d][1] - pix[d][1];
+      }
+      if (diff[0] != diff[1])
+        pix[0][c] = CLIP(guess[diff[0] > diff[1]] >> 1);
+      else
+        pix[0][c] = CLIP((guess[0] + guess[1]) >> 2);
+    }
+
+#undef FC
+#undef ABS
+#undef MIN
+#undef MAX
+#undef LIM
+#undef ULIM
+#undef CLIP
+
+  return rgb;
+}
+
+TEST_F(InterpolateIntoTest, PPGIntoImage) {
+  testIntoImage(refinery::Interpolator::INTERPOLATE_PPG);
+}
+
+TEST_F(InterpolateIntoTest, PPGMatchesDcraw) {
+  const unsigned int filters[] = {
+    0x61616161, 0x16161616, 0x49494949, 0x94949494
+  };
+  const unsigned int sizes[][2] = { { 225, 75 }, { 7, 7 }, { 40, 33 } };
+
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_PPG);
+
+  for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      const unsigned int width = sizes[s][0], height = sizes[s][1];
+      refinery::GrayImage gray(grayImage->profile(), width, height);
+      gray.setFilters(filters[f]);
+      for (unsigned int row = 0; row < height; row++) {
+        for (unsigned int col = 0; col < width; col++) {
+          gray.pixelAtPoint(row, col)[0] =
+            grayImage->constPixelAtPoint(row, col).value();
+        }
+      }
+
+      const std::vector<unsigned short> expected(dcrawPpg(gray));
+      std::vector<unsigned short> actual(width * height * 3);
+      interpolator.interpolate(gray, &actual[0]);
+
+      for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(expected[i], actual[i])
+          << "(" << i / 3 / width << ", " << i / 3 % width << ")["
+          << i % 3 << "] of " << width << "x" << height
+          << ", filters " << std::hex << filters[f];
+      }
+    }
+  }
+}
+
+TEST_F(InterpolateIntoTest, PPGToPlanar) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_PPG);
+  std::auto_ptr<refinery::RGBImage> expected(
+      interpolator.interpolate(*grayImage));
+  std::auto_ptr<refinery::PlanarRGBImage> planar(
+      interpolator.interpolateToPlanar(*grayImage));
+
+  refinery::RGBImage actual(grayImage->profile(), 225, 75);
+  refinery::interleave(*planar, actual);
+  expectSame(*expected, refinery::RGBImageView(actual));
+}
+
+
+/*
+ * Malvar, He and Cutler's filters, as the paper prints them (times 16), run
+ * as plain 5x5 convolutions.
+ */
+std::vector<unsigned short> referenceMhc(const refinery::GrayImage& gray)
+{
+  static const int gAtRB[5][5] = {
+    {  0,  0, -2,  0,  0 },
+    {  0,  0,  4,  0,  0 },
+    { -2,  4,  8,  4, -2 },
+    {  0,  0,  4,  0,  0 },
+    {  0,  0, -2,  0,  0 }
+  };
+  static const int rbAtGInRow[5][5] = { // for the row's other color
+    {  0,  0,  1,  0,  0 },
+    {  0, -2,  0, -2,  0 },
+    { -2,  8, 10,  8, -2 },
+    {  0, -2,  0, -2,  0 },
+    {  0,  0,  1,  0,  0 }
+  };
+  static const int rbAtGInColumn[5][5] = { // for the column's other color
+    {  0,  0, -2,  0,  0 },
+    {  0, -2,  8, -2,  0 },
+    {  1,  0, 10,  0,  1 },
+    {  0, -2,  8, -2,  0 },
+    {  0,  0, -2,  0,  0 }
+  };
+  static const int rbAtBR[5][5] = {
+    {  0,  0, -3,  0,  0 },
+    {  0,  4,  0,  4,  0 },
+    { -3,  0, 12,  0, -3 },
+    {  0,  4,  0,  4,  0 },
+    {  0,  0, -3,  0,  0 }
+  };
+
+  const int width = gray.width(), height = gray.height();
+  std::vector<unsigned short> rgb(width * height * 3);
+
+  for (int row = 2; row < height - 2; row++) {
+    for (int col = 2; col < width - 2; col++) {
+      const unsigned int ownC = gray.colorAtPoint(row, col);
+      for (unsigned int c = 0; c < 3; c++) {
+        const int (*filter)[5];
+        if (c == ownC) {
+          rgb[(row * width + col) * 3 + c] =
+            gray.constPixelAtPoint(row, col).value();
+          continue;
+        } else if (c == 1) {
+          filter = gAtRB;
+        } else if (ownC != 1) {
+          filter = rbAtBR;
+        } else if (gray.colorAtPoint(row, col + 1) == c) {
+          filter = rbAtGInRow;
+        } else {
+          filter = rbAtGInColumn;
+        }
+
+        int sum = 0;
+        for (int y = -2; y <= 2; y++) {
+          for (int x = -2; x <= 2; x++) {
+            sum += filter[y + 2][x + 2]
+              * gray.constPixelAtPoint(row + y, col + x).value();
+          }
+        }
+        rgb[(row * width + col) * 3 + c] =
+          std::max(0, std::min(65535, (sum + 8) >> 4));
+      }
+    }
+  }
+
+  return rgb;
+}
+
+TEST_F(InterpolateIntoTest, MHCIntoImage) {
+  testIntoImage(refinery::Interpolator::INTERPOLATE_MHC);
+}
+
+TEST_F(InterpolateIntoTest, MHCMatchesFilters) {
+  const unsigned int filters[] = {
+    0x61616161, 0x16161616, 0x49494949, 0x94949494
+  };
+
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_MHC);
+  refinery::Interpolator ahd(refinery::Interpolator::INTERPOLATE_AHD);
+
+  for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+    grayImage->setFilters(filters[f]);
+
+    const std::vector<unsigned short> expected(referenceMhc(*grayImage));
+    std::vector<unsigned short> actual(225 * 75 * 3);
+    interpolator.interpolate(*grayImage, &actual[0]);
+
+    // The 2-pixel border is averaged, as AHD averages its own
+    std::vector<unsigned short> averaged(225 * 75 * 3);
+    ahd.interpolate(*grayImage, &averaged[0]);
+
+    for (size_t i = 0; i < expected.size(); i++) {
+      const unsigned int row = i / 3 / 225, col = i / 3 % 225;
+      const bool inBorder = row < 2 || row >= 73 || col < 2 || col >= 223;
+      ASSERT_EQ(inBorder ? averaged[i] : expected[i], actual[i])
+        << "(" << row << ", " << col << ")[" << i % 3 << "], filters "
+        << std::hex << filters[f];
+    }
+  }
+}
+
+
+/*
+ * Checks that each missing color averages the 3x3 neighbors of that color,
+ * those beside the pixel weighing twice those on its corners, and that the
+ * pixel's own color is left 0. Integers round down.
+ */
+template<typename GrayImageType, typename RGBImageType>
+void testBilinearInterior(const refinery::GrayImage& source)
+{
+  const unsigned int filters[] = {
+    0x61616161, 0x16161616, 0x49494949, 0x94949494
+  };
+  const unsigned int width = source.width(), height = source.height();
+  const bool isInteger =
+    std::numeric_limits<typename GrayImageType::ValueType>::is_integer;
+
+  refinery::Interpolator interpolator(
+      refinery::Interpolator::INTERPOLATE_BILINEAR);
+
+  for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+    GrayImageType gray(source.profile(), width, height);
+    gray.setFilters(filters[f]);
+    for (unsigned int row = 0; row < height; row++) {
+      for (unsigned int col = 0; col < width; col++) {
+        gray.pixelAtPoint(row, col)[0] =
+          source.constPixelAtPoint(row, col).value();
+      }
+    }
+
+    std::auto_ptr<RGBImageType> rgb(interpolator.interpolate(gray));
+
+    for (unsigned int row = 1; row < height - 1; row++) {
+      for (unsigned int col = 1; col < width - 1; col++) {
+        const unsigned int ownC = gray.colorAtPoint(row, col);
+        for (unsigned int c = 0; c < 3; c++) {
+          double expected = 0;
+          if (c != ownC) {
+            unsigned int weights = 0;
+            for (int y = -1; y <= 1; y++) {
+              for (int x = -1; x <= 1; x++) {
+                if ((x || y) && gray.colorAtPoint(row + y, col + x) == c) {
+                  const unsigned int weight = 1 + (!x || !y);
+                  expected += weight
+                    * gray.constPixelAtPoint(row + y, col + x).value();
+                  weights += weight;
+                }
+              }
+            }
+            expected /= weights;
+          }
+          if (isInteger) expected = std::floor(expected);
+          ASSERT_NEAR(expected, rgb->constPixelAtPoint(row, col).at(c),
+              isInteger ? 0.0 : 0.1)
+            << "(" << row << ", " << col << ")[" << c << "], filters "
+            << std::hex << filters[f];
+        }
+      }
+    }
+  }
+}
+
+TEST_F(InterpolateIntoTest, BilinearAveragesNeighbors) {
+  testBilinearInterior<refinery::GrayImage, refinery::RGBImage>(*grayImage);
+}
+
+TEST_F(InterpolateIntoTest, BilinearAveragesNeighborsInFloat) {
+  testBilinearInterior<refinery::FloatGrayImage, refinery::FloatRGBImage>(
+      *grayImage);
+}
+
 }
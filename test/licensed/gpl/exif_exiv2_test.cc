@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2010 Adam Hooper
+ *
+ * This file is part of refinery (GPL portion).
+ *
+ * refinery (GPL portion) is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * refinery (GPL portion) is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with refinery (GPL portion).  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "refinery/exif_exiv2.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <exiv2/exif.hpp>
+
+namespace {
+
+class Exiv2ExifDataTest : public ::testing::Test {
+protected:
+  Exiv2::ExifData exiv2ExifData;
+
+  virtual void SetUp() {
+    exiv2ExifData["Exif.Image.Model"] = std::string("NIKON D5000");
+    exiv2ExifData["Exif.Image.ImageWidth"] = static_cast<uint16_t>(3008);
+    exiv2ExifData["Exif.Photo.ExposureTime"] = Exiv2::Rational(1, 250);
+  }
+};
+
+TEST_F(Exiv2ExifDataTest, HasKey) {
+  refinery::Exiv2ExifData exifData(exiv2ExifData);
+
+  EXPECT_TRUE(exifData.hasKey("Exif.Image.Model"));
+  EXPECT_TRUE(exifData.hasKey("Exif.Photo.ExposureTime"));
+  EXPECT_FALSE(exifData.hasKey("Exif.Image.Make"));
+}
+
+TEST_F(Exiv2ExifDataTest, GetValues) {
+  refinery::Exiv2ExifData exifData(exiv2ExifData);
+
+  EXPECT_EQ(std::string("NIKON D5000"), exifData.getString("Exif.Image.Model"));
+  EXPECT_EQ(3008, exifData.getInt("Exif.Image.ImageWidth"));
+  EXPECT_FLOAT_EQ(0.004f, exifData.getFloat("Exif.Photo.ExposureTime"));
+
+  std::vector<refinery::ExifData::byte> bytes;
+  exifData.getBytes("Exif.Image.ImageWidth", bytes);
+  ASSERT_EQ(2u, bytes.size());
+  EXPECT_EQ(0x0b, bytes[0]); // big-endian
+  EXPECT_EQ(0xc0, bytes[1]);
+}
+
+TEST_F(Exiv2ExifDataTest, CachedValuesRepeat) {
+  refinery::Exiv2ExifData exifData(exiv2ExifData);
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(std::string("NIKON D5000"),
+        exifData.getString("Exif.Image.Model"));
+    EXPECT_EQ(3008, exifData.getInt("Exif.Image.ImageWidth"));
+    EXPECT_EQ(3008.0f, exifData.getFloat("Exif.Image.ImageWidth"));
+  }
+}
+
+TEST_F(Exiv2ExifDataTest, MissingKeyThrows) {
+  refinery::Exiv2ExifData exifData(exiv2ExifData);
+
+  EXPECT_THROW(exifData.getString("Exif.Image.Make"), std::logic_error);
+  EXPECT_THROW(exifData.getInt("Exif.Image.Make"), std::logic_error);
+}
+
+TEST_F(Exiv2ExifDataTest, TagNumberSpelling) {
+  // Exiv2::ExifKey accepts a tag's number in place of its name
+  refinery::Exiv2ExifData exifData(exiv2ExifData);
+
+  EXPECT_TRUE(exifData.hasKey("Exif.Image.0x0110"));
+  EXPECT_EQ(std::string("NIKON D5000"),
+      exifData.getString("Exif.Image.0x0110"));
+  EXPECT_EQ(3008, exifData.getInt("Exif.Image.0x0100"));
+  EXPECT_FALSE(exifData.hasKey("Exif.Image.0x010f")); // Make
+}
+
+TEST_F(Exiv2ExifDataTest, ConcurrentLookups) {
+  refinery::Exiv2ExifData exifData(exiv2ExifData);
+
+  int nWrong = 0;
+#if _OPENMP
+#pragma omp parallel for reduction(+:nWrong)
+#endif /* _OPENMP */
+  for (int i = 0; i < 1000; i++) {
+    if (exifData.getInt("Exif.Image.ImageWidth") != 3008) nWrong++;
+    if (exifData.getString("Exif.Image.Model") != "NIKON D5000") nWrong++;
+  }
+
+  EXPECT_EQ(0, nWrong);
+}
+
+} // namespace
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "refinery/memory_stats.h"
+
+#include "refinery/image.h"
+#include "refinery/image_buffer.h"
+#include "refinery/image_pool.h"
+#include "refinery/image_tile.h"
+
+namespace {
+
+using refinery::MemoryStats;
+
+std::size_t currentBytes(MemoryStats::Category category)
+{
+  return MemoryStats::snapshot().categories[category].current;
+}
+
+TEST(MemoryStatsTest, CategoryNames) {
+  EXPECT_STREQ("images", MemoryStats::categoryName(MemoryStats::IMAGES));
+  EXPECT_STREQ("tiles", MemoryStats::categoryName(MemoryStats::TILES));
+  EXPECT_STREQ("decoders", MemoryStats::categoryName(MemoryStats::DECODERS));
+  EXPECT_STREQ("caches", MemoryStats::categoryName(MemoryStats::CACHES));
+}
+
+TEST(MemoryStatsTest, CounterCountsAndPeaks) {
+  const MemoryStats before(MemoryStats::snapshot());
+  MemoryStats::resetPeaks();
+
+  {
+    MemoryStats::Counter counter(MemoryStats::DECODERS, 1000);
+    counter.resize(3000);
+    counter.resize(2000);
+
+    MemoryStats::Counter copy(counter);
+
+    const MemoryStats during(MemoryStats::snapshot());
+    EXPECT_EQ(before.categories[MemoryStats::DECODERS].current + 4000,
+        during.categories[MemoryStats::DECODERS].current);
+    EXPECT_EQ(before.total.current + 4000, during.total.current);
+    EXPECT_EQ(before.total.current + 4000, during.total.peak);
+  }
+
+  const MemoryStats after(MemoryStats::snapshot());
+  EXPECT_EQ(before.categories[MemoryStats::DECODERS].current,
+      after.categories[MemoryStats::DECODERS].current);
+  EXPECT_EQ(before.total.current, after.total.current);
+
+  MemoryStats::resetPeaks();
+  EXPECT_EQ(after.total.current, MemoryStats::snapshot().total.peak);
+}
+
+TEST(MemoryStatsTest, ImageBuffersAreImages) {
+  const std::size_t before = currentBytes(MemoryStats::IMAGES);
+  {
+    refinery::ImageBuffer buffer(100000, refinery::ImageBuffer::UNINITIALIZED);
+    EXPECT_EQ(before + 100000, currentBytes(MemoryStats::IMAGES));
+  }
+  EXPECT_EQ(before, currentBytes(MemoryStats::IMAGES));
+}
+
+TEST(MemoryStatsTest, IdlePoolBuffersAreCaches) {
+  const std::size_t capacity = refinery::ImagePool::sizeClass(100000);
+  const std::size_t beforeImages = currentBytes(MemoryStats::IMAGES);
+  const std::size_t beforeCaches = currentBytes(MemoryStats::CACHES);
+
+  refinery::ImagePool pool(1024 * 1024);
+  {
+    refinery::ImageBuffer buffer(
+        100000, refinery::ImageBuffer::UNINITIALIZED, &pool);
+    EXPECT_EQ(beforeImages + capacity, currentBytes(MemoryStats::IMAGES));
+    EXPECT_EQ(beforeCaches, currentBytes(MemoryStats::CACHES));
+  }
+  EXPECT_EQ(beforeImages, currentBytes(MemoryStats::IMAGES));
+  EXPECT_EQ(beforeCaches + capacity, currentBytes(MemoryStats::CACHES));
+
+  pool.clear();
+  EXPECT_EQ(beforeCaches, currentBytes(MemoryStats::CACHES));
+}
+
+TEST(MemoryStatsTest, ImageTilesAreTiles) {
+  typedef refinery::ImageTile<refinery::RGBImage> TileType;
+
+  const std::size_t before = currentBytes(MemoryStats::TILES);
+  {
+    TileType tile(refinery::Point(100, 100), refinery::Point(0, 0),
+        refinery::Point(10, 20), 0, 0);
+    EXPECT_EQ(before + 10 * 20 * sizeof(TileType::PixelType),
+        currentBytes(MemoryStats::TILES));
+  }
+  EXPECT_EQ(before, currentBytes(MemoryStats::TILES));
+}
+
+} // namespace
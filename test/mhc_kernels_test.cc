@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "../src/mhc_kernels.h"
+
+#include <vector>
+
+#include "row_kernels_test.h"
+
+namespace {
+
+using refinery::MHCKernels;
+
+class MHCKernelsTest : public refinery_test::RowKernelsTest {
+protected:
+  MHCKernelsTest() : RowKernelsTest(2345) {}
+
+public:
+  /*
+   * Runs one kernel, picked by which, for the given instruction set.
+   */
+  std::vector<unsigned short> run(
+      const MHCKernels& kernels, int which, unsigned int c) const {
+    std::vector<unsigned short> out(rgb);
+    if (which == 0) {
+      kernels.redBluePixels(&gray[offset(Row, Left, 1)], Width,
+          &out[offset(Row, Left, 3)], c, N);
+    } else {
+      kernels.greenPixels(&gray[offset(Row, Left, 1)], Width,
+          &out[offset(Row, Left, 3)], c, N);
+    }
+    return out;
+  }
+};
+
+TEST_F(MHCKernelsTest, RedBluePixels) {
+  expectAllSetsSameAsScalar(&MHCKernelsTest::run, 0);
+}
+
+TEST_F(MHCKernelsTest, GreenPixels) {
+  expectAllSetsSameAsScalar(&MHCKernelsTest::run, 1);
+}
+
+TEST_F(MHCKernelsTest, ActiveFollowsAHDKernels) {
+  expectActiveFollowsAHDKernels<MHCKernels>();
+}
+
+} // namespace
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include "refinery/planar_image.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <boost/cstdint.hpp>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/filters.h"
+#include "refinery/gamma.h"
+#include "refinery/histogram.h"
+#include "refinery/image.h"
+#include "refinery/image_buffer.h"
+#include "refinery/interpolate.h"
+
+namespace {
+
+#include "files/nikon_d5000_225x75_sample.h"
+
+class PlanarImageTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+  std::auto_ptr<refinery::GrayImage> grayImage;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+    grayImage.reset(new refinery::GrayImage(cameraData, 225, 75));
+    grayImage->setFilters(0x61616161);
+    std::copy(
+        &nikon_d5000_225x75_sample[0], &nikon_d5000_225x75_sample[225*75],
+        reinterpret_cast<unsigned short*>(grayImage->pixels()));
+  }
+
+  void expectSame(
+      const refinery::RGBImage& expected,
+      const refinery::PlanarRGBImage& actual) {
+    ASSERT_EQ(expected.width(), actual.width());
+    ASSERT_EQ(expected.height(), actual.height());
+
+    for (unsigned int row = 0; row < expected.height(); row++) {
+      for (unsigned int col = 0; col < expected.width(); col++) {
+        for (unsigned int c = 0; c < 3; c++) {
+          ASSERT_EQ(expected.constPixelAtPoint(row, col).at(c),
+              actual.constPlaneRow(c, row)[col])
+            << "at row " << row << ", col " << col << ", color " << c;
+        }
+      }
+    }
+  }
+};
+
+TEST_F(PlanarImageTest, RowsAreAligned) {
+  refinery::PlanarRGBImage image(grayImage->profile(), 225, 75);
+  EXPECT_LE(225u, image.rowStride());
+  for (unsigned int c = 0; c < 3; c++) {
+    for (unsigned int row = 0; row < 75; row++) {
+      EXPECT_EQ(0u, reinterpret_cast<boost::uintptr_t>(
+            image.constPlaneRow(c, row)) % refinery::ImageBuffer::Alignment);
+    }
+  }
+}
+
+TEST_F(PlanarImageTest, InterleaveRoundTrip) {
+  refinery::Interpolator interpolator(
+      refinery::Interpolator::INTERPOLATE_BILINEAR);
+  std::auto_ptr<refinery::RGBImage> rgbImage(
+      interpolator.interpolate(*grayImage));
+
+  refinery::PlanarRGBImage planar(rgbImage->profile(), 225, 75);
+  refinery::deinterleave(*rgbImage, planar);
+  expectSame(*rgbImage, planar);
+
+  refinery::RGBImage back(rgbImage->profile(), 225, 75);
+  refinery::interleave(planar, back);
+  expectSame(back, planar);
+}
+
+TEST_F(PlanarImageTest, AHDInterpolateToPlanar) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  std::auto_ptr<refinery::RGBImage> rgbImage(
+      interpolator.interpolate(*grayImage));
+  std::auto_ptr<refinery::PlanarRGBImage> planar(
+      interpolator.interpolateToPlanar(*grayImage));
+
+  expectSame(*rgbImage, *planar);
+}
+
+TEST_F(PlanarImageTest, FiltersMatchInterleaved) {
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  std::auto_ptr<refinery::RGBImage> rgbImage(
+      interpolator.interpolate(*grayImage));
+  std::auto_ptr<refinery::PlanarRGBImage> planar(
+      interpolator.interpolateToPlanar(*grayImage));
+
+  refinery::ConvertToRgbFilter rgbFilter;
+  rgbFilter.filter(*rgbImage);
+  rgbFilter.filter(*planar);
+  expectSame(*rgbImage, *planar);
+
+  refinery::Histogram<refinery::RGBImage, 3> histogram(*rgbImage);
+  refinery::Histogram<refinery::PlanarRGBImage, 3> planarHistogram(*planar);
+  ASSERT_EQ(histogram.nSlots(), planarHistogram.nSlots());
+  for (unsigned int c = 0; c < 3; c++) {
+    for (unsigned int slot = 0; slot < histogram.nSlots(); slot++) {
+      ASSERT_EQ(histogram.count(c, slot), planarHistogram.count(c, slot));
+    }
+  }
+
+  refinery::GammaCurve<unsigned short> gammaCurve(histogram);
+  refinery::GammaFilter gammaFilter;
+  gammaFilter.filter(*rgbImage, gammaCurve);
+  gammaFilter.filter(*planar, gammaCurve);
+  expectSame(*rgbImage, *planar);
+}
+
+} // namespace
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include "../src/ppg_kernels.h"
+
+#include <vector>
+
+#include "row_kernels_test.h"
+
+namespace {
+
+using refinery::PPGKernels;
+
+class PPGKernelsTest : public refinery_test::RowKernelsTest {
+protected:
+  PPGKernelsTest() : RowKernelsTest(1234) {}
+
+public:
+  /*
+   * Runs one kernel, picked by which, for the given instruction set.
+   */
+  std::vector<unsigned short> run(
+      const PPGKernels& kernels, int which, unsigned int c) const {
+    std::vector<unsigned short> out(rgb);
+    switch (which) {
+      case 0:
+        kernels.green(&gray[offset(Row, Left, 1)], Width,
+            &out[offset(Row, Left, 3)], c, N);
+        break;
+      case 1:
+        kernels.fillGreenPixels(&gray[offset(Row, Left, 1)],
+            &out[offset(Row, Left, 3)], Width * 3, c, N);
+        break;
+      default:
+        kernels.fillRedBluePixels(&out[offset(Row, Left, 3)], Width * 3, c,
+            N);
+    }
+    return out;
+  }
+};
+
+TEST_F(PPGKernelsTest, Green) {
+  expectAllSetsSameAsScalar(&PPGKernelsTest::run, 0);
+}
+
+TEST_F(PPGKernelsTest, FillGreenPixels) {
+  expectAllSetsSameAsScalar(&PPGKernelsTest::run, 1);
+}
+
+TEST_F(PPGKernelsTest, FillRedBluePixels) {
+  expectAllSetsSameAsScalar(&PPGKernelsTest::run, 2);
+}
+
+TEST_F(PPGKernelsTest, ActiveFollowsAHDKernels) {
+  expectActiveFollowsAHDKernels<PPGKernels>();
+}
+
+} // namespace
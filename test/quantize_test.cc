@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include "refinery/quantize.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/filters.h"
+#include "refinery/image.h"
+#include "refinery/interpolate.h"
+
+namespace {
+
+#include "files/nikon_d5000_225x75_sample.h"
+
+class QuantizeTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+  std::auto_ptr<refinery::GrayImage> grayImage;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+    grayImage.reset(new refinery::GrayImage(cameraData, 225, 75));
+    grayImage->setFilters(0x61616161);
+    std::copy(
+        &nikon_d5000_225x75_sample[0], &nikon_d5000_225x75_sample[225*75],
+        reinterpret_cast<unsigned short*>(grayImage->pixels()));
+  }
+};
+
+TEST_F(QuantizeTest, RoundTrip) {
+  refinery::FloatGrayImage floatImage(grayImage->profile(), 225, 75);
+  refinery::toFloat(*grayImage, floatImage);
+  EXPECT_FLOAT_EQ(grayImage->constPixelAtPoint(10, 20).value(),
+      floatImage.constPixelAtPoint(10, 20).value());
+
+  refinery::GrayImage back(grayImage->profile(), 225, 75);
+  refinery::quantize(floatImage, back);
+  EXPECT_TRUE(std::equal(
+        reinterpret_cast<const unsigned short*>(grayImage->constPixels()),
+        reinterpret_cast<const unsigned short*>(grayImage->constPixelsEnd()),
+        reinterpret_cast<const unsigned short*>(back.constPixels())));
+}
+
+TEST_F(QuantizeTest, RoundsAndClamps) {
+  refinery::FloatRGBImage floatImage(grayImage->profile(), 2, 1);
+  floatImage.pixelAtPoint(0, 0).r() = -3.2f;
+  floatImage.pixelAtPoint(0, 0).g() = 1.4f;
+  floatImage.pixelAtPoint(0, 0).b() = 1.5f;
+  floatImage.pixelAtPoint(0, 1).r() = 65534.6f;
+  floatImage.pixelAtPoint(0, 1).g() = 70000.0f;
+  floatImage.pixelAtPoint(0, 1).b() = 0.0f;
+
+  refinery::RGBImage image(grayImage->profile(), 2, 1);
+  refinery::quantize(floatImage, image);
+  EXPECT_EQ(0, image.constPixelAtPoint(0, 0).r());
+  EXPECT_EQ(1, image.constPixelAtPoint(0, 0).g());
+  EXPECT_EQ(2, image.constPixelAtPoint(0, 0).b());
+  EXPECT_EQ(65535, image.constPixelAtPoint(0, 1).r());
+  EXPECT_EQ(65535, image.constPixelAtPoint(0, 1).g());
+  EXPECT_EQ(0, image.constPixelAtPoint(0, 1).b());
+}
+
+TEST_F(QuantizeTest, ScaleKeepsHeadroom) {
+  refinery::FloatGrayImage floatImage(grayImage->profile(), 2, 1);
+  floatImage.pixelAtPoint(0, 0).value() = 40000.0f;
+  floatImage.pixelAtPoint(0, 1).value() = 40000.0f;
+
+  const double multipliers[4] = { 2.0, 2.0, 2.0, 2.0 };
+  refinery::ScaleColorsFilter filter;
+  filter.filter(floatImage, multipliers);
+
+  EXPECT_FLOAT_EQ(80000.0f, floatImage.constPixelAtPoint(0, 0).value());
+  EXPECT_FLOAT_EQ(80000.0f, floatImage.constPixelAtPoint(0, 1).value());
+}
+
+TEST_F(QuantizeTest, FloatPipelineMatches16Bit) {
+  refinery::FloatGrayImage floatGray(grayImage->profile(), 225, 75);
+  refinery::toFloat(*grayImage, floatGray);
+
+  refinery::ScaleColorsFilter scaleFilter;
+  scaleFilter.filter(*grayImage);
+  scaleFilter.filter(floatGray);
+
+  refinery::Interpolator interpolator(
+      refinery::Interpolator::INTERPOLATE_BILINEAR);
+  std::auto_ptr<refinery::RGBImage> rgb(interpolator.interpolate(*grayImage));
+  std::auto_ptr<refinery::FloatRGBImage> floatRgb(
+      interpolator.interpolate(floatGray));
+
+  refinery::ConvertToRgbFilter rgbFilter;
+  rgbFilter.filter(*rgb);
+  rgbFilter.filter(*floatRgb);
+
+  refinery::RGBImage quantized(grayImage->profile(), 225, 75);
+  refinery::quantize(*floatRgb, quantized);
+
+  // The 16-bit chain truncates at every step; the float chain rounds once
+  int maxDiff = 0;
+  for (unsigned int row = 0; row < 75; row++) {
+    for (unsigned int col = 0; col < 225; col++) {
+      for (unsigned int c = 0; c < 3; c++) {
+        const int diff = std::abs(
+            rgb->constPixelAtPoint(row, col).at(c)
+            - quantized.constPixelAtPoint(row, col).at(c));
+        maxDiff = std::max(maxDiff, diff);
+      }
+    }
+  }
+  EXPECT_LE(maxDiff, 4);
+}
+
+TEST_F(QuantizeTest, AHDRejectsFloat) {
+  refinery::FloatGrayImage floatGray(grayImage->profile(), 225, 75);
+  refinery::Interpolator interpolator(refinery::Interpolator::INTERPOLATE_AHD);
+  EXPECT_THROW(interpolator.interpolate(floatGray), std::invalid_argument);
+}
+
+}
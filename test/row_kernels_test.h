@@ -0,0 +1,106 @@
+#ifndef _REFINERY_TEST_ROW_KERNELS_TEST_H
+#define _REFINERY_TEST_ROW_KERNELS_TEST_H
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "../src/ahd_kernels.h"
+
+namespace refinery_test {
+
+/*
+ * A fixture for row kernels compiled per instruction set, as AHDKernels
+ * describes: it runs every supported instruction set's kernels on the same
+ * random input and expects the scalar kernels' output, value for value.
+ *
+ * The input is a few rows of gray values and of RGB values (what the
+ * kernels don't write must come through unchanged). Kernels work on row
+ * Row, from column Left.
+ */
+class RowKernelsTest : public ::testing::Test {
+protected:
+  typedef refinery::AHDKernels AHDKernels;
+
+  static const int Width = 301; // odd, so no vector width divides it
+  static const int Height = 7;
+  static const int Row = 3; // the row the kernels work on
+  static const int N = 146; // pixels per call, at every second column
+  static const int Left = 4;
+
+  std::vector<unsigned short> gray;
+  std::vector<unsigned short> rgb;
+
+  explicit RowKernelsTest(unsigned int seed) : mSeed(seed) {}
+
+  virtual void SetUp() {
+    std::srand(mSeed);
+
+    gray.resize(Width * Height);
+    for (size_t i = 0; i < gray.size(); i++) gray[i] = randomValue();
+
+    rgb.resize(Width * Height * 3);
+    for (size_t i = 0; i < rgb.size(); i++) rgb[i] = randomValue();
+  }
+
+  // Mostly extremes and mid-range, where rounding and overflow show up
+  static unsigned short randomValue() {
+    switch (std::rand() % 4) {
+      case 0: return 0xffff - std::rand() % 16;
+      case 1: return std::rand() % 16;
+      default: return std::rand() & 0xffff;
+    }
+  }
+
+  static int offset(int row, int col, int nColors) {
+    return (row * Width + col) * nColors;
+  }
+
+  /*
+   * Calls run(kernels, which, c) with each supported instruction set's
+   * kernels, for c of 0 and 2, and expects the scalar kernels' output.
+   */
+  template<typename Kernels, typename Test, typename Values>
+  void expectAllSetsSameAsScalar(
+      Values (Test::*run)(const Kernels&, int, unsigned int) const,
+      int which) const
+  {
+    const Test& test(static_cast<const Test&>(*this));
+
+    for (unsigned int c = 0; c <= 2; c += 2) {
+      const Values ref((test.*run)(
+            Kernels::forInstructionSet(AHDKernels::SCALAR), which, c));
+
+      for (int set = 1; set < AHDKernels::NInstructionSets; set++) {
+        const AHDKernels::InstructionSet s(
+            static_cast<AHDKernels::InstructionSet>(set));
+        if (!AHDKernels::supported(s)) continue;
+
+        EXPECT_TRUE((test.*run)(Kernels::forInstructionSet(s), which, c)
+            == ref) << "instruction set " << set << ", " << c;
+      }
+    }
+  }
+
+  /*
+   * Expects Kernels::active() to follow AHDKernels::select().
+   */
+  template<typename Kernels>
+  static void expectActiveFollowsAHDKernels() {
+    AHDKernels::select(AHDKernels::SCALAR);
+    EXPECT_EQ(&Kernels::forInstructionSet(AHDKernels::SCALAR),
+        &Kernels::active());
+
+    AHDKernels::select(AHDKernels::best());
+    EXPECT_EQ(&Kernels::forInstructionSet(AHDKernels::best()),
+        &Kernels::active());
+  }
+
+private:
+  unsigned int mSeed;
+};
+
+} // namespace refinery_test
+
+#endif /* _REFINERY_TEST_ROW_KERNELS_TEST_H */
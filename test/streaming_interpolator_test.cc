@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "refinery/streaming_interpolator.h"
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/image.h"
+#include "refinery/interpolate.h"
+
+namespace {
+
+#include "files/nikon_d5000_225x75_sample.h"
+
+class StreamingInterpolatorTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+  std::auto_ptr<refinery::GrayImage> grayImage;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    setGrayImage(225, 75, 0, 0, 0x61616161);
+  }
+
+  /*
+   * Crops the sample, and pretends its sensor is laid out as filters says.
+   */
+  void setGrayImage(
+      unsigned int width, unsigned int height, unsigned int top,
+      unsigned int left, unsigned int filters)
+  {
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+
+    grayImage.reset(new refinery::GrayImage(cameraData, width, height));
+    grayImage->setFilters(filters);
+    unsigned short* out(reinterpret_cast<unsigned short*>(grayImage->pixels()));
+    for (unsigned int row = 0; row < height; row++) {
+      const unsigned short* in(&nikon_d5000_225x75_sample[
+          (top + row) * 225 + left]);
+      std::copy(in, in + width, out + row * width);
+    }
+  }
+
+  const unsigned short* grayRow(unsigned int row) {
+    return &grayImage->constPixelsAtPoint(row, 0)[0].value();
+  }
+
+  std::vector<unsigned short> interpolate(bool fixedPointLab) {
+    refinery::Interpolator interpolator(
+        refinery::Interpolator::INTERPOLATE_AHD);
+    interpolator.setUsesFixedPointLab(fixedPointLab);
+    std::vector<unsigned short> ret(grayImage->nPixels() * 3);
+    interpolator.interpolate(*grayImage, &ret[0]);
+    return ret;
+  }
+
+  std::vector<unsigned short> stream(bool fixedPointLab) {
+    const unsigned int width = grayImage->width();
+    const unsigned int height = grayImage->height();
+
+    refinery::StreamingInterpolator interpolator(
+        grayImage->profile(), width, height, fixedPointLab);
+    std::vector<unsigned short> ret(width * height * 3);
+
+    unsigned int nPopped = 0;
+    for (unsigned int row = 0; row < height; row++) {
+      interpolator.pushRow(grayRow(row));
+      while (interpolator.popRow(&ret[nPopped * width * 3])) {
+        nPopped++;
+      }
+    }
+    EXPECT_EQ(height, nPopped);
+    EXPECT_FALSE(interpolator.popRow(&ret[0]));
+
+    return ret;
+  }
+
+  void expectSameAsInterpolator(bool fixedPointLab) {
+    const std::vector<unsigned short> expected(interpolate(fixedPointLab));
+    const std::vector<unsigned short> actual(stream(fixedPointLab));
+
+    const unsigned int width = grayImage->width();
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_EQ(expected[i], actual[i])
+        << "(" << i / 3 / width << ", " << i / 3 % width << ")["
+        << i % 3 << "] of " << width << "x" << grayImage->height();
+    }
+  }
+};
+
+TEST_F(StreamingInterpolatorTest, SameAsInterpolator) {
+  expectSameAsInterpolator(false);
+}
+
+TEST_F(StreamingInterpolatorTest, SameAsInterpolatorWithFixedPointLab) {
+  expectSameAsInterpolator(true);
+}
+
+TEST_F(StreamingInterpolatorTest, SameAsInterpolatorForOtherSizes) {
+  const unsigned int sizes[][2] = {
+    { 11, 11 }, { 12, 13 }, { 40, 10 }, { 10, 40 }, { 224, 74 }
+  };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    setGrayImage(sizes[i][0], sizes[i][1], 1, 1, 0x16161616);
+    expectSameAsInterpolator(false);
+  }
+}
+
+TEST_F(StreamingInterpolatorTest, SameAsInterpolatorForOtherPatterns) {
+  const unsigned int filters[] = { 0x16161616, 0x49494949, 0x94949494 };
+  for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+    setGrayImage(100, 40, 7, 30, filters[i]);
+    expectSameAsInterpolator(false);
+  }
+}
+
+TEST_F(StreamingInterpolatorTest, RowsAreReadyFiveRowsLater) {
+  refinery::StreamingInterpolator interpolator(
+      grayImage->profile(), 225, 75);
+  std::vector<unsigned short> rgbRow(225 * 3);
+
+  for (unsigned int row = 0; row < 6; row++) {
+    EXPECT_FALSE(interpolator.popRow(&rgbRow[0]));
+    interpolator.pushRow(grayRow(row));
+  }
+  EXPECT_TRUE(interpolator.popRow(&rgbRow[0]));
+  EXPECT_FALSE(interpolator.popRow(&rgbRow[0]));
+
+  for (unsigned int row = 6; row < 75; row++) {
+    interpolator.pushRow(grayRow(row));
+    EXPECT_TRUE(interpolator.popRow(&rgbRow[0]));
+    if (row < 74) {
+      EXPECT_FALSE(interpolator.popRow(&rgbRow[0]));
+    }
+  }
+  EXPECT_EQ(75u, interpolator.rowsPushed());
+  EXPECT_EQ(70u, interpolator.rowsPopped());
+
+  // The last rows come out once the last row is in
+  for (unsigned int row = 70; row < 75; row++) {
+    EXPECT_TRUE(interpolator.popRow(&rgbRow[0]));
+  }
+  EXPECT_FALSE(interpolator.popRow(&rgbRow[0]));
+  EXPECT_EQ(75u, interpolator.rowsPopped());
+}
+
+TEST_F(StreamingInterpolatorTest, PushBeforePoppingThrows) {
+  refinery::StreamingInterpolator interpolator(
+      grayImage->profile(), 225, 75);
+  for (unsigned int row = 0; row < 6; row++) {
+    interpolator.pushRow(grayRow(row));
+  }
+  EXPECT_THROW(interpolator.pushRow(grayRow(6)), std::logic_error);
+}
+
+TEST_F(StreamingInterpolatorTest, PushPastTheLastRowThrows) {
+  refinery::StreamingInterpolator interpolator(grayImage->profile(), 225, 3);
+  std::vector<unsigned short> rgbRow(225 * 3);
+  for (unsigned int row = 0; row < 3; row++) {
+    interpolator.pushRow(grayRow(row));
+  }
+  while (interpolator.popRow(&rgbRow[0])) {}
+  EXPECT_THROW(interpolator.pushRow(grayRow(3)), std::logic_error);
+}
+
+} // namespace
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "../src/tile_codec.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+#include "files/nikon_d5000_225x75_sample.h"
+
+void expectRoundTrip(
+    const std::vector<unsigned short>& values, int width, int height,
+    unsigned int nColors, int step)
+{
+  std::vector<unsigned char> encoded;
+  refinery::TileCodec::encode(
+      &values[0], width, height, nColors, step, encoded);
+
+  std::vector<unsigned short> decoded(values.size(), 0xdead);
+  refinery::TileCodec::decode(
+      &encoded[0], encoded.size(), width, height, nColors, step,
+      &decoded[0]);
+
+  EXPECT_TRUE(values == decoded);
+}
+
+TEST(TileCodecTest, Zeroes) {
+  std::vector<unsigned short> values(64 * 64, 0);
+  expectRoundTrip(values, 64, 64, 1, 2);
+
+  std::vector<unsigned char> encoded;
+  refinery::TileCodec::encode(&values[0], 64, 64, 1, 2, encoded);
+  EXPECT_GT(200u, encoded.size());
+}
+
+TEST(TileCodecTest, Extremes) {
+  // Differences of +-65535 must wrap around correctly
+  std::vector<unsigned short> values;
+  for (int i = 0; i < 3 * 17 * 5; i++) {
+    values.push_back(i % 2 ? 0xffff : 0);
+  }
+  expectRoundTrip(values, 17, 5, 3, 1);
+}
+
+TEST(TileCodecTest, Random) {
+  std::srand(1234);
+  std::vector<unsigned short> values;
+  for (int i = 0; i < 3 * 33 * 31; i++) {
+    values.push_back(std::rand() & 0xffff);
+  }
+  expectRoundTrip(values, 33, 31, 3, 1);
+}
+
+TEST(TileCodecTest, SensorDataShrinks) {
+  std::vector<unsigned short> values(
+      &nikon_d5000_225x75_sample[0], &nikon_d5000_225x75_sample[225*75]);
+  expectRoundTrip(values, 225, 75, 1, 2);
+
+  std::vector<unsigned char> encoded;
+  refinery::TileCodec::encode(&values[0], 225, 75, 1, 2, encoded);
+  EXPECT_GT(values.size() * 2 * 65 / 100, encoded.size());
+}
+
+TEST(TileCodecTest, CorruptDataThrows) {
+  std::vector<unsigned short> values(16, 1);
+  std::vector<unsigned char> encoded;
+  refinery::TileCodec::encode(&values[0], 4, 4, 1, 2, encoded);
+  encoded.resize(encoded.size() - 1);
+
+  EXPECT_THROW(
+      refinery::TileCodec::decode(
+        &encoded[0], encoded.size(), 4, 4, 1, 2, &values[0]),
+      std::runtime_error);
+}
+
+} // namespace
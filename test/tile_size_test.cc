@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "../src/tile_size.h"
+
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+using refinery::TileSize;
+
+class TileSizeTest : public ::testing::Test {
+protected:
+  std::string directory;
+  std::string path;
+
+  virtual void SetUp() {
+    char tmpl[] = "/tmp/refinery-tile-size-test-XXXXXX";
+    directory = ::mkdtemp(tmpl);
+    path = directory + "/tile-size";
+  }
+
+  virtual void TearDown() {
+    std::remove(path.c_str());
+    ::rmdir(directory.c_str());
+  }
+
+  void writeFile(const char* contents) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    std::fputs(contents, f);
+    std::fclose(f);
+  }
+};
+
+TEST_F(TileSizeTest, DefaultIsUnset) {
+  EXPECT_FALSE(TileSize().isSet());
+  EXPECT_TRUE(TileSize(8, 8).isSet());
+}
+
+TEST_F(TileSizeTest, DetectsACacheSize) {
+  EXPECT_LT(0u, TileSize::detectCacheSize());
+}
+
+TEST_F(TileSizeTest, FillsHalfTheCacheWithWideTiles) {
+  const std::size_t cacheBytes = 2 * 1024 * 1024;
+  const TileSize tileSize(TileSize::forCache(cacheBytes, 27, 3));
+
+  const std::size_t bytes = tileSize.height * tileSize.width * 27;
+  EXPECT_LE(bytes, cacheBytes / 2);
+  EXPECT_GT(bytes, cacheBytes / 2 * 9 / 10);
+  EXPECT_GT(tileSize.width, tileSize.height);
+}
+
+TEST_F(TileSizeTest, TinyCacheStillGivesUsableTiles) {
+  const TileSize tileSize(TileSize::forCache(1024, 27, 3));
+  EXPECT_LE(32u, tileSize.height);
+  EXPECT_LE(32u, tileSize.width);
+}
+
+TEST_F(TileSizeTest, HugeCacheLimitsWidth) {
+  const TileSize tileSize(TileSize::forCache(256 * 1024 * 1024, 27, 3));
+  EXPECT_EQ(1024u, tileSize.width);
+  EXPECT_LT(1024u, tileSize.height);
+}
+
+TEST_F(TileSizeTest, WriteThenRead) {
+  ASSERT_TRUE(TileSize(98, 394).write(path.c_str(), 2097152));
+
+  TileSize tileSize;
+  ASSERT_TRUE(TileSize::read(path.c_str(), 2097152, tileSize));
+  EXPECT_EQ(98u, tileSize.height);
+  EXPECT_EQ(394u, tileSize.width);
+}
+
+TEST_F(TileSizeTest, ReadRejectsOtherCacheSize) {
+  ASSERT_TRUE(TileSize(98, 394).write(path.c_str(), 2097152));
+
+  TileSize tileSize;
+  EXPECT_FALSE(TileSize::read(path.c_str(), 262144, tileSize));
+  EXPECT_FALSE(tileSize.isSet());
+}
+
+TEST_F(TileSizeTest, ReadRejectsMissingOrBadFiles) {
+  TileSize tileSize;
+  EXPECT_FALSE(TileSize::read(path.c_str(), 2097152, tileSize));
+
+  writeFile("not a tile size\n");
+  EXPECT_FALSE(TileSize::read(path.c_str(), 2097152, tileSize));
+
+  writeFile("refinery-tile-size 2097152 0 394\n");
+  EXPECT_FALSE(TileSize::read(path.c_str(), 2097152, tileSize));
+
+  EXPECT_FALSE(tileSize.isSet());
+}
+
+} // namespace
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "refinery/white_balance.h"
+
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/filters.h"
+#include "refinery/image.h"
+
+namespace {
+
+class AutoWhiteBalanceTest : public ::testing::Test {
+protected:
+  refinery::InMemoryExifData exifData;
+
+  virtual void SetUp() {
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+  }
+
+  // GRGR... on even rows, BGBG... on odd rows (maximum is 0xf00)
+  refinery::GrayImage* createImage(
+      unsigned short r, unsigned short g, unsigned short b) {
+    refinery::CameraData cameraData(
+        refinery::CameraDataFactory::instance().getCameraData(exifData));
+    refinery::GrayImage* image = new refinery::GrayImage(cameraData, 9, 6);
+    image->setFilters(0x61616161);
+
+    for (unsigned int row = 0; row < image->height(); row++) {
+      for (unsigned int col = 0; col < image->width(); col++) {
+        const unsigned short values[3] = { r, g, b };
+        image->pixelAtPoint(row, col).value() =
+            values[image->colorAtPoint(row, col)];
+      }
+    }
+
+    return image;
+  }
+};
+
+TEST_F(AutoWhiteBalanceTest, GrayWorld) {
+  std::auto_ptr<refinery::GrayImage> image(createImage(1000, 2000, 500));
+
+  double multipliers[4];
+  refinery::AutoWhiteBalance awb(refinery::AutoWhiteBalance::GRAY_WORLD);
+  awb.computeMultipliers(*image, multipliers);
+
+  EXPECT_DOUBLE_EQ(2 * 65535.0 / 0xf00, multipliers[0]);
+  EXPECT_DOUBLE_EQ(65535.0 / 0xf00, multipliers[1]);
+  EXPECT_DOUBLE_EQ(4 * 65535.0 / 0xf00, multipliers[2]);
+}
+
+TEST_F(AutoWhiteBalanceTest, ExcludeClippedPixels) {
+  std::auto_ptr<refinery::GrayImage> image(createImage(1000, 2000, 500));
+  image->pixelAtPoint(0, 1).value() = 0xf00; // red, clipped
+  image->pixelAtPoint(0, 0).value() = 0xfff; // green, clipped
+
+  double multipliers[4];
+  refinery::AutoWhiteBalance awb(refinery::AutoWhiteBalance::GRAY_WORLD);
+  awb.computeMultipliers(*image, multipliers);
+
+  EXPECT_DOUBLE_EQ(2 * 65535.0 / 0xf00, multipliers[0]);
+  EXPECT_DOUBLE_EQ(65535.0 / 0xf00, multipliers[1]);
+  EXPECT_DOUBLE_EQ(4 * 65535.0 / 0xf00, multipliers[2]);
+}
+
+TEST_F(AutoWhiteBalanceTest, WhitePatch) {
+  std::auto_ptr<refinery::GrayImage> image(createImage(1000, 2000, 500));
+  image->pixelAtPoint(2, 3).value() = 3000; // red
+  image->pixelAtPoint(3, 4).value() = 1500; // blue
+
+  double multipliers[4];
+  refinery::AutoWhiteBalance awb(refinery::AutoWhiteBalance::WHITE_PATCH);
+  awb.computeMultipliers(*image, multipliers);
+
+  EXPECT_DOUBLE_EQ(65535.0 / 0xf00, multipliers[0]);
+  EXPECT_DOUBLE_EQ(1.5 * 65535.0 / 0xf00, multipliers[1]);
+  EXPECT_DOUBLE_EQ(2 * 65535.0 / 0xf00, multipliers[2]);
+}
+
+TEST_F(AutoWhiteBalanceTest, FallBackToCameraWhenChannelIsClipped) {
+  std::auto_ptr<refinery::GrayImage> image(createImage(0xf00, 2000, 500));
+
+  double multipliers[4];
+  refinery::AutoWhiteBalance awb;
+  awb.computeMultipliers(*image, multipliers);
+
+  const refinery::Camera::ColorConversionData& colorData(
+      image->profile().colorConversionData());
+  for (unsigned int c = 0; c < 3; c++) {
+    EXPECT_DOUBLE_EQ(colorData.scalingMultipliers[c], multipliers[c]);
+  }
+}
+
+TEST_F(AutoWhiteBalanceTest, FeedScaleColorsFilter) {
+  std::auto_ptr<refinery::GrayImage> image(createImage(1000, 2000, 500));
+
+  double multipliers[4];
+  refinery::AutoWhiteBalance awb;
+  awb.computeMultipliers(*image, multipliers);
+
+  refinery::ScaleColorsFilter filter;
+  filter.filter(*image, multipliers);
+
+  const unsigned short expected = 2000 * 65535.0 / 0xf00;
+  EXPECT_EQ(expected, image->constPixelAtPoint(0, 0).value()); // green
+  EXPECT_EQ(expected, image->constPixelAtPoint(0, 1).value()); // red
+  EXPECT_EQ(expected, image->constPixelAtPoint(1, 0).value()); // blue
+}
+
+} // namespace
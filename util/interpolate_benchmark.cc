@@ -0,0 +1,219 @@
+#include "refinery/camera.h"
+#include "refinery/exif.h"
+#include "refinery/filters.h"
+#include "refinery/image.h"
+#include "refinery/interpolate.h"
+#include "refinery/unpack.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <sys/time.h>
+
+using namespace refinery;
+
+namespace {
+  struct Algorithm {
+    const char* name;
+    Interpolator::Type type;
+  };
+
+  const Algorithm algorithms[] = {
+    { "bilinear", Interpolator::INTERPOLATE_BILINEAR },
+    { "mhc", Interpolator::INTERPOLATE_MHC },
+    { "ppg", Interpolator::INTERPOLATE_PPG },
+    { "ahd", Interpolator::INTERPOLATE_AHD }
+  };
+
+  /*
+   * Pixels this close to the edge don't count towards PSNR: each algorithm
+   * treats its border differently.
+   */
+  const int Margin = 8;
+
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+
+  /*
+   * A scene with detail at every frequency and direction (a zone plate)
+   * under smooth color gradients, and a few hard-edged color bars.
+   */
+  std::vector<unsigned short> createScene(int width, int height)
+  {
+    std::vector<unsigned short> rgb(width * height * 3);
+
+    const double cx = width / 2.0, cy = height / 2.0;
+    const double k = std::atan(1.0) * 2.0 / std::max(width, height);
+
+    for (int row = 0; row < height; row++) {
+      for (int col = 0; col < width; col++) {
+        const double dx = col - cx, dy = row - cy;
+        const double luma = 0.5 + 0.4 * std::cos(k * (dx * dx + dy * dy));
+
+        double tint[3] = {
+          0.4 + 0.6 * col / width,
+          0.7,
+          0.4 + 0.6 * row / height
+        };
+        if (row % 64 < 8) {
+          tint[(col / 64) % 3] *= 0.2; // bars
+        }
+
+        for (int c = 0; c < 3; c++) {
+          rgb[(row * width + col) * 3 + c] =
+            static_cast<unsigned short>(60000.0 * luma * tint[c]);
+        }
+      }
+    }
+
+    return rgb;
+  }
+
+  void mosaic(const std::vector<unsigned short>& rgb, GrayImage& gray)
+  {
+    const int width = gray.width();
+    for (unsigned int row = 0; row < gray.height(); row++) {
+      for (int col = 0; col < width; col++) {
+        gray.pixelAtPoint(row, col)[0] =
+          rgb[(row * width + col) * 3 + gray.colorAtPoint(row, col)];
+      }
+    }
+  }
+
+  /*
+   * PSNR of the values that were interpolated: each pixel's two colors its
+   * sensor didn't capture.
+   */
+  double psnr(
+      const std::vector<unsigned short>& truth, const GrayImage& gray,
+      const RGBImage& image)
+  {
+    const int width = image.width(), height = image.height();
+    double sumSquares = 0.0;
+    std::size_t n = 0;
+
+    for (int row = Margin; row < height - Margin; row++) {
+      for (int col = Margin; col < width - Margin; col++) {
+        const RGBImage::PixelType& pixel(image.constPixelAtPoint(row, col));
+        const unsigned int ownC = gray.colorAtPoint(row, col);
+
+        for (unsigned int c = 0; c < 3; c++) {
+          if (c == ownC) continue;
+
+          const double diff = pixel.at(c)
+            - static_cast<double>(truth[(row * width + col) * 3 + c]);
+          sumSquares += diff * diff;
+          n++;
+        }
+      }
+    }
+
+    if (!n || !sumSquares) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(65535.0 * 65535.0 / (sumSquares / n));
+  }
+} // namespace {}
+
+int main(int argc, char **argv)
+{
+  int reps = 5;
+  int width = 3008, height = 2000;
+  const char* inFile = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      reps = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2) reps = 0;
+    } else if (argv[i][0] != '-' && !inFile) {
+      inFile = argv[i];
+    } else {
+      reps = 0;
+    }
+  }
+
+  if (reps < 1 || width < 2 * Margin || height < 2 * Margin) {
+    std::cerr << "Usage: " << argv[0] << " [--reps N] [--size WxH] [INFILE]"
+      << std::endl
+      << std::endl
+      << "Times each interpolation algorithm, best of N runs. Without"
+      << std::endl
+      << "INFILE, interpolates a synthetic scene and reports PSNR against it."
+      << std::endl;
+    return 1;
+  }
+
+  std::vector<unsigned short> truth;
+  std::auto_ptr<GrayImage> grayImagePtr;
+
+  if (inFile) {
+    std::filebuf fb;
+    fb.open(inFile, std::ios::in | std::ios::binary);
+    DcrawExifData exifData(fb);
+    ImageReader reader;
+    grayImagePtr.reset(reader.readGrayImage(fb, exifData));
+    ScaleColorsFilter scaleFilter;
+    scaleFilter.filter(*grayImagePtr);
+  } else {
+    InMemoryExifData exifData;
+    exifData.setString("Exif.Image.Model", "NIKON D5000");
+    CameraData cameraData(
+        CameraDataFactory::instance().getCameraData(exifData));
+
+    grayImagePtr.reset(new GrayImage(cameraData, width, height));
+    grayImagePtr->setFilters(0x61616161);
+    truth = createScene(width, height);
+    mosaic(truth, *grayImagePtr);
+  }
+
+  const GrayImage& grayImage(*grayImagePtr);
+  const double megapixels = grayImage.nPixels() / 1e6;
+
+  std::cout << grayImage.width() << "x" << grayImage.height() << ", best of "
+    << reps << std::endl
+    << std::setw(10) << std::left << "algorithm" << std::right
+    << std::setw(10) << "ms" << std::setw(10) << "Mpx/s";
+  if (!truth.empty()) std::cout << std::setw(10) << "PSNR dB";
+  std::cout << std::endl;
+
+  RGBImage rgbImage(grayImage.profile(), grayImage.width(),
+      grayImage.height(), ImageBuffer::UNINITIALIZED);
+
+  for (std::size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]);
+      a++) {
+    Interpolator interpolator(algorithms[a].type);
+    interpolator.setReusesScratch(true);
+
+    double best = std::numeric_limits<double>::infinity();
+    for (int rep = 0; rep < reps; rep++) {
+      const double start = now();
+      interpolator.interpolate(grayImage, rgbImage);
+      const double seconds = now() - start;
+      if (seconds < best) best = seconds;
+    }
+
+    std::cout << std::setw(10) << std::left << algorithms[a].name
+      << std::right << std::fixed << std::setprecision(1)
+      << std::setw(10) << best * 1000.0
+      << std::setw(10) << megapixels / best;
+    if (!truth.empty()) {
+      std::cout << std::setw(10) << std::setprecision(2)
+        << psnr(truth, grayImage, rgbImage);
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
@@ -4,49 +4,122 @@
 #include "refinery/image.h"
 #include "refinery/interpolate.h"
 #include "refinery/histogram.h"
+#include "refinery/memory_stats.h"
 #include "refinery/output.h"
 #include "refinery/unpack.h"
 
 #include <cassert>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 
 using namespace refinery;
 
+namespace {
+  bool printStats = false;
+  std::size_t overallPeak = 0;
+
+  void printKilobytes(std::size_t bytes)
+  {
+    std::cerr << std::setw(10) << (bytes + 1023) / 1024;
+  }
+
+  /*
+   * Prints each category's peak since the last stage, then starts the next
+   * stage's count.
+   */
+  void endStage(const char* stage)
+  {
+    if (!printStats) return;
+
+    const MemoryStats stats(MemoryStats::snapshot());
+    if (stats.total.peak > overallPeak) overallPeak = stats.total.peak;
+
+    std::cerr << std::setw(12) << std::left << stage << std::right;
+    for (int i = 0; i < MemoryStats::NCategories; i++) {
+      printKilobytes(stats.categories[i].peak);
+    }
+    printKilobytes(stats.total.peak);
+    printKilobytes(stats.total.current);
+    std::cerr << std::endl;
+
+    MemoryStats::resetPeaks();
+  }
+
+  void startStats()
+  {
+    if (!printStats) return;
+
+    std::cerr << "Peak memory use per stage, in kB:" << std::endl
+      << std::setw(12) << std::left << "stage" << std::right;
+    for (int i = 0; i < MemoryStats::NCategories; i++) {
+      std::cerr << std::setw(10) << MemoryStats::categoryName(
+          static_cast<MemoryStats::Category>(i));
+    }
+    std::cerr << std::setw(10) << "peak" << std::setw(10) << "after"
+      << std::endl;
+
+    MemoryStats::resetPeaks();
+  }
+} // namespace {}
+
 int main(int argc, char **argv)
 {
+  if (argc == 4 && std::strcmp(argv[1], "--stats") == 0) {
+    printStats = true;
+    argv++;
+    argc--;
+  }
+
   if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " INFILE OUTFILE" << std::endl;
+    std::cerr << "Usage: " << argv[0] << " [--stats] INFILE OUTFILE"
+      << std::endl;
     return 1;
   }
 
+  startStats();
+
   std::filebuf fb;
   fb.open(argv[1], std::ios::in | std::ios::binary);
 
   refinery::DcrawExifData exifData(fb);
+  endStage("exif");
 
   ImageReader reader;
   std::auto_ptr<GrayImage> grayImagePtr(reader.readGrayImage(fb, exifData));
+  endStage("unpack");
 
   ScaleColorsFilter scaleFilter;
   scaleFilter.filter(*grayImagePtr);
+  endStage("scale");
 
   Interpolator interpolator(Interpolator::INTERPOLATE_AHD);
   std::auto_ptr<RGBImage> imagePtr(interpolator.interpolate(*grayImagePtr));
+  grayImagePtr.reset();
+  endStage("interpolate");
 
   RGBImage& image(*imagePtr);
 
   ConvertToRgbFilter rgbFilter;
   rgbFilter.filter(image);
+  endStage("convert");
 
   Histogram<RGBImage, 3> histogram(image);
   GammaCurve<RGBImage::ValueType> gammaCurve(histogram);
   GammaFilter gammaFilter;
   gammaFilter.filter(image, gammaCurve);
+  endStage("gamma");
 
   ImageWriter writer;
   writer.writeImage(image, argv[2], 8);
+  endStage("write");
+
+  if (printStats) {
+    std::cerr << "Overall peak: " << (overallPeak + 1023) / 1024 << " kB"
+      << std::endl;
+  }
 
   return 0;
 }